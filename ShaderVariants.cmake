@@ -0,0 +1,58 @@
+# Shader permutations.
+#
+# A shader lists its feature switches on one line:
+#   // nashi:features DESATURATE FOG
+# Bit N of a variant key enables the Nth feature as NASHI_FEATURE_<NAME>=1.
+# Only the keys listed for a stage in shaders/variants.txt are compiled
+# (key 0, every feature off, is always built). Key 0 keeps the plain
+# artifact name, other keys append ".k<key>", e.g. basic.frag.k1.spv.
+# Layouts are reflected from key 0, so features must not add resources;
+# behaviour-only constants belong in specialization constants instead.
+
+set(NASHI_SHADER_VARIANTS_FILE "${NASHI_ROOT}/src/shaders/variants.txt")
+
+function(nashi_shader_variant_keys SHADER OUT_KEYS)
+  get_filename_component(FILE_NAME ${SHADER} NAME)
+  string(REPLACE "." "\\." FILE_NAME_REGEX ${FILE_NAME})
+  set(KEYS 0)
+  if(EXISTS ${NASHI_SHADER_VARIANTS_FILE})
+    file(STRINGS ${NASHI_SHADER_VARIANTS_FILE} LINES REGEX "^${FILE_NAME_REGEX}[ \t]")
+    foreach(LINE ${LINES})
+      string(STRIP "${LINE}" LINE)
+      string(REGEX REPLACE "[ \t]+" ";" FIELDS "${LINE}")
+      list(REMOVE_AT FIELDS 0)
+      list(APPEND KEYS ${FIELDS})
+    endforeach()
+  endif()
+  list(REMOVE_DUPLICATES KEYS)
+  set(${OUT_KEYS} ${KEYS} PARENT_SCOPE)
+endfunction()
+
+function(nashi_shader_variant SHADER KEY OUT_SUFFIX OUT_DEFINES)
+  file(STRINGS ${SHADER} FEATURE_LINE REGEX "^//[ \t]*nashi:features" LIMIT_COUNT 1)
+  string(REGEX REPLACE "^//[ \t]*nashi:features" "" FEATURES "${FEATURE_LINE}")
+  string(STRIP "${FEATURES}" FEATURES)
+  string(REGEX REPLACE "[ \t]+" ";" FEATURES "${FEATURES}")
+
+  set(DEFINES "")
+  set(BIT 0)
+  foreach(FEATURE ${FEATURES})
+    math(EXPR ENABLED "(${KEY} >> ${BIT}) & 1")
+    if(ENABLED)
+      list(APPEND DEFINES "-DNASHI_FEATURE_${FEATURE}=1")
+    endif()
+    math(EXPR BIT "${BIT} + 1")
+  endforeach()
+
+  math(EXPR UNKNOWN_BITS "${KEY} >> ${BIT}")
+  if(UNKNOWN_BITS)
+    message(FATAL_ERROR "Variant key ${KEY} of ${SHADER} uses undeclared feature bits")
+  endif()
+
+  if(KEY EQUAL 0)
+    set(${OUT_SUFFIX} "" PARENT_SCOPE)
+  else()
+    set(${OUT_SUFFIX} ".k${KEY}" PARENT_SCOPE)
+  endif()
+  set(${OUT_DEFINES} ${DEFINES} PARENT_SCOPE)
+endfunction()
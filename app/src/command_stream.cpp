@@ -0,0 +1,138 @@
+#include <command_stream.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace Nashi {
+    static size_t alignPacket(size_t size) {
+        return (size + COMMAND_PACKET_ALIGNMENT - 1) & ~(COMMAND_PACKET_ALIGNMENT - 1);
+    }
+
+    // Every block keeps room for a trailing Jump (or End) packet, so the
+    // stream can always be chained or terminated. Once a packet is dropped
+    // every later one is too, even if it would fit, so the stream never
+    // skips a bind its draws depend on.
+    uint8_t* CommandEncoder::reserve(size_t size) {
+        if (m_overflowed) {
+            return nullptr;
+        }
+        const size_t tail = alignPacket(sizeof(CmdJump));
+        if (m_cursor && m_cursor + size + tail <= m_blockEnd) {
+            uint8_t* packet = m_cursor;
+            m_cursor += size;
+            return packet;
+        }
+
+        size_t blockSize = std::max(COMMAND_BLOCK_SIZE, size + tail);
+        auto* block = static_cast<uint8_t*>(m_arena.allocate(blockSize, COMMAND_PACKET_ALIGNMENT));
+        if (!block) {
+            m_overflowed = true;
+            return nullptr;
+        }
+
+        if (m_cursor) {
+            auto* jump = reinterpret_cast<CmdJump*>(m_cursor);
+            jump->header = { CommandType::Jump, static_cast<uint16_t>(tail) };
+            jump->next = reinterpret_cast<const CommandHeader*>(block);
+        }
+        else {
+            m_head = block;
+        }
+        m_cursor = block + size;
+        m_blockEnd = block + blockSize;
+        return block;
+    }
+
+    template<typename T>
+    T* CommandEncoder::push(CommandType type, size_t payload) {
+        size_t size = alignPacket(sizeof(T) + payload);
+        auto* packet = reinterpret_cast<T*>(reserve(size));
+        if (packet) {
+            packet->header = { type, static_cast<uint16_t>(size) };
+        }
+        return packet;
+    }
+
+    void CommandEncoder::bindPipeline(PipelineHandle pipeline) {
+        if (auto* cmd = push<CmdBindPipeline>(CommandType::BindPipeline)) {
+            cmd->pipeline = pipeline;
+        }
+    }
+
+    void CommandEncoder::bindVertexBuffer(BufferHandle buffer, uint32_t offset) {
+        if (auto* cmd = push<CmdBindVertexBuffer>(CommandType::BindVertexBuffer)) {
+            cmd->buffer = buffer;
+            cmd->offset = offset;
+        }
+    }
+
+    void CommandEncoder::bindIndexBuffer(BufferHandle buffer, IndexType indexType, uint32_t offset) {
+        if (auto* cmd = push<CmdBindIndexBuffer>(CommandType::BindIndexBuffer)) {
+            cmd->buffer = buffer;
+            cmd->offset = offset;
+            cmd->indexType = indexType;
+        }
+    }
+
+    void CommandEncoder::setConstants(const void* data, uint32_t size, uint32_t offset) {
+        assert(offset % 4 == 0 && size % 4 == 0 && offset + size <= MAX_COMMAND_CONSTANTS_SIZE);
+        if (auto* cmd = push<CmdSetConstants>(CommandType::SetConstants, size)) {
+            cmd->offset = static_cast<uint16_t>(offset);
+            cmd->size = static_cast<uint16_t>(size);
+            memcpy(cmd + 1, data, size);
+        }
+    }
+
+    void CommandEncoder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+        if (auto* cmd = push<CmdDraw>(CommandType::Draw)) {
+            cmd->vertexCount = vertexCount;
+            cmd->instanceCount = instanceCount;
+            cmd->firstVertex = firstVertex;
+            cmd->firstInstance = firstInstance;
+        }
+    }
+
+    void CommandEncoder::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+        int32_t vertexOffset, uint32_t firstInstance) {
+        if (auto* cmd = push<CmdDrawIndexed>(CommandType::DrawIndexed)) {
+            cmd->indexCount = indexCount;
+            cmd->instanceCount = instanceCount;
+            cmd->firstIndex = firstIndex;
+            cmd->vertexOffset = vertexOffset;
+            cmd->firstInstance = firstInstance;
+        }
+    }
+
+    void CommandEncoder::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+        if (auto* cmd = push<CmdDispatch>(CommandType::Dispatch)) {
+            cmd->groupCountX = groupCountX;
+            cmd->groupCountY = groupCountY;
+            cmd->groupCountZ = groupCountZ;
+        }
+    }
+
+    void CommandEncoder::copyBuffer(BufferHandle src, uint32_t srcOffset, BufferHandle dst, uint32_t dstOffset, uint32_t size) {
+        if (auto* cmd = push<CmdCopyBuffer>(CommandType::CopyBuffer)) {
+            cmd->src = src;
+            cmd->dst = dst;
+            cmd->srcOffset = srcOffset;
+            cmd->dstOffset = dstOffset;
+            cmd->size = size;
+        }
+    }
+
+    // Leaves the encoder ready for the next stream, overflow included.
+    CommandStream CommandEncoder::finish() {
+        CommandStream stream;
+        if (m_cursor || reserve(0)) {
+            auto* end = reinterpret_cast<CommandHeader*>(m_cursor);
+            *end = { CommandType::End, static_cast<uint16_t>(alignPacket(sizeof(CommandHeader))) };
+            stream.head = reinterpret_cast<const CommandHeader*>(m_head);
+        }
+
+        m_head = m_cursor = m_blockEnd = nullptr;
+        m_overflowed = false;
+        return stream;
+    }
+}
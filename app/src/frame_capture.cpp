@@ -0,0 +1,301 @@
+#include <frame_capture.hpp>
+
+#include <cstddef>
+
+namespace Nashi {
+    namespace {
+        uint64_t alignRecord(uint64_t size) {
+            return (size + FRAME_CAPTURE_ALIGNMENT - 1) & ~static_cast<uint64_t>(FRAME_CAPTURE_ALIGNMENT - 1);
+        }
+
+        // Whether the payload holds everything the record type promises.
+        bool recordComplete(const CaptureRecord& record) {
+            switch (record.type) {
+            case CaptureRecordType::CreateBuffer:
+                return record.size >= sizeof(CaptureCreateBuffer) &&
+                    (!record.as<CaptureCreateBuffer>().hasInitialData ||
+                        record.size - sizeof(CaptureCreateBuffer) >= record.as<CaptureCreateBuffer>().size);
+            case CaptureRecordType::DestroyBuffer:
+                return record.size >= sizeof(CaptureBuffer);
+            case CaptureRecordType::BasicPipeline:
+                return record.size >= sizeof(CaptureBasicPipeline);
+            case CaptureRecordType::WriteBuffer:
+                return record.size >= sizeof(CaptureWriteBuffer);
+            case CaptureRecordType::Submit:
+            case CaptureRecordType::EndFrame:
+                return true;
+            }
+            return false;
+        }
+
+        size_t packetSize(CommandType type) {
+            switch (type) {
+            case CommandType::BindPipeline: return sizeof(CmdBindPipeline);
+            case CommandType::BindVertexBuffer: return sizeof(CmdBindVertexBuffer);
+            case CommandType::BindIndexBuffer: return sizeof(CmdBindIndexBuffer);
+            case CommandType::SetConstants: return sizeof(CmdSetConstants);
+            case CommandType::Draw: return sizeof(CmdDraw);
+            case CommandType::DrawIndexed: return sizeof(CmdDrawIndexed);
+            case CommandType::Dispatch: return sizeof(CmdDispatch);
+            case CommandType::CopyBuffer: return sizeof(CmdCopyBuffer);
+            default: return 0;
+            }
+        }
+    }
+
+    FrameCaptureWriter::~FrameCaptureWriter() {
+        close();
+    }
+
+    bool FrameCaptureWriter::open(const std::filesystem::path& path) {
+        close();
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_file.is_open()) {
+            return false;
+        }
+
+        m_frameCount = 0;
+        FrameCaptureHeader header{};
+        header.magic = FRAME_CAPTURE_MAGIC;
+        header.version = FRAME_CAPTURE_VERSION;
+        m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        return static_cast<bool>(m_file);
+    }
+
+    bool FrameCaptureWriter::close() {
+        if (!m_file.is_open()) {
+            return false;
+        }
+
+        m_file.seekp(offsetof(FrameCaptureHeader, frameCount));
+        m_file.write(reinterpret_cast<const char*>(&m_frameCount), sizeof(m_frameCount));
+        const bool written = static_cast<bool>(m_file);
+        m_file.close();
+        return written;
+    }
+
+    void FrameCaptureWriter::beginRecord(CaptureRecordType type, uint64_t size) {
+        FrameCaptureRecord record{};
+        record.type = type;
+        record.size = static_cast<uint32_t>(size);
+        m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        m_recordSize = size;
+    }
+
+    void FrameCaptureWriter::write(const void* data, uint64_t size) {
+        m_file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    void FrameCaptureWriter::endRecord() {
+        static const char padding[FRAME_CAPTURE_ALIGNMENT] = {};
+        write(padding, alignRecord(m_recordSize) - m_recordSize);
+    }
+
+    void FrameCaptureWriter::createBuffer(BufferHandle buffer, const BufferDesc& desc) {
+        CaptureCreateBuffer create{};
+        create.buffer = buffer.value;
+        create.usage = desc.usage;
+        create.size = desc.size;
+        create.hostVisible = desc.hostVisible;
+        create.hasInitialData = desc.initialData != nullptr;
+
+        beginRecord(CaptureRecordType::CreateBuffer, sizeof(create) + (desc.initialData ? desc.size : 0));
+        write(&create, sizeof(create));
+        if (desc.initialData) {
+            write(desc.initialData, desc.size);
+        }
+        endRecord();
+    }
+
+    void FrameCaptureWriter::destroyBuffer(BufferHandle buffer) {
+        CaptureBuffer destroy{};
+        destroy.buffer = buffer.value;
+        beginRecord(CaptureRecordType::DestroyBuffer, sizeof(destroy));
+        write(&destroy, sizeof(destroy));
+        endRecord();
+    }
+
+    void FrameCaptureWriter::basicPipeline(PipelineHandle pipeline, uint32_t variantKey) {
+        CaptureBasicPipeline basic{};
+        basic.pipeline = pipeline.value;
+        basic.variantKey = variantKey;
+        beginRecord(CaptureRecordType::BasicPipeline, sizeof(basic));
+        write(&basic, sizeof(basic));
+        endRecord();
+    }
+
+    void FrameCaptureWriter::writeBuffer(BufferHandle buffer, uint64_t offset, const void* data, uint64_t size) {
+        CaptureWriteBuffer update{};
+        update.buffer = buffer.value;
+        update.offset = offset;
+        beginRecord(CaptureRecordType::WriteBuffer, sizeof(update) + size);
+        write(&update, sizeof(update));
+        write(data, size);
+        endRecord();
+    }
+
+    // Packets are padded to COMMAND_PACKET_ALIGNMENT, which keeps them
+    // aligned in the file too.
+    void FrameCaptureWriter::submit(const CommandStream& stream) {
+        uint64_t size = 0;
+        for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+            size += cmd->size;
+        }
+
+        beginRecord(CaptureRecordType::Submit, size);
+        for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+            write(cmd, cmd->size);
+        }
+        endRecord();
+    }
+
+    void FrameCaptureWriter::endFrame() {
+        beginRecord(CaptureRecordType::EndFrame, 0);
+        endRecord();
+        m_frameCount++;
+    }
+
+    bool FrameCaptureReader::open(const std::filesystem::path& path, std::string& error) {
+        m_data.clear();
+        m_records.clear();
+        m_frameStarts.clear();
+
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            error = "failed to open " + path.string();
+            return false;
+        }
+        m_data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(m_data.data()), static_cast<std::streamsize>(m_data.size()));
+        if (!file) {
+            error = "failed to read " + path.string();
+            return false;
+        }
+
+        FrameCaptureHeader header{};
+        if (m_data.size() < sizeof(header)) {
+            error = "not a frame capture";
+            return false;
+        }
+        memcpy(&header, m_data.data(), sizeof(header));
+        if (header.magic != FRAME_CAPTURE_MAGIC) {
+            error = "not a frame capture";
+            return false;
+        }
+        if (header.version != FRAME_CAPTURE_VERSION) {
+            error = "capture version " + std::to_string(header.version) + ", expected " + std::to_string(FRAME_CAPTURE_VERSION);
+            return false;
+        }
+
+        // A capture cut short by a crash still replays up to its last
+        // complete frame.
+        size_t frameStart = 0;
+        uint64_t offset = sizeof(header);
+        while (offset + sizeof(FrameCaptureRecord) <= m_data.size()) {
+            FrameCaptureRecord record;
+            memcpy(&record, m_data.data() + offset, sizeof(record));
+            offset += sizeof(record);
+            if (offset + record.size > m_data.size()) {
+                break;
+            }
+
+            CaptureRecord loaded{ record.type, m_data.data() + offset, record.size };
+            if (!recordComplete(loaded)) {
+                error = "malformed record at offset " + std::to_string(offset - sizeof(record));
+                return false;
+            }
+
+            m_records.push_back(loaded);
+            offset += alignRecord(record.size);
+            if (record.type == CaptureRecordType::EndFrame) {
+                m_frameStarts.push_back(frameStart);
+                frameStart = m_records.size();
+            }
+        }
+        m_records.resize(frameStart);
+
+        if (m_frameStarts.empty()) {
+            error = "capture has no complete frame";
+            return false;
+        }
+        return true;
+    }
+
+    std::span<const CaptureRecord> FrameCaptureReader::frame(uint32_t index) const {
+        const size_t end = index + 1 < m_frameStarts.size() ? m_frameStarts[index + 1] : m_records.size();
+        return std::span<const CaptureRecord>(m_records).subspan(m_frameStarts[index], end - m_frameStarts[index]);
+    }
+
+    BufferHandle CaptureHandleMap::buffer(BufferHandle captured) const {
+        auto found = buffers.find(captured.value);
+        return found != buffers.end() ? found->second : BufferHandle{};
+    }
+
+    PipelineHandle CaptureHandleMap::pipeline(PipelineHandle captured) const {
+        auto found = pipelines.find(captured.value);
+        return found != pipelines.end() ? found->second : PipelineHandle{};
+    }
+
+    bool encodeCapturedStream(const CaptureRecord& submit, const CaptureHandleMap& handles, CommandEncoder& encoder) {
+        uint32_t offset = 0;
+        while (offset < submit.size) {
+            if (submit.size - offset < sizeof(CommandHeader)) {
+                return false;
+            }
+            const auto* cmd = reinterpret_cast<const CommandHeader*>(submit.payload + offset);
+            const size_t minimumSize = packetSize(cmd->type);
+            if (minimumSize == 0 || cmd->size < minimumSize || cmd->size > submit.size - offset) {
+                return false;
+            }
+
+            switch (cmd->type) {
+            case CommandType::BindPipeline:
+                encoder.bindPipeline(handles.pipeline(commandAs<CmdBindPipeline>(cmd).pipeline));
+                break;
+            case CommandType::BindVertexBuffer: {
+                const auto& bind = commandAs<CmdBindVertexBuffer>(cmd);
+                encoder.bindVertexBuffer(handles.buffer(bind.buffer), bind.offset);
+                break;
+            }
+            case CommandType::BindIndexBuffer: {
+                const auto& bind = commandAs<CmdBindIndexBuffer>(cmd);
+                encoder.bindIndexBuffer(handles.buffer(bind.buffer), bind.indexType, bind.offset);
+                break;
+            }
+            case CommandType::SetConstants: {
+                const auto& constants = commandAs<CmdSetConstants>(cmd);
+                if (sizeof(CmdSetConstants) + constants.size > cmd->size) {
+                    return false;
+                }
+                encoder.setConstants(constants.data(), constants.size, constants.offset);
+                break;
+            }
+            case CommandType::Draw: {
+                const auto& draw = commandAs<CmdDraw>(cmd);
+                encoder.draw(draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+                break;
+            }
+            case CommandType::DrawIndexed: {
+                const auto& draw = commandAs<CmdDrawIndexed>(cmd);
+                encoder.drawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+                break;
+            }
+            case CommandType::Dispatch: {
+                const auto& dispatch = commandAs<CmdDispatch>(cmd);
+                encoder.dispatch(dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+                break;
+            }
+            case CommandType::CopyBuffer: {
+                const auto& copy = commandAs<CmdCopyBuffer>(cmd);
+                encoder.copyBuffer(handles.buffer(copy.src), copy.srcOffset, handles.buffer(copy.dst), copy.dstOffset, copy.size);
+                break;
+            }
+            default:
+                break;
+            }
+            offset += cmd->size;
+        }
+        return !encoder.overflowed();
+    }
+}
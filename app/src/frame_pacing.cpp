@@ -0,0 +1,108 @@
+#ifndef NASHI_VR
+#include <frame_pacing.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace Nashi {
+    FramePacingPolicy parseFramePacingArgs(int argc, char** argv) {
+        FramePacingPolicy policy;
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+            if (arg == "--present=immediate") policy.presentMode = PresentMode::Immediate;
+            else if (arg == "--present=mailbox") policy.presentMode = PresentMode::Mailbox;
+            else if (arg == "--present=fifo") policy.presentMode = PresentMode::Fifo;
+            else if (arg == "--present=fifo-relaxed") policy.presentMode = PresentMode::FifoRelaxed;
+            else if (arg.starts_with("--frames=")) policy.frameQueueDepth = static_cast<uint32_t>(std::atoi(argv[i] + strlen("--frames=")));
+            else if (arg.starts_with("--fps=")) policy.frameLimitHz = std::atof(argv[i] + strlen("--fps="));
+            else if (arg == "--late-latch") policy.lateLatchCamera = true;
+            else if (arg == "--latency-log") policy.logLatency = true;
+        }
+        return policy;
+    }
+
+    const char* presentModeName(PresentMode mode) {
+        switch (mode) {
+        case PresentMode::Immediate: return "immediate";
+        case PresentMode::Mailbox: return "mailbox";
+        case PresentMode::Fifo: return "fifo";
+        case PresentMode::FifoRelaxed: return "fifo-relaxed";
+        }
+        return "unknown";
+    }
+
+    void FramePacer::setPolicy(const FramePacingPolicy& policy) {
+        m_policy = policy;
+        m_policy.frameQueueDepth = std::clamp(m_policy.frameQueueDepth, 1u, MAX_FRAME_QUEUE_DEPTH);
+        m_policy.frameLimitHz = std::max(m_policy.frameLimitHz, 0.0);
+        m_nextDeadlineNs = 0;
+    }
+
+    void FramePacer::limit() {
+        if (m_policy.frameLimitHz <= 0.0) {
+            return;
+        }
+        NASHI_TRACE_SCOPE("FramePacer::limit");
+
+        const uint64_t intervalNs = static_cast<uint64_t>(1e9 / m_policy.frameLimitHz);
+        uint64_t now = SDL_GetTicksNS();
+
+        // Fell more than a frame behind (breakpoint, minimized window): resync
+        // instead of rushing a burst of frames to catch up.
+        if (m_nextDeadlineNs == 0 || now > m_nextDeadlineNs + intervalNs) {
+            m_nextDeadlineNs = now;
+        }
+        if (now < m_nextDeadlineNs) {
+            // Sleeps most of the way and spins the rest.
+            SDL_DelayPrecise(m_nextDeadlineNs - now);
+        }
+        m_nextDeadlineNs += intervalNs;
+    }
+
+    void FramePacer::markInput(uint64_t timestampNs) {
+        if (m_pendingInputNs == 0 || timestampNs < m_pendingInputNs) {
+            m_pendingInputNs = timestampNs;
+        }
+    }
+
+    void FramePacer::onPresent() {
+        uint64_t now = SDL_GetTicksNS();
+
+        if (m_pendingInputNs != 0) {
+            m_lastInputLatencyNs = now - std::min(now, m_pendingInputNs);
+            m_pendingInputNs = 0;
+            m_logInputs++;
+            m_logInputLatencyNs += m_lastInputLatencyNs;
+        }
+
+        if (m_lastPresentNs != 0) {
+            m_logFrames++;
+            m_logFrameTimeNs += now - m_lastPresentNs;
+        }
+        m_lastPresentNs = now;
+
+        if (!m_policy.logLatency) {
+            return;
+        }
+        if (m_logStartNs == 0) {
+            m_logStartNs = now;
+        }
+        if (now - m_logStartNs >= 1000000000ull && m_logFrames > 0) {
+            std::cout << presentModeName(m_policy.presentMode)
+                << " depth " << m_policy.frameQueueDepth
+                << ": frame " << (m_logFrameTimeNs / m_logFrames) / 1e6 << " ms";
+            if (m_logInputs > 0) {
+                std::cout << ", input-to-present " << (m_logInputLatencyNs / m_logInputs) / 1e6 << " ms";
+            }
+            std::cout << std::endl;
+
+            m_logStartNs = now;
+            m_logFrames = m_logFrameTimeNs = m_logInputs = m_logInputLatencyNs = 0;
+        }
+    }
+}
+#endif
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <command_stream.hpp>
+#include <frame_pacing.hpp>
+#include <linear_arena.hpp>
+#include <renderer.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Nashi {
+    // basic.vert's vertex input on every backend: position, then color.
+    struct AppSceneVertex {
+        float pos[3];
+        float color[3];
+    };
+
+    // One frame of the floor, built on the app thread and handed to the
+    // render thread by a FramePacket: the vertices to upload and the stream
+    // that draws them. The stream lives in arena, so a frame must not be
+    // built again until the render thread has drawn it; main.cpp cycles
+    // through MAX_RENDER_PACKETS_IN_FLIGHT of them.
+    struct AppSceneFrame {
+        static constexpr uint32_t TILES_PER_SIDE = 4;
+        static constexpr uint32_t TILE_COUNT = TILES_PER_SIDE * TILES_PER_SIDE;
+        static constexpr uint32_t VERTEX_COUNT = TILE_COUNT * 4;
+        static constexpr uint32_t INDEX_COUNT = TILE_COUNT * 6;
+        // A bind of each kind and a draw per tile take well under this.
+        static constexpr size_t ARENA_SIZE = 16 * 1024;
+
+        AppSceneVertex vertices[VERTEX_COUNT];
+        // Where submit() uploads vertices, and where stream binds them.
+        uint32_t vertexOffset = 0;
+        LinearArena arena{ ARENA_SIZE };
+        CommandStream stream;
+    };
+
+    // The application's own geometry: a tiled floor under the backend's
+    // built-in cube, drawn with the basic pipeline through the resource and
+    // command stream API. main.cpp drives it through a FrameRecorder, so a
+    // capture holds its buffers, the vertex colors it rewrites every frame
+    // and its streams. The cube is drawn inside draw() and replays with the
+    // EndFrame records. Every tile is a draw of its own, so a backend that
+    // culls draws on the CPU (the software one) drops the tiles the cube
+    // hides.
+    //
+    // Device is a renderer or a FrameRecorder. create, submit and destroy
+    // go on the thread that owns the renderer; build only reads the handles
+    // create made, so it can go on another thread once create has returned.
+    template<typename Device>
+    class AppScene {
+    public:
+        static constexpr uint32_t VERTEX_SLICE_SIZE = AppSceneFrame::VERTEX_COUNT * sizeof(AppSceneVertex);
+        // submit() writes before draw() waits for the frame's slot, when the
+        // frame MAX_FRAME_QUEUE_DEPTH back may still be on the GPU. One more
+        // slice than frames in flight means a slice is only rewritten once
+        // the frame before that one is done, which that wait guaranteed.
+        static constexpr uint32_t VERTEX_SLICE_COUNT = MAX_FRAME_QUEUE_DEPTH + 1;
+        // The basic pipeline permutations build() can draw with: every
+        // combination of BasicShaderFeatures.
+        static constexpr uint32_t VARIANT_KEY_COUNT = BASIC_FEATURE_DESATURATE << 1;
+
+        void create(Device& device) {
+            BufferDesc desc{};
+            desc.size = static_cast<uint64_t>(VERTEX_SLICE_SIZE) * VERTEX_SLICE_COUNT;
+            desc.usage = BUFFER_USAGE_VERTEX;
+            desc.hostVisible = true;
+            m_vertexBuffer = device.createBuffer(desc);
+
+            uint16_t indices[AppSceneFrame::INDEX_COUNT];
+            const uint16_t quad[6] = { 0, 1, 2, 2, 3, 0 };
+            for (uint32_t tile = 0; tile < AppSceneFrame::TILE_COUNT; tile++) {
+                for (uint32_t i = 0; i < 6; i++) {
+                    indices[tile * 6 + i] = static_cast<uint16_t>(tile * 4 + quad[i]);
+                }
+            }
+            desc.size = sizeof(indices);
+            desc.usage = BUFFER_USAGE_INDEX;
+            desc.hostVisible = false;
+            desc.initialData = indices;
+            m_indexBuffer = device.createBuffer(desc);
+
+            // Looked up once here rather than when the key changes, so build()
+            // never calls into the device. A permutation that fails to build
+            // stays null and its frames draw no floor.
+            for (uint32_t variantKey = 0; variantKey < VARIANT_KEY_COUNT; variantKey++) {
+                m_pipelines[variantKey] = device.basicPipeline(variantKey);
+            }
+        }
+
+        // Fills out with the floor of app frame `frame`, drawn with the
+        // variantKey permutation. Call it only for frames that reach
+        // submit(): each call takes the next vertex slice, and slices are
+        // only safe to reuse when every frame in between was drawn. Returns
+        // false, leaving nothing to submit, if there is nothing to draw.
+        bool build(AppSceneFrame& out, uint64_t frame, uint32_t variantKey) {
+            out.stream = {};
+            const PipelineHandle pipeline = variantKey < VARIANT_KEY_COUNT ? m_pipelines[variantKey] : PipelineHandle{};
+            if (!m_vertexBuffer || !m_indexBuffer || !pipeline) {
+                return false;
+            }
+
+            buildVertices(out.vertices, frame);
+            out.vertexOffset = static_cast<uint32_t>(m_builtFrames++ % VERTEX_SLICE_COUNT) * VERTEX_SLICE_SIZE;
+
+            out.arena.reset();
+            CommandEncoder encoder(out.arena);
+            encoder.bindPipeline(pipeline);
+            encoder.bindVertexBuffer(m_vertexBuffer, out.vertexOffset);
+            encoder.bindIndexBuffer(m_indexBuffer, IndexType::UInt16);
+            for (uint32_t tile = 0; tile < AppSceneFrame::TILE_COUNT; tile++) {
+                encoder.drawIndexed(6, 1, tile * 6);
+            }
+            out.stream = encoder.finish();
+            return !out.stream.empty();
+        }
+
+        // Uploads a built frame's vertices into its slice and submits its
+        // stream. Nothing else happens on this side.
+        void submit(Device& device, const AppSceneFrame& frame) {
+            auto* mapped = static_cast<uint8_t*>(device.getMappedData(m_vertexBuffer));
+            if (!mapped || frame.stream.empty()) {
+                return;
+            }
+            memcpy(mapped + frame.vertexOffset, frame.vertices, sizeof(frame.vertices));
+            device.submit(frame.stream);
+        }
+
+        void destroy(Device& device) {
+            if (m_vertexBuffer) {
+                device.destroyBuffer(m_vertexBuffer);
+                m_vertexBuffer = {};
+            }
+            if (m_indexBuffer) {
+                device.destroyBuffer(m_indexBuffer);
+                m_indexBuffer = {};
+            }
+        }
+
+    private:
+        // A checkerboard at z = -0.75 with a brightness wave running across
+        // it. Only the colors change from frame to frame.
+        static void buildVertices(AppSceneVertex* vertices, uint64_t frame) {
+            constexpr uint32_t TILES_PER_SIDE = AppSceneFrame::TILES_PER_SIDE;
+            constexpr float extent = 1.5f;
+            constexpr float tileSize = 2.0f * extent / TILES_PER_SIDE;
+            const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+            const float time = static_cast<float>(frame % 3600) * 0.05f;
+
+            for (uint32_t y = 0; y < TILES_PER_SIDE; y++) {
+                for (uint32_t x = 0; x < TILES_PER_SIDE; x++) {
+                    const float base = (x + y) % 2 ? 0.35f : 0.6f;
+                    const float brightness = base * (0.75f + 0.25f * std::sin(time + 0.8f * (x + y)));
+                    AppSceneVertex* tile = vertices + (y * TILES_PER_SIDE + x) * 4;
+                    for (uint32_t corner = 0; corner < 4; corner++) {
+                        tile[corner] = {
+                            { -extent + (x + corners[corner][0]) * tileSize, -extent + (y + corners[corner][1]) * tileSize, -0.75f },
+                            { brightness, brightness, brightness * 1.1f },
+                        };
+                    }
+                }
+            }
+        }
+
+        BufferHandle m_vertexBuffer;
+        BufferHandle m_indexBuffer;
+        PipelineHandle m_pipelines[VARIANT_KEY_COUNT];
+        // Frames build() has filled, which picks the vertex slice.
+        uint64_t m_builtFrames = 0;
+    };
+}
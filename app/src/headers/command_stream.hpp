@@ -0,0 +1,178 @@
+#pragma once
+
+#include <handle_pool.hpp>
+#include <linear_arena.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Nashi {
+    // Backend-agnostic command packets. Each packet starts with a header and
+    // is padded to COMMAND_PACKET_ALIGNMENT; resources are referenced by
+    // handle, so a packet is a handful of bytes and needs no heap allocation.
+    // Packets live in COMMAND_BLOCK_SIZE blocks of a LinearArena and blocks
+    // are chained with Jump packets, which CommandStream hides.
+    constexpr size_t COMMAND_PACKET_ALIGNMENT = 8;
+    constexpr size_t COMMAND_BLOCK_SIZE = 4096;
+    // Matches the minimum push constant size Vulkan guarantees.
+    constexpr uint32_t MAX_COMMAND_CONSTANTS_SIZE = 128;
+
+    enum class CommandType : uint16_t {
+        End,
+        Jump,
+        BindPipeline,
+        BindVertexBuffer,
+        BindIndexBuffer,
+        SetConstants,
+        Draw,
+        DrawIndexed,
+        Dispatch,
+        CopyBuffer,
+    };
+
+    enum class IndexType : uint32_t {
+        UInt16,
+        UInt32,
+    };
+
+    struct CommandHeader {
+        CommandType type;
+        // Whole packet including the header and any trailing payload.
+        uint16_t size;
+    };
+
+    struct CmdJump {
+        CommandHeader header;
+        const CommandHeader* next;
+    };
+
+    struct CmdBindPipeline {
+        CommandHeader header;
+        PipelineHandle pipeline;
+    };
+
+    // Pipelines take one interleaved vertex stream, laid out as their
+    // reflection describes (ShaderReflection::vertexLayout).
+    struct CmdBindVertexBuffer {
+        CommandHeader header;
+        BufferHandle buffer;
+        uint32_t offset;
+    };
+
+    struct CmdBindIndexBuffer {
+        CommandHeader header;
+        BufferHandle buffer;
+        uint32_t offset;
+        IndexType indexType;
+    };
+
+    // Followed by size bytes of data. Maps to push constants on Vulkan, root
+    // constants on D3D12 and, on GL, the gl_DrawID-th block of a storage
+    // buffer at GL_CONSTANTS_BINDING, so draws keep batching across updates.
+    // Every BindPipeline sets them back to zero.
+    struct CmdSetConstants {
+        CommandHeader header;
+        uint16_t offset;
+        uint16_t size;
+
+        const void* data() const { return this + 1; }
+    };
+
+    struct CmdDraw {
+        CommandHeader header;
+        uint32_t vertexCount;
+        uint32_t instanceCount;
+        uint32_t firstVertex;
+        uint32_t firstInstance;
+    };
+
+    struct CmdDrawIndexed {
+        CommandHeader header;
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t firstInstance;
+    };
+
+    struct CmdDispatch {
+        CommandHeader header;
+        uint32_t groupCountX;
+        uint32_t groupCountY;
+        uint32_t groupCountZ;
+    };
+
+    struct CmdCopyBuffer {
+        CommandHeader header;
+        BufferHandle src;
+        BufferHandle dst;
+        uint32_t srcOffset;
+        uint32_t dstOffset;
+        uint32_t size;
+    };
+
+    template<typename T>
+    const T& commandAs(const CommandHeader* cmd) {
+        return *reinterpret_cast<const T*>(cmd);
+    }
+
+    // Read side of a finished encoder. Backends walk it with
+    //   for (auto* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd))
+    // and never see End or Jump packets.
+    struct CommandStream {
+        const CommandHeader* head = nullptr;
+
+        const CommandHeader* first() const { return resolve(head); }
+
+        static const CommandHeader* next(const CommandHeader* cmd) {
+            return resolve(reinterpret_cast<const CommandHeader*>(reinterpret_cast<const uint8_t*>(cmd) + cmd->size));
+        }
+
+        bool empty() const { return first() == nullptr; }
+
+    private:
+        static const CommandHeader* resolve(const CommandHeader* cmd) {
+            while (cmd && cmd->type == CommandType::Jump) {
+                cmd = commandAs<CmdJump>(cmd).next;
+            }
+            return cmd && cmd->type != CommandType::End ? cmd : nullptr;
+        }
+    };
+
+    // Records packets into an arena shared with other encoders. One encoder
+    // per thread; the arena itself is thread safe. States not set in a stream
+    // are undefined at its start, so every stream binds what it uses.
+    class CommandEncoder {
+    public:
+        explicit CommandEncoder(LinearArena& arena) : m_arena(arena) {}
+
+        void bindPipeline(PipelineHandle pipeline);
+        void bindVertexBuffer(BufferHandle buffer, uint32_t offset = 0);
+        void bindIndexBuffer(BufferHandle buffer, IndexType indexType, uint32_t offset = 0);
+        void setConstants(const void* data, uint32_t size, uint32_t offset = 0);
+        void draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0);
+        void drawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0,
+            int32_t vertexOffset = 0, uint32_t firstInstance = 0);
+        void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+        void copyBuffer(BufferHandle src, uint32_t srcOffset, BufferHandle dst, uint32_t dstOffset, uint32_t size);
+
+        // Terminates the stream. When the arena ran out, the stream holds
+        // everything recorded before that. The encoder can then record the
+        // next stream.
+        CommandStream finish();
+        // Whether the stream being recorded lost packets; ask before
+        // finish(), which clears it.
+        bool overflowed() const { return m_overflowed; }
+
+    private:
+        template<typename T>
+        T* push(CommandType type, size_t payload = 0);
+        uint8_t* reserve(size_t size);
+
+        LinearArena& m_arena;
+        uint8_t* m_head = nullptr;
+        uint8_t* m_cursor = nullptr;
+        uint8_t* m_blockEnd = nullptr;
+        bool m_overflowed = false;
+    };
+}
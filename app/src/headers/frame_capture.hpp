@@ -0,0 +1,344 @@
+#pragma once
+
+#include <command_stream.hpp>
+#include <renderer.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Nashi {
+    // On-disk layout of a frame capture (.ncap), written by FrameCaptureWriter:
+    //   FrameCaptureHeader
+    //   records, each a FrameCaptureRecord and its payload, padded to
+    //   FRAME_CAPTURE_ALIGNMENT
+    // Every frame's records end with an EndFrame record. Handles are the
+    // capturing run's and command packets are stored as the encoder laid
+    // them out, so a capture only replays on a build of the same version.
+    constexpr uint32_t FRAME_CAPTURE_MAGIC = 0x5041434E; // "NCAP"
+    constexpr uint32_t FRAME_CAPTURE_VERSION = 1;
+    constexpr uint32_t FRAME_CAPTURE_ALIGNMENT = 8;
+
+    struct FrameCaptureHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t frameCount;
+        uint32_t reserved;
+    };
+
+    enum class CaptureRecordType : uint16_t {
+        // CaptureCreateBuffer, then size bytes of initial data if it had any.
+        CreateBuffer,
+        // CaptureBuffer.
+        DestroyBuffer,
+        // CaptureBasicPipeline.
+        BasicPipeline,
+        // CaptureWriteBuffer, then the bytes the application wrote through
+        // getMappedData() since the previous frame.
+        WriteBuffer,
+        // The stream's packets back to back, without End and Jump packets.
+        Submit,
+        // draw(); no payload.
+        EndFrame,
+    };
+
+    struct FrameCaptureRecord {
+        CaptureRecordType type;
+        uint16_t reserved;
+        // Payload bytes, not counting the padding after them.
+        uint32_t size;
+    };
+
+    struct CaptureCreateBuffer {
+        uint32_t buffer;
+        uint32_t usage;
+        uint64_t size;
+        uint32_t hostVisible;
+        uint32_t hasInitialData;
+    };
+
+    struct CaptureBuffer {
+        uint32_t buffer;
+        uint32_t reserved;
+    };
+
+    struct CaptureBasicPipeline {
+        uint32_t pipeline;
+        uint32_t variantKey;
+    };
+
+    struct CaptureWriteBuffer {
+        uint32_t buffer;
+        uint32_t reserved;
+        uint64_t offset;
+    };
+
+    class FrameCaptureWriter {
+    public:
+        FrameCaptureWriter() = default;
+        ~FrameCaptureWriter();
+
+        FrameCaptureWriter(const FrameCaptureWriter&) = delete;
+        FrameCaptureWriter& operator=(const FrameCaptureWriter&) = delete;
+
+        bool open(const std::filesystem::path& path);
+        // Fills in the frame count. Returns false if any write failed.
+        bool close();
+        bool isOpen() const { return m_file.is_open(); }
+        uint32_t frameCount() const { return m_frameCount; }
+
+        void createBuffer(BufferHandle buffer, const BufferDesc& desc);
+        void destroyBuffer(BufferHandle buffer);
+        void basicPipeline(PipelineHandle pipeline, uint32_t variantKey);
+        void writeBuffer(BufferHandle buffer, uint64_t offset, const void* data, uint64_t size);
+        void submit(const CommandStream& stream);
+        void endFrame();
+
+    private:
+        void beginRecord(CaptureRecordType type, uint64_t size);
+        void write(const void* data, uint64_t size);
+        void endRecord();
+
+        std::ofstream m_file;
+        uint32_t m_frameCount = 0;
+        uint64_t m_recordSize = 0;
+    };
+
+    // One record of a loaded capture; payload points into the reader.
+    struct CaptureRecord {
+        CaptureRecordType type;
+        const uint8_t* payload;
+        uint32_t size;
+
+        template<typename T>
+        const T& as() const { return *reinterpret_cast<const T*>(payload); }
+        // What follows the fixed part, e.g. the bytes of a WriteBuffer.
+        template<typename T>
+        const uint8_t* trailing() const { return payload + sizeof(T); }
+    };
+
+    // Loads a whole capture into memory and checks that every record is
+    // complete, so replay never touches the file.
+    class FrameCaptureReader {
+    public:
+        bool open(const std::filesystem::path& path, std::string& error);
+
+        uint32_t frameCount() const { return static_cast<uint32_t>(m_frameStarts.size()); }
+        // The frame's records, its EndFrame last.
+        std::span<const CaptureRecord> frame(uint32_t index) const;
+        std::span<const CaptureRecord> records() const { return m_records; }
+
+    private:
+        std::vector<uint8_t> m_data;
+        std::vector<CaptureRecord> m_records;
+        std::vector<size_t> m_frameStarts;
+    };
+
+    // Capture handles to the ones the replaying renderer handed out.
+    struct CaptureHandleMap {
+        std::unordered_map<uint32_t, BufferHandle> buffers;
+        std::unordered_map<uint32_t, PipelineHandle> pipelines;
+
+        // Empty handles for anything the capture did not create.
+        BufferHandle buffer(BufferHandle captured) const;
+        PipelineHandle pipeline(PipelineHandle captured) const;
+    };
+
+    // Re-records a Submit record's packets with the replay's handles.
+    // Returns false if a packet is malformed or the encoder overflowed.
+    bool encodeCapturedStream(const CaptureRecord& submit, const CaptureHandleMap& handles, CommandEncoder& encoder);
+
+    // What a replay created so far, by capture handle.
+    struct CaptureReplayState {
+        CaptureHandleMap handles;
+        std::unordered_map<uint32_t, uint64_t> bufferSizes;
+    };
+
+    // Creates, destroys and writes buffers and looks up pipelines; Submit and
+    // EndFrame records are up to the caller.
+    template<typename Renderer>
+    void applyCaptureResourceRecord(Renderer& renderer, const CaptureRecord& record, CaptureReplayState& state) {
+        switch (record.type) {
+        case CaptureRecordType::CreateBuffer: {
+            const auto& create = record.as<CaptureCreateBuffer>();
+            BufferDesc desc{};
+            desc.size = create.size;
+            desc.usage = create.usage;
+            desc.hostVisible = create.hostVisible != 0;
+            desc.initialData = create.hasInitialData ? record.trailing<CaptureCreateBuffer>() : nullptr;
+            state.handles.buffers[create.buffer] = renderer.createBuffer(desc);
+            state.bufferSizes[create.buffer] = create.size;
+            break;
+        }
+        case CaptureRecordType::DestroyBuffer: {
+            const uint32_t captured = record.as<CaptureBuffer>().buffer;
+            auto found = state.handles.buffers.find(captured);
+            if (found != state.handles.buffers.end()) {
+                renderer.destroyBuffer(found->second);
+                state.handles.buffers.erase(found);
+                state.bufferSizes.erase(captured);
+            }
+            break;
+        }
+        case CaptureRecordType::BasicPipeline: {
+            const auto& basic = record.as<CaptureBasicPipeline>();
+            state.handles.pipelines[basic.pipeline] = renderer.basicPipeline(basic.variantKey);
+            break;
+        }
+        case CaptureRecordType::WriteBuffer: {
+            const auto& write = record.as<CaptureWriteBuffer>();
+            const uint64_t size = record.size - sizeof(CaptureWriteBuffer);
+            auto* mapped = static_cast<uint8_t*>(renderer.getMappedData(state.handles.buffer({ write.buffer })));
+            auto bufferSize = state.bufferSizes.find(write.buffer);
+            if (mapped && bufferSize != state.bufferSizes.end() && write.offset + size <= bufferSize->second) {
+                memcpy(mapped + write.offset, record.trailing<CaptureWriteBuffer>(), size);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Forwards the resource and submission calls of an application to
+    // renderer and records them for the next frameCount draw() calls, then
+    // closes the capture. Create it before the application creates any
+    // resources; streams that use older handles would not replay.
+    //
+    // Writes through getMappedData() cannot be intercepted, so every
+    // host-visible buffer keeps a shadow copy and draw() records the range
+    // that differs from it. That reads mapped memory back once per frame,
+    // which is slow on write-combined heaps but only costs while capturing.
+    template<typename Renderer>
+    class FrameRecorder {
+    public:
+        FrameRecorder(Renderer& renderer, const std::filesystem::path& path, uint32_t frameCount)
+            : m_renderer(renderer), m_path(path), m_framesLeft(frameCount) {
+            if (frameCount > 0 && !m_writer.open(path)) {
+                std::cerr << "failed to open capture " << path.string() << std::endl;
+                m_framesLeft = 0;
+            }
+        }
+
+        ~FrameRecorder() { finish(); }
+
+        FrameRecorder(const FrameRecorder&) = delete;
+        FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+        bool capturing() const { return m_writer.isOpen(); }
+
+        BufferHandle createBuffer(const BufferDesc& desc) {
+            BufferHandle buffer = m_renderer.createBuffer(desc);
+            if (capturing() && buffer) {
+                m_writer.createBuffer(buffer, desc);
+                if (desc.hostVisible) {
+                    std::vector<uint8_t>& shadow = m_shadows[buffer.value];
+                    shadow.assign(desc.size, 0);
+                    if (desc.initialData) {
+                        memcpy(shadow.data(), desc.initialData, desc.size);
+                    }
+                }
+            }
+            return buffer;
+        }
+
+        void destroyBuffer(BufferHandle buffer) {
+            if (capturing()) {
+                m_writer.destroyBuffer(buffer);
+                m_shadows.erase(buffer.value);
+            }
+            m_renderer.destroyBuffer(buffer);
+        }
+
+        void* getMappedData(BufferHandle buffer) {
+            return m_renderer.getMappedData(buffer);
+        }
+
+        PipelineHandle basicPipeline(uint32_t variantKey) {
+            PipelineHandle pipeline = m_renderer.basicPipeline(variantKey);
+            if (capturing() && pipeline) {
+                m_writer.basicPipeline(pipeline, variantKey);
+            }
+            return pipeline;
+        }
+
+        LinearArena& frameArena() {
+            return m_renderer.frameArena();
+        }
+
+        void submit(const CommandStream& stream) {
+            if (capturing()) {
+                m_writer.submit(stream);
+            }
+            m_renderer.submit(stream);
+        }
+
+        void draw() {
+            endFrame();
+            m_renderer.draw();
+        }
+
+        // draw() without the renderer's draw(), for callers that make that
+        // call themselves; call it right before.
+        void endFrame() {
+            if (!capturing()) {
+                return;
+            }
+            recordMappedWrites();
+            m_writer.endFrame();
+            if (--m_framesLeft == 0) {
+                finish();
+            }
+        }
+
+    private:
+        void recordMappedWrites() {
+            for (auto& [value, shadow] : m_shadows) {
+                const BufferHandle buffer{ value };
+                const auto* mapped = static_cast<const uint8_t*>(m_renderer.getMappedData(buffer));
+                if (!mapped) {
+                    continue;
+                }
+                size_t first = 0;
+                while (first < shadow.size() && mapped[first] == shadow[first]) {
+                    first++;
+                }
+                if (first == shadow.size()) {
+                    continue;
+                }
+                size_t end = shadow.size();
+                while (mapped[end - 1] == shadow[end - 1]) {
+                    end--;
+                }
+                memcpy(shadow.data() + first, mapped + first, end - first);
+                m_writer.writeBuffer(buffer, first, shadow.data() + first, end - first);
+            }
+        }
+
+        void finish() {
+            if (!capturing()) {
+                return;
+            }
+            const uint32_t frames = m_writer.frameCount();
+            if (m_writer.close()) {
+                std::cout << "captured " << frames << " frames to " << m_path.string() << std::endl;
+            }
+            else {
+                std::cerr << "failed to write capture " << m_path.string() << std::endl;
+            }
+            m_shadows.clear();
+        }
+
+        Renderer& m_renderer;
+        std::filesystem::path m_path;
+        FrameCaptureWriter m_writer;
+        uint32_t m_framesLeft;
+        std::unordered_map<uint32_t, std::vector<uint8_t>> m_shadows;
+    };
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef NASHI_VR
+
+#include <SDL3/SDL.h>
+
+#include <cstdint>
+
+namespace Nashi {
+    // Upper bound of FramePacingPolicy::frameQueueDepth. Backends allocate
+    // per-frame resources for this many frames and only cycle through the
+    // first frameQueueDepth of them, so the depth can change at runtime.
+    constexpr uint32_t MAX_FRAME_QUEUE_DEPTH = 4;
+
+    enum class PresentMode {
+        Immediate,
+        Mailbox,
+        Fifo,
+        FifoRelaxed,
+    };
+
+    struct FramePacingPolicy {
+        PresentMode presentMode = PresentMode::Mailbox;
+        // Frames the CPU may run ahead of the GPU, 1..MAX_FRAME_QUEUE_DEPTH.
+        uint32_t frameQueueDepth = 2;
+        // 0 disables the limiter.
+        double frameLimitHz = 0.0;
+        // Write the camera UBO right before submit, after the limiter wait,
+        // instead of at the start of the frame.
+        bool lateLatchCamera = false;
+        // Print average frame time and input-to-present latency once a second.
+        bool logLatency = false;
+    };
+
+    // Parses --present=immediate|mailbox|fifo|fifo-relaxed, --frames=N,
+    // --fps=N, --late-latch and --latency-log. Unknown arguments are ignored.
+    FramePacingPolicy parseFramePacingArgs(int argc, char** argv);
+
+    const char* presentModeName(PresentMode mode);
+
+    // Shared by all backends: paces frame starts against absolute deadlines,
+    // so one slow frame does not shift every later one, and measures the time
+    // from the oldest unhandled input event to the present that reflects it.
+    class FramePacer {
+    public:
+        void setPolicy(const FramePacingPolicy& policy);
+        const FramePacingPolicy& policy() const { return m_policy; }
+
+        // Sleeps until the next frame deadline when a limit is set.
+        void limit();
+
+        // timestampNs is on the SDL_GetTicksNS clock, e.g. SDL_Event::common.timestamp.
+        void markInput(uint64_t timestampNs);
+
+        // Call right after the present call has been issued.
+        void onPresent();
+
+        uint64_t lastInputLatencyNs() const { return m_lastInputLatencyNs; }
+
+    private:
+        FramePacingPolicy m_policy;
+
+        uint64_t m_nextDeadlineNs = 0;
+        uint64_t m_pendingInputNs = 0;
+        uint64_t m_lastInputLatencyNs = 0;
+        uint64_t m_lastPresentNs = 0;
+
+        uint64_t m_logStartNs = 0;
+        uint64_t m_logFrames = 0;
+        uint64_t m_logFrameTimeNs = 0;
+        uint64_t m_logInputs = 0;
+        uint64_t m_logInputLatencyNs = 0;
+    };
+}
+
+#endif
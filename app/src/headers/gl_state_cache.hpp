@@ -0,0 +1,322 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace Nashi {
+    constexpr uint32_t GL_STATE_INDEXED_BINDINGS = 16;
+    constexpr uint32_t GL_STATE_TEXTURE_UNITS = 32;
+
+    struct GLStateCacheStats {
+        // GL calls that reached the driver and calls dropped as redundant.
+        uint32_t issued = 0;
+        uint32_t skipped = 0;
+    };
+
+    // Shadow of the context state the GL backend touches. Every setter
+    // compares against the last value it set and only calls GL on a change.
+    // Values start unknown, so the first set of each is always issued; call
+    // invalidate() after anything changed state behind the cache's back.
+    // Objects must be forgotten when deleted, since GL recycles names.
+    class GLStateCache {
+    public:
+        GLStateCache() { invalidate(); }
+
+        void invalidate() {
+            m_program = UNKNOWN;
+            m_vertexArray = UNKNOWN;
+            for (GLuint& buffer : m_buffers) {
+                buffer = UNKNOWN;
+            }
+            for (IndexedBinding& binding : m_uniformBindings) {
+                binding.buffer = UNKNOWN;
+            }
+            for (IndexedBinding& binding : m_storageBindings) {
+                binding.buffer = UNKNOWN;
+            }
+            for (GLuint& texture : m_textures) {
+                texture = UNKNOWN;
+            }
+            for (uint8_t& enabled : m_capabilities) {
+                enabled = UNKNOWN_FLAG;
+            }
+            m_depthFunc = UNKNOWN;
+            m_depthMask = UNKNOWN_FLAG;
+            m_blendSource = UNKNOWN;
+            m_blendDestination = UNKNOWN;
+            m_cullFace = UNKNOWN;
+            m_frontFace = UNKNOWN;
+            m_clearColorKnown = false;
+            m_viewportKnown = false;
+        }
+
+        void useProgram(GLuint program) {
+            if (skip(m_program == program)) {
+                return;
+            }
+            m_program = program;
+            glUseProgram(program);
+        }
+
+        void bindVertexArray(GLuint vertexArray) {
+            if (skip(m_vertexArray == vertexArray)) {
+                return;
+            }
+            m_vertexArray = vertexArray;
+            glBindVertexArray(vertexArray);
+        }
+
+        // GL_ELEMENT_ARRAY_BUFFER belongs to the VAO; set it with
+        // glVertexArrayElementBuffer instead.
+        void bindBuffer(GLenum target, GLuint buffer) {
+            const int slot = bufferSlot(target);
+            if (slot < 0) {
+                m_stats.issued++;
+                glBindBuffer(target, buffer);
+                return;
+            }
+            if (skip(m_buffers[slot] == buffer)) {
+                return;
+            }
+            m_buffers[slot] = buffer;
+            glBindBuffer(target, buffer);
+        }
+
+        // Also binds the generic target, like GL does.
+        void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+            IndexedBinding* binding = indexedBinding(target, index);
+            if (!binding) {
+                m_stats.issued++;
+                glBindBufferRange(target, index, buffer, offset, size);
+                return;
+            }
+            if (skip(binding->buffer == buffer && binding->offset == offset && binding->size == size)) {
+                return;
+            }
+            *binding = { buffer, offset, size };
+            m_buffers[bufferSlot(target)] = buffer;
+            glBindBufferRange(target, index, buffer, offset, size);
+        }
+
+        void bindTextureUnit(GLuint unit, GLuint texture) {
+            if (unit >= GL_STATE_TEXTURE_UNITS) {
+                m_stats.issued++;
+                glBindTextureUnit(unit, texture);
+                return;
+            }
+            if (skip(m_textures[unit] == texture)) {
+                return;
+            }
+            m_textures[unit] = texture;
+            glBindTextureUnit(unit, texture);
+        }
+
+        void setEnabled(GLenum capability, bool enabled) {
+            const int slot = capabilitySlot(capability);
+            if (slot >= 0) {
+                if (skip(m_capabilities[slot] == static_cast<uint8_t>(enabled))) {
+                    return;
+                }
+                m_capabilities[slot] = static_cast<uint8_t>(enabled);
+            }
+            else {
+                m_stats.issued++;
+            }
+            if (enabled) {
+                glEnable(capability);
+            }
+            else {
+                glDisable(capability);
+            }
+        }
+
+        void depthFunc(GLenum func) {
+            if (skip(m_depthFunc == func)) {
+                return;
+            }
+            m_depthFunc = func;
+            glDepthFunc(func);
+        }
+
+        void depthMask(bool write) {
+            if (skip(m_depthMask == static_cast<uint8_t>(write))) {
+                return;
+            }
+            m_depthMask = static_cast<uint8_t>(write);
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+        }
+
+        void blendFunc(GLenum source, GLenum destination) {
+            if (skip(m_blendSource == source && m_blendDestination == destination)) {
+                return;
+            }
+            m_blendSource = source;
+            m_blendDestination = destination;
+            glBlendFunc(source, destination);
+        }
+
+        void cullFace(GLenum face) {
+            if (skip(m_cullFace == face)) {
+                return;
+            }
+            m_cullFace = face;
+            glCullFace(face);
+        }
+
+        void frontFace(GLenum winding) {
+            if (skip(m_frontFace == winding)) {
+                return;
+            }
+            m_frontFace = winding;
+            glFrontFace(winding);
+        }
+
+        void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+            const GLfloat color[4] = { r, g, b, a };
+            if (skip(m_clearColorKnown && memcmp(m_clearColor, color, sizeof(color)) == 0)) {
+                return;
+            }
+            memcpy(m_clearColor, color, sizeof(color));
+            m_clearColorKnown = true;
+            glClearColor(r, g, b, a);
+        }
+
+        void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+            const GLint rect[4] = { x, y, width, height };
+            if (skip(m_viewportKnown && memcmp(m_viewport, rect, sizeof(rect)) == 0)) {
+                return;
+            }
+            memcpy(m_viewport, rect, sizeof(rect));
+            m_viewportKnown = true;
+            glViewport(x, y, width, height);
+        }
+
+        // Deleting a bound buffer or vertex array resets its bindings to 0;
+        // a deleted program stays current until the next glUseProgram, but
+        // its name may be handed out again afterwards.
+        void forgetBuffer(GLuint buffer) {
+            for (GLuint& bound : m_buffers) {
+                if (bound == buffer) {
+                    bound = 0;
+                }
+            }
+            for (IndexedBinding& binding : m_uniformBindings) {
+                if (binding.buffer == buffer) {
+                    binding.buffer = 0;
+                }
+            }
+            for (IndexedBinding& binding : m_storageBindings) {
+                if (binding.buffer == buffer) {
+                    binding.buffer = 0;
+                }
+            }
+        }
+
+        void forgetVertexArray(GLuint vertexArray) {
+            if (m_vertexArray == vertexArray) {
+                m_vertexArray = 0;
+            }
+        }
+
+        void forgetProgram(GLuint program) {
+            if (m_program == program) {
+                m_program = UNKNOWN;
+            }
+        }
+
+        void forgetTexture(GLuint texture) {
+            for (GLuint& bound : m_textures) {
+                if (bound == texture) {
+                    bound = 0;
+                }
+            }
+        }
+
+        // Counts since the previous endFrame().
+        GLStateCacheStats endFrame() {
+            GLStateCacheStats stats = m_stats;
+            m_stats = {};
+            return stats;
+        }
+
+    private:
+        // Never a name GL hands out, so comparing against it always misses.
+        static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+        static constexpr uint8_t UNKNOWN_FLAG = 0xFF;
+
+        struct IndexedBinding {
+            GLuint buffer;
+            GLintptr offset;
+            GLsizeiptr size;
+        };
+
+        GLuint m_program;
+        GLuint m_vertexArray;
+        GLuint m_buffers[8];
+        IndexedBinding m_uniformBindings[GL_STATE_INDEXED_BINDINGS];
+        IndexedBinding m_storageBindings[GL_STATE_INDEXED_BINDINGS];
+        GLuint m_textures[GL_STATE_TEXTURE_UNITS];
+        uint8_t m_capabilities[5];
+        GLenum m_depthFunc;
+        uint8_t m_depthMask;
+        GLenum m_blendSource;
+        GLenum m_blendDestination;
+        GLenum m_cullFace;
+        GLenum m_frontFace;
+        GLfloat m_clearColor[4];
+        bool m_clearColorKnown;
+        GLint m_viewport[4];
+        bool m_viewportKnown;
+
+        GLStateCacheStats m_stats;
+
+        bool skip(bool redundant) {
+            if (redundant) {
+                m_stats.skipped++;
+            }
+            else {
+                m_stats.issued++;
+            }
+            return redundant;
+        }
+
+        // Targets outside these are passed through uncached.
+        static int bufferSlot(GLenum target) {
+            switch (target) {
+            case GL_ARRAY_BUFFER: return 0;
+            case GL_UNIFORM_BUFFER: return 1;
+            case GL_SHADER_STORAGE_BUFFER: return 2;
+            case GL_DRAW_INDIRECT_BUFFER: return 3;
+            case GL_DISPATCH_INDIRECT_BUFFER: return 4;
+            case GL_COPY_READ_BUFFER: return 5;
+            case GL_COPY_WRITE_BUFFER: return 6;
+            case GL_PIXEL_UNPACK_BUFFER: return 7;
+            default: return -1;
+            }
+        }
+
+        IndexedBinding* indexedBinding(GLenum target, GLuint index) {
+            if (index >= GL_STATE_INDEXED_BINDINGS) {
+                return nullptr;
+            }
+            switch (target) {
+            case GL_UNIFORM_BUFFER: return &m_uniformBindings[index];
+            case GL_SHADER_STORAGE_BUFFER: return &m_storageBindings[index];
+            default: return nullptr;
+            }
+        }
+
+        static int capabilitySlot(GLenum capability) {
+            switch (capability) {
+            case GL_DEPTH_TEST: return 0;
+            case GL_BLEND: return 1;
+            case GL_CULL_FACE: return 2;
+            case GL_SCISSOR_TEST: return 3;
+            case GL_FRAMEBUFFER_SRGB: return 4;
+            default: return -1;
+            }
+        }
+    };
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Nashi {
+    // 32-bit generational handle: the low HANDLE_INDEX_BITS address a slot,
+    // the rest count how often that slot was reused. Slot indices are stable
+    // for the lifetime of a resource, so index() doubles as a bindless index.
+    // The value 0 is never handed out and means "no resource".
+    constexpr uint32_t HANDLE_INDEX_BITS = 20;
+    constexpr uint32_t HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+    constexpr uint32_t HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+
+    template<typename Tag>
+    struct Handle {
+        uint32_t value = 0;
+
+        static Handle make(uint32_t index, uint32_t generation) {
+            return { (generation << HANDLE_INDEX_BITS) | index };
+        }
+
+        uint32_t index() const { return value & HANDLE_INDEX_MASK; }
+        uint32_t generation() const { return value >> HANDLE_INDEX_BITS; }
+
+        explicit operator bool() const { return value != 0; }
+        bool operator==(const Handle&) const = default;
+    };
+
+    using BufferHandle = Handle<struct BufferTag>;
+    using ImageHandle = Handle<struct ImageTag>;
+    using SamplerHandle = Handle<struct SamplerTag>;
+    using PipelineHandle = Handle<struct PipelineTag>;
+
+    // Slot map: objects live in a dense array that is iterated and grown
+    // without holes, slots map handles to dense positions. create, get and
+    // remove are O(1); removal moves the last object into the hole. A handle
+    // whose generation no longer matches its slot is stale and resolves to
+    // nullptr instead of aliasing the slot's new occupant.
+    template<typename T, typename Tag>
+    class HandlePool {
+    public:
+        using HandleType = Handle<Tag>;
+
+        HandleType create(T object) {
+            uint32_t index;
+            if (!m_freeSlots.empty()) {
+                index = m_freeSlots.back();
+                m_freeSlots.pop_back();
+            }
+            else {
+                assert(m_slots.size() < HANDLE_INDEX_MASK && "handle pool exhausted");
+                index = static_cast<uint32_t>(m_slots.size());
+                m_slots.push_back({ 0, 1 });
+            }
+
+            Slot& slot = m_slots[index];
+            slot.dense = static_cast<uint32_t>(m_objects.size());
+            m_objects.push_back(std::move(object));
+            m_denseToSlot.push_back(index);
+            return HandleType::make(index, slot.generation);
+        }
+
+        T* get(HandleType handle) {
+            const Slot* slot = find(handle);
+            return slot ? &m_objects[slot->dense] : nullptr;
+        }
+
+        const T* get(HandleType handle) const {
+            const Slot* slot = find(handle);
+            return slot ? &m_objects[slot->dense] : nullptr;
+        }
+
+        bool contains(HandleType handle) const { return find(handle) != nullptr; }
+
+        // Hands the object back so the backend can destroy it, possibly
+        // deferred; the handle is stale from here on.
+        std::optional<T> remove(HandleType handle) {
+            const Slot* found = find(handle);
+            if (!found) {
+                return std::nullopt;
+            }
+
+            uint32_t index = handle.index();
+            uint32_t dense = found->dense;
+            T object = std::move(m_objects[dense]);
+
+            if (dense + 1 != m_objects.size()) {
+                m_objects[dense] = std::move(m_objects.back());
+                m_denseToSlot[dense] = m_denseToSlot.back();
+                m_slots[m_denseToSlot[dense]].dense = dense;
+            }
+            m_objects.pop_back();
+            m_denseToSlot.pop_back();
+
+            retire(m_slots[index]);
+            m_freeSlots.push_back(index);
+            return object;
+        }
+
+        size_t size() const { return m_objects.size(); }
+        bool empty() const { return m_objects.empty(); }
+
+        // Dense iteration, in no particular order.
+        auto begin() { return m_objects.begin(); }
+        auto end() { return m_objects.end(); }
+        auto begin() const { return m_objects.begin(); }
+        auto end() const { return m_objects.end(); }
+
+        // Every handle handed out so far goes stale: the slots stay, with
+        // their generations bumped, and all of them become free.
+        void clear() {
+            for (uint32_t index : m_denseToSlot) {
+                retire(m_slots[index]);
+            }
+            m_objects.clear();
+            m_denseToSlot.clear();
+            m_freeSlots.clear();
+            for (uint32_t index = static_cast<uint32_t>(m_slots.size()); index > 0; index--) {
+                m_freeSlots.push_back(index - 1);
+            }
+        }
+
+    private:
+        struct Slot {
+            uint32_t dense;
+            uint32_t generation;
+        };
+
+        // Generation 0 is skipped so no live handle ever encodes to 0.
+        static void retire(Slot& slot) {
+            slot.generation = (slot.generation + 1) & HANDLE_GENERATION_MASK;
+            if (slot.generation == 0) {
+                slot.generation = 1;
+            }
+        }
+
+        const Slot* find(HandleType handle) const {
+            uint32_t index = handle.index();
+            if (!handle || index >= m_slots.size()) {
+                return nullptr;
+            }
+            const Slot& slot = m_slots[index];
+            if (slot.generation != handle.generation() || slot.dense >= m_objects.size() || m_denseToSlot[slot.dense] != index) {
+                return nullptr;
+            }
+            return &slot;
+        }
+
+        std::vector<T> m_objects;
+        std::vector<uint32_t> m_denseToSlot;
+        std::vector<Slot> m_slots;
+        std::vector<uint32_t> m_freeSlots;
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Nashi {
+    constexpr size_t FRAME_ARENA_SIZE = 4 * 1024 * 1024;
+    constexpr size_t SCRATCH_ARENA_SIZE = 1024 * 1024;
+
+    // Fixed-capacity bump allocator. allocate() is a single atomic add, so
+    // any number of threads can carve from the same arena; nothing is freed
+    // individually, reset() drops everything at once. The caller guarantees
+    // no thread is allocating while reset() runs.
+    class LinearArena {
+    public:
+        explicit LinearArena(size_t capacity);
+        ~LinearArena();
+
+        LinearArena(const LinearArena&) = delete;
+        LinearArena& operator=(const LinearArena&) = delete;
+
+        // Returns nullptr once the arena is exhausted. alignment must be a
+        // power of two no larger than alignof(std::max_align_t).
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        template<typename T>
+        T* allocate(size_t count = 1) {
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        void reset() { m_offset.store(0, std::memory_order_relaxed); }
+
+        // Single-owner stack discipline, see ScratchScope. Not safe while
+        // other threads allocate from the same arena.
+        size_t mark() const { return m_offset.load(std::memory_order_relaxed); }
+        void rewind(size_t mark) { m_offset.store(mark, std::memory_order_relaxed); }
+
+        size_t used() const;
+        size_t capacity() const { return m_capacity; }
+
+    private:
+        uint8_t* m_memory;
+        size_t m_capacity;
+        std::atomic<size_t> m_offset{ 0 };
+    };
+
+    // STL allocator over a LinearArena. deallocate is a no-op, so growing
+    // containers leave their old storage behind until the arena is reset;
+    // reserve() up front where the size is known. Throws std::bad_alloc when
+    // the arena is exhausted, like the default allocator.
+    template<typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(LinearArena& arena) : m_arena(&arena) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+        T* allocate(size_t count) {
+            T* memory = m_arena->allocate<T>(count);
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            return memory;
+        }
+
+        void deallocate(T*, size_t) {}
+
+        LinearArena* arena() const { return m_arena; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+
+    private:
+        LinearArena* m_arena;
+    };
+
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    // One arena per frame in flight. endFrame() moves on to the oldest arena
+    // and resets it, so transient data lives for frameCount draw() calls:
+    // anything recorded for a frame, including streams handed to
+    // IRenderer::submit, outlasts that frame's recording.
+    class FrameArenas {
+    public:
+        FrameArenas(size_t frameCount, size_t capacityPerFrame);
+
+        LinearArena& current() { return *m_arenas[m_current]; }
+        void endFrame();
+
+    private:
+        std::vector<std::unique_ptr<LinearArena>> m_arenas;
+        size_t m_current = 0;
+    };
+
+    // SCRATCH_ARENA_SIZE of per-thread memory for data that dies before the
+    // function returns. Always allocate under a ScratchScope.
+    LinearArena& scratchArena();
+
+    // Rewinds the thread's scratch arena on destruction; scopes nest.
+    class ScratchScope {
+    public:
+        ScratchScope() : m_arena(scratchArena()), m_mark(m_arena.mark()) {}
+        ~ScratchScope() { m_arena.rewind(m_mark); }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+        LinearArena& arena() { return m_arena; }
+
+        template<typename T>
+        ArenaAllocator<T> allocator() { return ArenaAllocator<T>(m_arena); }
+
+    private:
+        LinearArena& m_arena;
+        size_t m_mark;
+    };
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Shared by software_occlusion.cpp and software_occlusion_avx2.cpp. The AVX2
+// file is compiled with AVX2 enabled and picked at runtime, so this header
+// must stay free of standard library templates: an inline function
+// instantiated there could be merged with its baseline copy and execute AVX2
+// instructions on CPUs without them.
+namespace Nashi {
+    // Coarse depth buffer tiles are OCCLUSION_TILE_WIDTH x OCCLUSION_TILE_HEIGHT
+    // pixels; a row of a tile is one AVX2 register or two SSE registers.
+    constexpr int32_t OCCLUSION_TILE_WIDTH = 8;
+    constexpr int32_t OCCLUSION_TILE_HEIGHT = 8;
+    constexpr int32_t OCCLUSION_TILE_PIXELS = OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT;
+
+    // Screen-space triangle after setup: edge functions a*x + b*y + c that
+    // are >= 0 inside, a depth plane and an inclusive pixel bounding box.
+    // Depth is z / w of the clip-space position.
+    struct OcclusionTriangle {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        int32_t minX, minY, maxX, maxY;
+    };
+
+    // One set per instruction set; SoftwareOcclusionCuller picks the widest
+    // the CPU runs.
+    struct OcclusionKernels {
+        // Rasterizes the listed triangles into one tile's depth, keeping the
+        // nearest value per pixel. Returns the tile's farthest depth.
+        float (*rasterizeTile)(const OcclusionTriangle* triangles, const uint32_t* indices, size_t count,
+            int32_t tileX, int32_t tileY, float* depth) = nullptr;
+        // True when a pixel of the tile inside [minX, maxX] x [minY, maxY]
+        // (tile-local, inclusive) is at or behind nearestDepth.
+        bool (*testTile)(const float* depth, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY,
+            float nearestDepth) = nullptr;
+        const char* name = nullptr;
+    };
+
+    OcclusionKernels scalarOcclusionKernels();
+    // Empty when the target has no SSE2 or the build no AVX2 kernel.
+    OcclusionKernels sseOcclusionKernels();
+    OcclusionKernels avx2OcclusionKernels();
+
+    // Kernels written once against a lane type. Simd provides Float, Mask,
+    // WIDTH (dividing OCCLUSION_TILE_WIDTH) and the handful of operations below.
+    template<typename Simd>
+    float rasterizeOcclusionTile(const OcclusionTriangle* triangles, const uint32_t* indices, size_t count,
+        int32_t tileX, int32_t tileY, float* depth) {
+        using Float = typename Simd::Float;
+        using Mask = typename Simd::Mask;
+        constexpr int32_t width = Simd::WIDTH;
+
+        const int32_t originX = tileX * OCCLUSION_TILE_WIDTH;
+        const int32_t originY = tileY * OCCLUSION_TILE_HEIGHT;
+        const Float zero = Simd::set1(0.0f);
+
+        for (size_t i = 0; i < count; i++) {
+            const OcclusionTriangle& triangle = triangles[indices[i]];
+            int32_t firstRow = triangle.minY > originY ? triangle.minY - originY : 0;
+            int32_t lastRow = triangle.maxY - originY < OCCLUSION_TILE_HEIGHT - 1 ? triangle.maxY - originY : OCCLUSION_TILE_HEIGHT - 1;
+
+            const Float edgeA0 = Simd::set1(triangle.edgeA[0]);
+            const Float edgeB0 = Simd::set1(triangle.edgeB[0]);
+            const Float edgeC0 = Simd::set1(triangle.edgeC[0]);
+            const Float depthA = Simd::set1(triangle.depthA);
+
+            for (int32_t column = 0; column < OCCLUSION_TILE_WIDTH; column += width) {
+                int32_t x = originX + column;
+                if (x + width - 1 < triangle.minX || x > triangle.maxX) {
+                    continue;
+                }
+                Float px = Simd::add(Simd::set1(static_cast<float>(x) + 0.5f), Simd::ramp());
+                // Row-invariant halves of the edge and depth equations.
+                Float edgeX0 = Simd::mul(edgeA0, px);
+                Float edgeX1 = Simd::mul(edgeB0, px);
+                Float edgeX2 = Simd::mul(edgeC0, px);
+                Float depthX = Simd::mul(depthA, px);
+
+                for (int32_t row = firstRow; row <= lastRow; row++) {
+                    float py = static_cast<float>(originY + row) + 0.5f;
+                    Float e0 = Simd::add(edgeX0, Simd::set1(triangle.edgeA[1] * py + triangle.edgeA[2]));
+                    Float e1 = Simd::add(edgeX1, Simd::set1(triangle.edgeB[1] * py + triangle.edgeB[2]));
+                    Float e2 = Simd::add(edgeX2, Simd::set1(triangle.edgeC[1] * py + triangle.edgeC[2]));
+                    Mask inside = Simd::bitAnd(Simd::greaterEqual(e0, zero),
+                        Simd::bitAnd(Simd::greaterEqual(e1, zero), Simd::greaterEqual(e2, zero)));
+                    if (!Simd::any(inside)) {
+                        continue;
+                    }
+
+                    Float z = Simd::add(depthX, Simd::set1(triangle.depthB * py + triangle.depthC));
+                    float* pixels = depth + row * OCCLUSION_TILE_WIDTH + column;
+                    Float current = Simd::load(pixels);
+                    Simd::store(pixels, Simd::select(inside, Simd::min(current, z), current));
+                }
+            }
+        }
+
+        Float farthest = Simd::load(depth);
+        for (int32_t offset = width; offset < OCCLUSION_TILE_PIXELS; offset += width) {
+            farthest = Simd::max(farthest, Simd::load(depth + offset));
+        }
+        return Simd::horizontalMax(farthest);
+    }
+
+    template<typename Simd>
+    bool testOcclusionTile(const float* depth, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float nearestDepth) {
+        using Float = typename Simd::Float;
+        using Mask = typename Simd::Mask;
+        constexpr int32_t width = Simd::WIDTH;
+
+        const Float nearest = Simd::set1(nearestDepth);
+        const Float first = Simd::set1(static_cast<float>(minX));
+        const Float last = Simd::set1(static_cast<float>(maxX));
+
+        for (int32_t column = 0; column < OCCLUSION_TILE_WIDTH; column += width) {
+            if (column + width - 1 < minX || column > maxX) {
+                continue;
+            }
+            Float x = Simd::add(Simd::set1(static_cast<float>(column)), Simd::ramp());
+            Mask inRange = Simd::bitAnd(Simd::greaterEqual(x, first), Simd::greaterEqual(last, x));
+            for (int32_t row = minY; row <= maxY; row++) {
+                Mask behind = Simd::greaterEqual(Simd::load(depth + row * OCCLUSION_TILE_WIDTH + column), nearest);
+                if (Simd::any(Simd::bitAnd(inRange, behind))) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Nashi {
+    // Frames RenderStatsHistory averages over.
+    constexpr uint32_t RENDER_STATS_WINDOW = 60;
+
+    // Workload of one frame. The CPU side is counted while the frame is
+    // recorded; indirect draws count as one draw each and leave instances
+    // and triangles to the GPU side. The GPU side comes from pipeline
+    // statistics queries, read back without waiting once the frame's slot
+    // comes around again, so it belongs to a frame frameQueueDepth frames
+    // older. It stays zero, with gpuCountersValid unset, where the device
+    // cannot count or the results were not ready yet.
+    struct RenderStats {
+        uint64_t draws = 0;
+        uint64_t instances = 0;
+        uint64_t triangles = 0;
+        uint64_t dispatches = 0;
+        uint64_t pipelineBinds = 0;
+        uint64_t descriptorBinds = 0;
+        uint64_t descriptorUpdates = 0;
+        // Bytes the CPU wrote for the GPU: mapped writes and staging copies.
+        uint64_t bytesUploaded = 0;
+        // Device memory allocations.
+        uint64_t allocations = 0;
+        // CPU time of draw().
+        uint64_t frameTimeNs = 0;
+
+        uint64_t vertexInvocations = 0;
+        uint64_t fragmentInvocations = 0;
+        uint64_t computeInvocations = 0;
+        bool gpuCountersValid = false;
+
+        // Triangle lists, which is all the pipelines here draw.
+        void addDraw(uint64_t vertexCount, uint64_t instanceCount) {
+            draws++;
+            instances += instanceCount;
+            triangles += vertexCount / 3 * instanceCount;
+        }
+    };
+
+    // One line, e.g. for a once-a-second log.
+    std::string formatRenderStats(const RenderStats& stats);
+
+    // The last RENDER_STATS_WINDOW frames, for rolling averages.
+    class RenderStatsHistory {
+    public:
+        void push(const RenderStats& stats);
+
+        // Default stats until the first push().
+        const RenderStats& latest() const { return m_frames[(m_next + RENDER_STATS_WINDOW - 1) % RENDER_STATS_WINDOW]; }
+        // Per-frame mean over the window, rounded. The GPU counters only
+        // average the frames that have them.
+        RenderStats average() const;
+        uint32_t frameCount() const { return m_count; }
+
+    private:
+        RenderStats m_frames[RENDER_STATS_WINDOW];
+        uint32_t m_next = 0;
+        uint32_t m_count = 0;
+    };
+}
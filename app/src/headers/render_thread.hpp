@@ -0,0 +1,83 @@
+#pragma once
+
+#include <spsc_queue.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <thread>
+
+namespace Nashi {
+    // Upper bound of the packets a RenderThread lets the app thread queue.
+    constexpr uint32_t MAX_RENDER_QUEUE_DEPTH = 4;
+    // Packets alive at once: the ones queued, the one the render thread is
+    // working on and the one the app thread is building. Anything a packet
+    // points to can be reused by the packet this many frames later.
+    constexpr uint32_t MAX_RENDER_PACKETS_IN_FLIGHT = MAX_RENDER_QUEUE_DEPTH + 2;
+
+    struct AppSceneFrame;
+
+    // What the app thread's event loop decided for one frame. Built and
+    // pushed by the app thread, then only read by the render thread, which
+    // applies it to the renderer right before draw(). Toggles are flips
+    // rather than states, so a renderer that rejects a change (e.g. a
+    // shader variant that fails to link) is not asked again every frame.
+    struct FramePacket {
+        uint64_t frame = 0;
+        bool windowResized = false;
+        // Nothing to present to: the render thread applies the packet but
+        // skips draw(), and goes back to waiting on the queue.
+        bool windowMinimized = false;
+        // Oldest input event since the previous packet, on the
+        // SDL_GetTicksNS clock, for markInput(); 0 without input.
+        uint64_t inputTimestampNs = 0;
+        // BasicShaderFeatures bits to flip.
+        uint32_t shaderVariantToggles = 0;
+        // Vulkan and software only.
+        bool toggleOcclusionCulling = false;
+        // Vulkan only.
+        bool toggleDepthPrepass = false;
+        // The floor, built on the app thread; the render thread submits it
+        // as is. Null when there is nothing to draw.
+        const AppSceneFrame* scene = nullptr;
+        // Last packet: the render thread cleans up and exits instead of
+        // drawing.
+        bool quit = false;
+    };
+
+    // Runs a renderer on its own thread, fed FramePackets through an
+    // SpscQueue, so the app thread can work on the next frame while the
+    // current one records and submits. The queue depth bounds how many
+    // frames the app thread runs ahead, which is the latency it adds;
+    // push() blocks once that many packets are waiting.
+    //
+    // init, frame and cleanup all run on the render thread, so a backend
+    // that binds state to its thread (a GL context) keeps it there. SDL
+    // events and window calls stay on the app thread, which is where SDL
+    // wants them: that includes creating and destroying the GL context,
+    // which the render thread only makes current. start() returns once init
+    // has run, so the app thread can build packets from what init created.
+    class RenderThread {
+    public:
+        RenderThread(uint32_t queueDepth, std::function<void()> init,
+            std::function<void(const FramePacket&)> frame, std::function<void()> cleanup);
+        ~RenderThread();
+
+        RenderThread(const RenderThread&) = delete;
+        RenderThread& operator=(const RenderThread&) = delete;
+
+        void start();
+        void push(const FramePacket& packet);
+        // Sends a quit packet and waits for cleanup to finish.
+        void stop();
+
+    private:
+        SpscQueue<FramePacket> m_packets;
+        std::function<void()> m_init;
+        std::function<void(const FramePacket&)> m_frame;
+        std::function<void()> m_cleanup;
+        std::thread m_thread;
+
+        void run(std::promise<void>& initialized);
+    };
+}
@@ -1,3 +1,4 @@
+#pragma once
 #ifndef NASHI_VR
 #   include <SDL3/SDL.h>
 #   ifdef NASHI_USE_VULKAN
@@ -16,6 +17,11 @@
 #include <iostream>
 #include <filesystem>
 
+#include <command_stream.hpp>
+#include <frame_pacing.hpp>
+#include <shader_library.hpp>
+#include <shader_reflection.hpp>
+
 static std::vector<char> readFile(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -61,6 +67,65 @@ static std::vector<char> readFileText(const std::string& filename) {
 }
 
 namespace Nashi {
+    // Returns the stage straight from the mapped shader library, or reads the
+    // loose artifact from shaders/ into storage when the library lacks it.
+    // Hot reload rewrites the loose files, so they win in that mode.
+    static ShaderBlob loadShaderBlob(const ShaderLibrary& library, const std::string& name, std::vector<char>& storage) {
+#ifndef NASHI_SHADER_HOT_RELOAD
+        if (ShaderBlob blob = library.find(name)) {
+            return blob;
+        }
+#endif
+        std::filesystem::path path = std::filesystem::current_path() / "shaders" / name;
+        storage = readFile(path.string());
+        return { storage.data(), storage.size() };
+    }
+
+    // Feature bits of basic.frag, in the order of its "// nashi:features" line.
+    // Only keys listed in shaders/variants.txt are compiled.
+    enum BasicShaderFeatures : uint32_t {
+        BASIC_FEATURE_DESATURATE = 1 << 0,
+    };
+
+    // Artifact name of a compiled permutation: key 0 is the plain stage
+    // ("basic.frag.spv"), other keys add ".k<key>" ("basic.frag.k1.spv").
+    static std::string shaderVariantName(const std::string& stage, uint32_t variantKey, const std::string& extension) {
+        if (variantKey == 0) {
+            return stage + extension;
+        }
+        return stage + ".k" + std::to_string(variantKey) + extension;
+    }
+
+    // Reflection sidecars only live in the shader library; stage is e.g. "basic.vert".
+    static ShaderReflection loadShaderReflection(const ShaderLibrary& library, const std::string& stage) {
+        ShaderReflection reflection;
+        ShaderBlob blob = library.find(stage + ".refl");
+        if (!blob || !ShaderReflection::deserialize(blob.data, blob.size, reflection)) {
+            throw std::runtime_error("missing shader reflection for " + stage);
+        }
+        return reflection;
+    }
+
+    enum BufferUsage : uint32_t {
+        BUFFER_USAGE_VERTEX = 1 << 0,
+        BUFFER_USAGE_INDEX = 1 << 1,
+        BUFFER_USAGE_UNIFORM = 1 << 2,
+        BUFFER_USAGE_STORAGE = 1 << 3,
+        BUFFER_USAGE_INDIRECT = 1 << 4,
+        BUFFER_USAGE_COPY_SRC = 1 << 5,
+        BUFFER_USAGE_COPY_DST = 1 << 6,
+    };
+
+    struct BufferDesc {
+        uint64_t size = 0;
+        // BufferUsage bits.
+        uint32_t usage = 0;
+        // Persistently mapped and CPU-writable, see getMappedData(); otherwise device local.
+        bool hostVisible = false;
+        // Optional; size bytes uploaded at creation.
+        const void* initialData = nullptr;
+    };
+
 #if !defined(NASHI_USE_DIRECT3D12) && !defined(NASHI_USE_METAL)
     struct UniformBufferObject {
         alignas(16) glm::mat4 model;
@@ -78,6 +143,32 @@ namespace Nashi {
 		virtual void init() = 0;
 		virtual void draw() = 0;
 		virtual void cleanup() = 0;
+
+		// Takes effect from the next frame; call before init() to pick the
+		// initial swapchain configuration.
+		virtual void setFramePacing(const FramePacingPolicy& policy) = 0;
+		// timestampNs is SDL_Event::common.timestamp of a user input event.
+		virtual void markInput(uint64_t timestampNs) = 0;
+
+		// Application resources. destroyBuffer may be called while frames
+		// using the buffer are in flight.
+		virtual BufferHandle createBuffer(const BufferDesc& desc) = 0;
+		virtual void destroyBuffer(BufferHandle buffer) = 0;
+		// nullptr unless the buffer was created hostVisible.
+		virtual void* getMappedData(BufferHandle buffer) = 0;
+
+		// basic.vert/basic.frag for a BasicShaderFeatures key, bound together
+		// with the renderer's camera uniforms.
+		virtual PipelineHandle basicPipeline(uint32_t variantKey) = 0;
+
+		// Transient CPU memory for the frame being built, e.g. command
+		// streams. Freed wholesale once frames in flight have moved past it.
+		virtual LinearArena& frameArena() = 0;
+
+		// Runs the stream in the next draw(), after the built-in scene and in
+		// submission order. The arena behind it must stay untouched until that
+		// draw() returns.
+		virtual void submit(const CommandStream& stream) = 0;
 	};
 
 }
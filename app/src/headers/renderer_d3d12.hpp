@@ -23,8 +23,11 @@
 #include <numbers> 
 #include <ranges>
 #include <cmath>
+#include <string>
+#include <unordered_map>
 
 
+#include <handle_pool.hpp>
 #include <renderer.hpp>
 
 #define SDL_WINDOW_NAME "DirectX12 Window (nashi)"
@@ -72,6 +75,26 @@ struct UniformBufferObject {
 };
 
 namespace Nashi {
+	struct DirectXBuffer {
+		ComPtr<ID3D12Resource> resource;
+		UINT64 size = 0;
+		D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT;
+		// Persistently mapped for upload heaps, nullptr otherwise.
+		void* mapped = nullptr;
+	};
+
+	struct DirectXPipeline {
+		ComPtr<ID3D12PipelineState> pipelineState;
+		ComPtr<ID3D12RootSignature> rootSignature;
+		UINT vertexStride = 0;
+		// Root parameter of the reflected push constants, UINT_MAX when there are none.
+		UINT constantsRootIndex = UINT_MAX;
+		// 32-bit values at constantsRootIndex.
+		UINT constantsCount = 0;
+		// Whether root parameter 0 takes the per-frame camera constants.
+		bool bindsFrameConstants = false;
+	};
+
 	class Direct3D12Renderer : IRenderer {
 		SDL_Window* m_window;
 		int m_windowWidth;
@@ -81,11 +104,13 @@ namespace Nashi {
 		HWND m_hwnd;
 		RECT m_windowRect;
 
-		bool m_dxVsync = true;
 		BOOL m_dxTearingSupported = false;
 		bool m_dxFullscreen;
 
-		static const uint8_t m_dxNumFrames = 2;
+		static const uint8_t m_dxNumFrames = MAX_FRAME_QUEUE_DEPTH;
+		FramePacer m_framePacer;
+		FrameArenas m_frameArenas{ m_dxNumFrames, FRAME_ARENA_SIZE };
+		HANDLE m_dxFrameLatencyWaitable = nullptr;
 		bool m_dxUseWarp = false;
 
 		bool m_dxIsInitialized = false;
@@ -109,18 +134,30 @@ namespace Nashi {
 		uint64_t m_dxFrameFenceValues[m_dxNumFrames] = {};
 		HANDLE m_dxFenceEvent;
 
+		// Objects the GPU may still reference, released once the fence passes
+		// the last value signalled before they were queued.
+		std::queue<std::pair<uint64_t, ComPtr<IUnknown>>> m_dxDeferredReleases;
+
 		ComPtr<ID3D12DescriptorHeap> m_dxDepthStencilBufferHeap;
 		ComPtr<ID3D12Resource> m_dxDepthStencilBuffer;
 
-		ComPtr<ID3D12Resource> m_dxVertexBuffer;
+		// Backend objects behind the handles stored everywhere else.
+		HandlePool<DirectXBuffer, BufferTag> m_dxBuffers;
+		HandlePool<DirectXPipeline, PipelineTag> m_dxPipelines;
+
+		std::vector<CommandStream> m_dxSubmittedStreams;
+
+		BufferHandle m_dxVertexBuffer;
 		D3D12_VERTEX_BUFFER_VIEW m_dxVertexBufferView;
 
-		ComPtr<ID3D12Resource> m_dxIndexBuffer;
+		BufferHandle m_dxIndexBuffer;
 		D3D12_INDEX_BUFFER_VIEW m_dxIndexBufferView;
 
-		ComPtr<ID3D12Resource> m_dxConstantBuffer;
+		BufferHandle m_dxConstantBuffer;
 		ComPtr<ID3D12DescriptorHeap> m_dxConstantBufferHeap; 
-		UniformBufferObject* m_dxUbo;
+		uint8_t* m_dxConstantBufferMapped;
+		UINT m_dxConstantBufferStride;
+		UINT m_dxCBVDescriptorSize;
 
 		const std::vector<Vertex> m_vertices = {
 			// Front face
@@ -153,8 +190,13 @@ namespace Nashi {
 
 		ComPtr<ID3D12RootSignature> m_dxRootSignature;
 		ComPtr<ID3D12PipelineState> m_dxPipelineState;
+		std::unordered_map<uint32_t, PipelineHandle> m_dxPipelineStates;
 		PipelineStateStream m_dxPipelineStateStream;
 
+		ShaderLibrary m_shaderLibrary;
+		ShaderReflection m_basicReflection;
+		std::unordered_map<std::vector<uint32_t>, ComPtr<ID3D12RootSignature>, LayoutKeyHash> m_dxRootSignatureCache;
+
 		CD3DX12_RECT m_dxScissorRect;
 		CD3DX12_VIEWPORT m_dxViewport;
 
@@ -180,8 +222,15 @@ namespace Nashi {
 		void createSyncObjects();
 		void createEventHandle();
 		uint64_t signalFence();
-		void waitForFenceValue(std::chrono::milliseconds duration = std::chrono::milliseconds::max());
+		void waitForFenceValue(uint64_t fenceValue, std::chrono::milliseconds duration = std::chrono::milliseconds::max());
 		void flush();
+		void deferRelease(ComPtr<IUnknown> object);
+		void processDeferredReleases();
+
+		// Committed buffer resources; destroyBuffer releases through the deferred queue.
+		BufferHandle createBuffer(D3D12_HEAP_TYPE heapType, UINT64 size, D3D12_RESOURCE_STATES initialState,
+			D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+		ID3D12Resource* getBuffer(BufferHandle handle) const;
 
 		void createDepthStencilBuffer();
 		void createVertexBuffer();
@@ -190,17 +239,33 @@ namespace Nashi {
 		void createConstantBuffer();
 		void updateUniformBufferObject();
 
+		ComPtr<ID3D12RootSignature> getRootSignature(const ShaderReflection& reflection);
 		void createRootSignature();
-		void createGraphicsPipeline();
+		ComPtr<ID3D12PipelineState> createGraphicsPipeline(uint32_t variantKey);
+		ComPtr<ID3D12PipelineState> getPipelineState(uint32_t variantKey);
+
+		void zeroRootConstants(ID3D12GraphicsCommandList* commandList, const DirectXPipeline& pipeline);
+		void executeCommandStreams(ID3D12GraphicsCommandList* commandList);
 
 		void createViewport();
 	public:
 		bool m_windowResized = false;
+		uint32_t m_shaderVariant = 0;
 		Direct3D12Renderer(SDL_Window* window, SDL_Event event, HWND hwnd);
 
 		void init();
 		void draw();
 		void cleanup();
+
+		void setFramePacing(const FramePacingPolicy& policy);
+		void markInput(uint64_t timestampNs);
+
+		BufferHandle createBuffer(const BufferDesc& desc);
+		void destroyBuffer(BufferHandle handle);
+		void* getMappedData(BufferHandle buffer);
+		PipelineHandle basicPipeline(uint32_t variantKey);
+		void submit(const CommandStream& stream);
+		LinearArena& frameArena();
 	};
 }
 #endif
\ No newline at end of file
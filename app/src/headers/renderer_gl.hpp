@@ -1,17 +1,142 @@
 #ifdef NASHI_USE_OPENGL
 #include <glad/glad.h>
+#include <gl_state_cache.hpp>
 #include <renderer.hpp>
+#include <render_stats.hpp>
+#include <shader_watcher.hpp>
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>;
 
 #define SDL_WINDOW_NAME "OpenGL Window (nashi)"
+#define SHADER_ENTRY_POINT "main"
+
+// KHR_parallel_shader_compile, which the generated loader does not include.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
 
 namespace Nashi {
+	// Shader storage binding of the per-draw CmdSetConstants blocks, which
+	// basic.vert indexes with gl_DrawID.
+	constexpr unsigned int GL_CONSTANTS_BINDING = 1;
+	// Vertex buffer binding that every VAO's attributes read from.
+	constexpr unsigned int GL_VERTEX_BUFFER_BINDING = 0;
+	// Streaming memory per frame slot: camera uniforms, command stream
+	// constants and allocateTransient() all come out of it.
+	constexpr GLsizeiptr GL_STREAM_REGION_SIZE = 1024 * 1024;
+
+	// Basic program permutations that init() starts compiling up front, so
+	// the first basicPipeline() or F2 toggle does not wait on the driver.
+	// Keys must be listed in shaders/variants.txt.
+	constexpr uint32_t GL_PREWARM_VARIANTS[] = { 0, BASIC_FEATURE_DESATURATE };
+
+	// Pipeline statistics each frame slot queries, in RenderStats order.
+	constexpr GLenum GL_STATISTICS_TARGETS[] = {
+		GL_VERTEX_SHADER_INVOCATIONS, GL_FRAGMENT_SHADER_INVOCATIONS, GL_COMPUTE_SHADER_INVOCATIONS };
+	constexpr size_t GL_STATISTICS_TARGET_COUNT = sizeof(GL_STATISTICS_TARGETS) / sizeof(GL_STATISTICS_TARGETS[0]);
+
+	// File layout of a cached program: this header, then the driver's binary.
+	constexpr uint32_t GL_PROGRAM_BINARY_MAGIC = 0x4250474E; // "NGPB"
+	struct GLProgramBinaryHeader {
+		uint32_t magic;
+		uint32_t format;
+		uint64_t cacheKey;
+	};
+
+	// constant_id -> value pairs, the GL side of the Vulkan backend's
+	// SpecializationConstants. SPIR-V stages take them through
+	// glSpecializeShader; GLSL stages get the SPIRV_CROSS_CONSTANT_ID_<id>
+	// defines spirv-cross emits for each constant.
+	struct GLSpecializationConstants {
+		std::vector<GLuint> ids;
+		std::vector<GLuint> values;
+		std::string defines;
+
+		template<typename T>
+		void set(uint32_t constantId, const T& value) {
+			static_assert(sizeof(T) == 4, "GL specialization constants are 32 bit, use uint32_t for bools");
+			GLuint bits;
+			memcpy(&bits, &value, sizeof(bits));
+			ids.push_back(constantId);
+			values.push_back(bits);
+
+			std::string literal;
+			if constexpr (std::is_floating_point_v<T>) {
+				char text[32];
+				snprintf(text, sizeof(text), "%.9g", static_cast<double>(value));
+				literal = text;
+				if (literal.find_first_of(".en") == std::string::npos) {
+					literal += ".0";
+				}
+			}
+			else if constexpr (std::is_signed_v<T>) {
+				literal = std::to_string(value);
+			}
+			else {
+				literal = std::to_string(value) + "u";
+			}
+			defines += "#define SPIRV_CROSS_CONSTANT_ID_" + std::to_string(constantId) + " " + literal + "\n";
+		}
+	};
+
+	// A program between glLinkProgram and its first status query. The
+	// shaders are zero when the program came from the binary cache.
+	struct GLProgramBuild {
+		unsigned int program = 0;
+		unsigned int vertexShader = 0;
+		unsigned int fragmentShader = 0;
+		uint64_t cacheKey = 0;
+		uint32_t variantKey = 0;
+		bool spirv = false;
+	};
+
+	struct OpenGLBuffer {
+		unsigned int buffer = 0;
+		GLsizeiptr size = 0;
+		// Persistent, coherent mapping for host-visible buffers.
+		void* mapped = nullptr;
+	};
+
+	// Layouts glMultiDrawElementsIndirect and glMultiDrawArraysIndirect read.
+	struct GLDrawElementsIndirectCommand {
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t baseInstance;
+	};
+
+	struct GLDrawArraysIndirectCommand {
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t first;
+		uint32_t baseInstance;
+	};
+
+	// Slice of the stream buffer, valid for the frame it was allocated in.
+	// Bind it like any other buffer, e.g. bindVertexBuffer(buffer, offset).
+	struct GLTransientAllocation {
+		BufferHandle buffer;
+		uint32_t offset = 0;
+		void* data = nullptr;
+	};
+
 	class OpenGLRenderer : IRenderer {
-		SDL_GLContext m_glContext;
+		SDL_GLContext m_glContext = nullptr;
+		// Made by createContext(), so cleanup() only releases it.
+		bool m_glContextExternal = false;
 		SDL_Window* m_window;
 		SDL_Event m_event;
 
@@ -44,39 +169,149 @@ namespace Nashi {
 			4, 5, 1, 1, 0, 4
 		};
 
-		unsigned int m_glVBO;
-		unsigned int m_glVAO;
-		unsigned int m_glEBO;
+		// Scene vertices followed by its indices, at m_glSceneIndexOffset.
+		unsigned int m_glSceneBuffer = 0;
+		GLintptr m_glSceneIndexOffset = 0;
+		unsigned int m_glVAO = 0;
+		GLsizei m_glVertexStride = 0;
 		
-		unsigned int m_glUBO;
 		unsigned int m_glUBOBindingPoint = 0;
 
-		unsigned int m_glVertexShader;
-		unsigned int m_glFragmentShader;
-		unsigned int m_glShaderProgram;
+		// One persistently mapped, coherent buffer with a region per frame
+		// slot. A frame only writes the region of its own slot, which the
+		// slot's fence has released, so writes never wait on the driver.
+		BufferHandle m_glStreamBuffer;
+		GLintptr m_glStreamOffset = 0;
+		GLint m_glUniformAlignment = 256;
+		GLint m_glStorageAlignment = 256;
+		bool m_glFrameSlotOpen = false;
+		uint8_t m_glConstants[MAX_COMMAND_CONSTANTS_SIZE] = {};
+		// Bytes of m_glConstants each draw keeps: the end of the basic
+		// shaders' constants block, which is also the array stride at
+		// GL_CONSTANTS_BINDING. 0 when they read none.
+		GLsizeiptr m_glDrawConstantsSize = 0;
+
+		unsigned int m_glShaderProgram = 0;
+		uint32_t m_glShaderProgramVariant = 0;
+
+		ShaderLibrary m_shaderLibrary;
+		ShaderReflection m_basicReflection;
+
+		// Every bind and fixed-function change goes through m_glState.
+		GLStateCache m_glState;
+		GLStateCacheStats m_glStateStats;
+
+		HandlePool<OpenGLBuffer, BufferTag> m_glBuffers;
+		HandlePool<unsigned int, PipelineTag> m_glPrograms;
+		std::unordered_map<uint32_t, PipelineHandle> m_glBasicPrograms;
+		// Prewarmed basic programs still compiling, by variant key.
+		std::unordered_map<uint32_t, GLProgramBuild> m_glProgramBuilds;
+
+		// Program binaries are keyed by both sources and m_glDriverHash, the
+		// GL_RENDERER and GL_VERSION strings, so a driver update misses.
+		std::filesystem::path m_glProgramCacheDirectory;
+		uint64_t m_glDriverHash = 0;
+		bool m_glProgramCacheEnabled = false;
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC m_glMaxShaderCompilerThreads = nullptr;
+		// Load the .spv artifacts directly instead of the spirv-cross GLSL.
+		// Cleared for good the first time a SPIR-V program fails to link.
+		bool m_glSpirvEnabled = false;
+		float m_colorIntensity = 1.0f;
+
+		// Command streams get their own VAO so they never disturb the scene's.
+		unsigned int m_glStreamVAO = 0;
+		std::vector<CommandStream> m_glSubmittedStreams;
+		// Draws recorded since the last pipeline or buffer change, with a copy
+		// of the constants each one saw. Only one of the two lists is non-empty.
+		std::vector<GLDrawElementsIndirectCommand> m_glPendingIndexedDraws;
+		std::vector<GLDrawArraysIndirectCommand> m_glPendingDraws;
+		std::vector<uint8_t> m_glPendingConstants;
+
+		FramePacer m_framePacer;
+		FrameArenas m_frameArenas{ MAX_FRAME_QUEUE_DEPTH, FRAME_ARENA_SIZE };
+		GLsync m_glFrameFences[MAX_FRAME_QUEUE_DEPTH] = {};
+		uint32_t m_glFrameIndex = 0;
+
+		// Counted into m_glFrameStats from the end of one draw() to the end
+		// of the next. GL has no descriptor sets, so buffer range binds count
+		// as descriptor binds. A slot's statistics queries run from
+		// beginFrameSlot() to its fence and are read once the fence passes.
+		RenderStats m_glFrameStats;
+		RenderStatsHistory m_renderStats;
+		bool m_glPipelineStatisticsSupported = false;
+		GLuint m_glStatisticsQueries[GL_STATISTICS_TARGET_COUNT][MAX_FRAME_QUEUE_DEPTH] = {};
+		bool m_glStatisticsPending[MAX_FRAME_QUEUE_DEPTH] = {};
+
+		void applySwapInterval();
+		void waitForFrameSlot();
+		void beginFrameSlot();
+		void collectPipelineStatistics();
+		GLTransientAllocation streamAllocate(GLsizeiptr size, GLint alignment);
 
 		void resizeWindow();
-		unsigned int createShader(GLenum shaderType, const std::string& filename);
-		void createShaderProgram();
+		unsigned int createShader(GLenum shaderType, const ShaderBlob& source, const GLSpecializationConstants& constants);
+		unsigned int createSpirvShader(GLenum shaderType, const ShaderBlob& binary, const GLSpecializationConstants& constants);
+		bool rebuildShaderProgram(uint32_t variantKey);
+		unsigned int linkBasicProgram(uint32_t variantKey);
 
-		void deleteShaders();
-		void createVertexInputState();
+		void initShaderCompiler();
+		bool loadProgramBinary(unsigned int program, uint64_t cacheKey);
+		void saveProgramBinary(unsigned int program, uint64_t cacheKey);
+		GLProgramBuild beginBasicProgram(uint32_t variantKey);
+		unsigned int finishProgram(const GLProgramBuild& build);
+		bool isProgramBuildDone(const GLProgramBuild& build);
+		void collectProgramBuilds(bool wait);
+		PipelineHandle addBasicPipeline(uint32_t variantKey, unsigned int program);
 
-		void createBuffers();
-		void createVertexBuffer();
-		void createIndexBuffer();
+		void setVertexFormat(unsigned int vao);
+		void createSceneGeometry();
 
-		void createUniformBuffer();
+		void createStreamBuffer();
 		void updateUniformBuffer();
 
-		void createVertexAttributes();
+		bool bindDrawConstants(const uint8_t* constants, size_t drawCount);
+		void flushDraws(GLenum indexType);
+		void executeCommandStreams();
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+		std::unique_ptr<ShaderWatcher> m_shaderWatcher;
+
+		void reloadShaders();
+#endif
 	public:
 		bool m_windowResized = false;
+		uint32_t m_shaderVariant = 0;
 		OpenGLRenderer(SDL_Window* window, SDL_Event event);
 
 		void init();
 		void draw();
 		void cleanup();
+
+		// SDL only creates and destroys GL contexts on the main thread. When
+		// init() runs on another one, call createContext() on the main thread
+		// first: init() then only makes the context current. destroyContext()
+		// goes after cleanup(), again on the main thread.
+		void createContext();
+		void destroyContext();
+
+		void setFramePacing(const FramePacingPolicy& policy);
+		void markInput(uint64_t timestampNs);
+
+		BufferHandle createBuffer(const BufferDesc& desc);
+		void destroyBuffer(BufferHandle handle);
+		void* getMappedData(BufferHandle buffer);
+		PipelineHandle basicPipeline(uint32_t variantKey);
+		void submit(const CommandStream& stream);
+		LinearArena& frameArena();
+
+		// Dynamic vertices, indices or indirect arguments for the frame being
+		// built. Returns an empty allocation once the slot's region is full.
+		GLTransientAllocation allocateTransient(uint32_t size, uint32_t alignment = 16);
+
+		// State changes the last frame issued and dropped as redundant.
+		const GLStateCacheStats& stateCacheStats() const { return m_glStateStats; }
+		// Per-frame counters of the last RENDER_STATS_WINDOW frames.
+		const RenderStatsHistory& renderStats() const { return m_renderStats; }
 	};
 
 }
@@ -0,0 +1,176 @@
+#ifdef NASHI_USE_SOFTWARE
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <handle_pool.hpp>
+#include <renderer.hpp>
+#include <software_occlusion.hpp>
+#include <tile_jobs.hpp>
+
+#define SDL_WINDOW_NAME "Software Window (nashi)"
+
+namespace Nashi {
+    // Screen tiles are cleared, rasterized and shaded by one thread each.
+    constexpr uint32_t SOFTWARE_TILE_SIZE = 64;
+    // Occlusion depth buffer size, whatever the frame's; the aspect ratio
+    // only stretches its pixels.
+    constexpr uint32_t SOFTWARE_OCCLUSION_WIDTH = 256;
+    constexpr uint32_t SOFTWARE_OCCLUSION_HEIGHT = 144;
+
+    // Same layout as the Vulkan backend's Vertex and basic.vert's input.
+    struct SoftwareVertex {
+        glm::vec3 pos;
+        glm::vec3 color;
+    };
+
+    struct SoftwareBuffer {
+        std::vector<uint8_t> data;
+        bool hostVisible = false;
+    };
+
+    // Triangle after clipping and setup. Every plane is a * x + b * y + c
+    // evaluated at pixel centers: edges[i] is the barycentric weight of
+    // vertex i, depth is z / w, and invW and color (per channel, divided by
+    // w) give perspective-correct colors. The box is inclusive, in pixels.
+    struct SoftwareTriangle {
+        float edges[3][3];
+        bool topLeft[3];
+        float depth[3];
+        float invW[3];
+        float color[3][3];
+        int32_t minX, minY, maxX, maxY;
+        // BasicShaderFeatures of the pipeline that drew it.
+        uint32_t features;
+    };
+
+    // CPU implementation of IRenderer for machines without a GPU or graphics
+    // driver. Draws are transformed, clipped and binned into
+    // SOFTWARE_TILE_SIZE tiles on the calling thread; tiles are then
+    // rasterized in parallel. Follows the Vulkan backend's conventions: the
+    // same vertex, index and camera data, counter-clockwise front faces with
+    // back faces culled, [0, 1] depth with a less-than test. Without a window
+    // the frame stays offscreen, see pixels() and saveFrame().
+    class SoftwareRenderer : IRenderer {
+        struct ClipVertex {
+            glm::vec4 position;
+            glm::vec3 color;
+        };
+
+        SDL_Window* m_window;
+        SDL_Event m_event;
+        SDL_Surface* m_frameSurface = nullptr;
+
+        uint32_t m_width;
+        uint32_t m_height;
+        // Row length of the color and depth buffers in pixels, padded so a
+        // SIMD group never reads past the end of a row.
+        uint32_t m_pitch = 0;
+        uint32_t m_tilesX = 0;
+        uint32_t m_tilesY = 0;
+        std::vector<uint32_t> m_colorBuffer;
+        std::vector<float> m_depthBuffer;
+
+        const std::vector<SoftwareVertex> m_vertices = {
+            {{-0.5f, -0.5f,  0.5f}, {1.0f, 0.0f, 0.0f}},
+            {{ 0.5f, -0.5f,  0.5f}, {0.0f, 1.0f, 0.0f}},
+            {{ 0.5f,  0.5f,  0.5f}, {0.0f, 0.0f, 1.0f}},
+            {{-0.5f,  0.5f,  0.5f}, {1.0f, 1.0f, 1.0f}},
+            {{-0.5f, -0.5f, -0.5f}, {1.0f, 1.0f, 0.0f}},
+            {{ 0.5f, -0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}},
+            {{ 0.5f,  0.5f, -0.5f}, {1.0f, 0.0f, 1.0f}},
+            {{-0.5f,  0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}},
+        };
+
+        const std::vector<uint16_t> m_indices = {
+            0, 1, 2, 2, 3, 0,
+            1, 5, 6, 6, 2, 1,
+            5, 4, 7, 7, 6, 5,
+            4, 0, 3, 3, 7, 4,
+            3, 2, 6, 6, 7, 3,
+            4, 5, 1, 1, 0, 4
+        };
+
+        BufferHandle m_vertexBuffer;
+        BufferHandle m_indexBuffer;
+        UniformBufferObject m_ubo{};
+
+        HandlePool<SoftwareBuffer, BufferTag> m_buffers;
+        // Pipelines are basic.vert/basic.frag permutations, stored as their variant key.
+        HandlePool<uint32_t, PipelineTag> m_pipelines;
+        std::unordered_map<uint32_t, PipelineHandle> m_basicPipelines;
+        std::vector<CommandStream> m_submittedStreams;
+
+        FramePacer m_framePacer;
+        FrameArenas m_frameArenas{ MAX_FRAME_QUEUE_DEPTH, FRAME_ARENA_SIZE };
+
+        // Rebuilt every frame.
+        std::vector<ClipVertex> m_clipVertices;
+        std::vector<SoftwareTriangle> m_triangles;
+        std::vector<std::vector<uint32_t>> m_tileBins;
+
+        TileJobs m_tileJobs;
+
+        // The built-in cube, rasterized every frame on the calling thread;
+        // stream draws it hides are dropped before they are set up.
+        SoftwareOcclusionCuller m_occlusionCuller{ SOFTWARE_OCCLUSION_WIDTH, SOFTWARE_OCCLUSION_HEIGHT, 0 };
+        uint32_t m_occludedDraws = 0;
+
+        void resizeFramebuffer(uint32_t width, uint32_t height);
+        void updateUniformBuffer();
+
+        template<typename IndexFn>
+        void drawTriangles(const SoftwareBuffer& vertexBuffer, uint32_t vertexOffset, uint32_t vertexCount,
+            IndexFn index, const glm::vec3& offset, uint32_t features, bool occlusionTest);
+        void clipTriangle(const ClipVertex* vertices[3], uint32_t features);
+        void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t features);
+        void executeCommandStreams();
+
+        void rasterize();
+        void rasterizeTile(uint32_t tile);
+
+        void present();
+
+    public:
+        bool m_windowResized = false;
+        uint32_t m_shaderVariant = 0;
+        // Tests every stream draw's bounds against the built-in cube, see
+        // SoftwareOcclusionCuller.
+        bool m_occlusionCulling = true;
+        // window may be nullptr to render offscreen at width x height;
+        // otherwise the frame follows the window's size.
+        SoftwareRenderer(SDL_Window* window, SDL_Event event, uint32_t width = 1280, uint32_t height = 720);
+        ~SoftwareRenderer();
+
+        void init();
+        void draw();
+        void cleanup();
+
+        void setFramePacing(const FramePacingPolicy& policy);
+        void markInput(uint64_t timestampNs);
+
+        BufferHandle createBuffer(const BufferDesc& desc);
+        void destroyBuffer(BufferHandle handle);
+        void* getMappedData(BufferHandle buffer);
+        PipelineHandle basicPipeline(uint32_t variantKey);
+        void submit(const CommandStream& stream);
+        LinearArena& frameArena();
+
+        // Last finished frame, XRGB8888 with sRGB-encoded color.
+        const uint32_t* pixels() const { return m_colorBuffer.data(); }
+        uint32_t width() const { return m_width; }
+        uint32_t height() const { return m_height; }
+        uint32_t pitch() const { return m_pitch; }
+        // Stream draws the last frame dropped as hidden.
+        uint32_t occludedDraws() const { return m_occludedDraws; }
+        // Binary PPM.
+        bool saveFrame(const std::string& path) const;
+    };
+}
+#endif
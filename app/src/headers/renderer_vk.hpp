@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 
 #define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -17,8 +18,17 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <span>
+#include <unordered_map>
 
+#include <handle_pool.hpp>
 #include <renderer.hpp>
+#include <render_stats.hpp>
+#include <shader_watcher.hpp>
+#include <trace.hpp>
 
 #ifdef _WIN32
 #  define NOMINMAX
@@ -61,11 +71,47 @@ namespace Nashi {
 
 #define SHADER_ENTRY_POINT "main"
 
-    const int MAX_FRAMES_IN_FLIGHT = 2;
+    // Per-frame resources are allocated for the deepest allowed queue;
+    // m_framePacer's frameQueueDepth decides how many of them are cycled.
+    const int MAX_FRAMES_IN_FLIGHT = MAX_FRAME_QUEUE_DEPTH;
+
+    const float CAMERA_Z_NEAR = 0.1f;
+    const float CAMERA_Z_FAR = 10.0f;
+
+    // Matches hiz.comp. Larger pyramids keep their coarsest levels above 1x1;
+    // bounds too big for the last level are simply not occlusion tested.
+    const uint32_t HIZ_MAX_LEVELS = 12;
+
+    // GPU trace scopes a frame can record; the rest are dropped.
+    const uint32_t GPU_TRACE_MAX_SCOPES = 16;
+
+    // What a graphics pipeline does with depth. Single tests and writes it
+    // and shades, as every pipeline from basicPipeline() does. With the
+    // depth prepass the built-in scene is drawn twice: Prepass writes depth
+    // without a fragment shader or color writes, then Shade tests against it
+    // without writing, so basic.frag runs once per covered pixel. Both use
+    // the full vertex layout and stage. Shade tests LESS_OR_EQUAL (or
+    // GREATER_OR_EQUAL) rather than EQUAL so a depth that still differs in
+    // the last bit leaves no hole, and the vertex stages compute the clip
+    // position as precise.
+    enum class DepthPass : uint32_t {
+        Single,
+        Prepass,
+        Shade,
+    };
+
+    // Key of the basic and scene pipeline caches. Prepass pipelines have no
+    // fragment stage, so they share variant 0.
+    inline uint32_t depthPipelineKey(uint32_t variantKey, DepthPass pass) {
+        return (pass == DepthPass::Prepass ? 0 : variantKey) | static_cast<uint32_t>(pass) << 16;
+    }
 
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // Equal to graphicsFamily when the device has no compute-only family.
+        std::optional<uint32_t> computeFamily;
+        uint32_t computeQueueIndex = 0;
 
         bool isComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -81,8 +127,118 @@ namespace Nashi {
     struct Vertex {
         glm::vec3 pos;
         glm::vec3 color;
-        static VkVertexInputBindingDescription getBindingDescription();
-        static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+    };
+
+    // Matches SceneObject in scene.vert and cull.comp. The bounding sphere is
+    // in world space, before the UBO's model matrix.
+    struct SceneObject {
+        glm::mat4 transform;
+        glm::vec4 boundingSphere;
+    };
+
+    struct CullConstants {
+        uint32_t objectCount;
+        uint32_t phase;
+        uint32_t pyramidWidth;
+        uint32_t pyramidHeight;
+        uint32_t pyramidLevels;
+        uint32_t indexCount;
+        float znear;
+    };
+
+    struct HiZConstants {
+        uint32_t depthWidth;
+        uint32_t depthHeight;
+        uint32_t pyramidWidth;
+        uint32_t pyramidHeight;
+        uint32_t levelCount;
+        uint32_t groupCount;
+    };
+
+    // One timeline semaphore per queue. Every submission to the queue signals
+    // the next value, so "has work X finished?" is a counter comparison that
+    // any subsystem can make without owning a fence.
+    struct QueueTimeline {
+        VkQueue queue = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        uint64_t lastSubmitted = 0;
+        uint64_t lastCompleted = 0;
+    };
+
+    struct VulkanBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        // Persistently mapped when the memory is host visible.
+        void* mapped = nullptr;
+    };
+
+    struct VulkanImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent3D extent{};
+    };
+
+    struct VulkanPipeline {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        // Union of the reflected push constant ranges; 0 when there are none.
+        VkShaderStageFlags pushConstantStages = 0;
+        // End of the furthest range, for stream pipelines whose constants a
+        // BindPipeline zeroes. 0 for pipelines that set their own.
+        uint32_t pushConstantSize = 0;
+        // Bound at set 0 alongside the pipeline, per frame slot; may be empty.
+        const std::vector<VkDescriptorSet>* frameDescriptorSets = nullptr;
+    };
+
+    // A wait on either a binary semaphore (value ignored) or a timeline value.
+    struct SemaphoreWait {
+        VkSemaphore semaphore;
+        uint64_t value;
+        VkPipelineStageFlags stage;
+    };
+
+    // Work for the async compute queue. Buffers only the job touches need not
+    // be listed; buffers it shares with graphics must be, so the renderer can
+    // order the job after earlier graphics work and move queue-family
+    // ownership to compute and back.
+    struct ComputeJob {
+        std::function<void(VkCommandBuffer)> record;
+        std::vector<VkBuffer> buffers;
+        // First graphics stage and access that consume the results. The next
+        // frame waits on the job there. 0 keeps the buffers on the compute
+        // queue for a later job.
+        VkPipelineStageFlags graphicsStage = 0;
+        VkAccessFlags graphicsAccess = 0;
+        std::vector<SemaphoreWait> waits;
+    };
+
+    // constant_id -> value pairs for VkSpecializationInfo. Behaviour-only
+    // knobs go here so the driver folds them instead of branching at runtime.
+    // info() points into this object, keep it alive until the pipeline is built.
+    struct SpecializationConstants {
+        std::vector<VkSpecializationMapEntry> entries;
+        std::vector<uint8_t> data;
+
+        template<typename T>
+        void set(uint32_t constantId, const T& value) {
+            static_assert(sizeof(T) == 4 || sizeof(T) == 8, "specialization constants are 32 or 64 bit, use VkBool32 for bools");
+            entries.push_back({ constantId, static_cast<uint32_t>(data.size()), sizeof(T) });
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+            data.insert(data.end(), bytes, bytes + sizeof(T));
+        }
+
+        VkSpecializationInfo info() const {
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+            specializationInfo.pMapEntries = entries.data();
+            specializationInfo.dataSize = data.size();
+            specializationInfo.pData = data.data();
+            return specializationInfo;
+        }
     };
 
 
@@ -94,40 +250,135 @@ namespace Nashi {
         VkQueue m_vkGraphicsQueue;
         VkSurfaceKHR m_vkSurface;
         VkQueue m_vkPresentQueue;
+        VkQueue m_vkComputeQueue;
+        uint32_t m_vkGraphicsFamily;
+        uint32_t m_vkComputeFamily;
 
-        VkSwapchainKHR m_vkSwapChain;
+        VkSwapchainKHR m_vkSwapChain = VK_NULL_HANDLE;
         std::vector<VkImage> m_vkSwapChainImages;
         VkFormat m_vkSwapChainImageFormat;
         VkExtent2D m_vkSwapChainExtent;
         std::vector<VkImageView> m_vkSwapChainImageViews;
         std::vector<VkFramebuffer> m_vkSwapChainFramebuffers;
+        VkFormat m_vkDepthFormat;
+        ImageHandle m_vkDepthImage;
         
         VkPipelineLayout m_vkPipelineLayout;
         VkDescriptorSetLayout m_vkDescriptorSetLayout;
 
-        VkRenderPass m_vkRenderPass;
+        VkRenderPass m_vkRenderPass = VK_NULL_HANDLE;
+        // Same attachments, but loads them; resumes the frame after command
+        // stream copies and dispatches that cannot run inside a render pass.
+        VkRenderPass m_vkLoadRenderPass = VK_NULL_HANDLE;
+        // VK_KHR_dynamic_rendering, core in 1.3: neither render pass is
+        // created and there are no framebuffers. Passes begin on the image
+        // views directly and pipelines only name the attachment formats.
+        // Set when the device is created, from m_dynamicRendering.
+        bool m_vkDynamicRendering = false;
         VkPipeline m_vkGraphicsPipeline;
+        // Both keyed by depthPipelineKey().
+        std::unordered_map<uint32_t, PipelineHandle> m_vkBasicPipelines;
+        float m_colorIntensity = 1.0f;
 
         VkCommandPool m_vkCommandPool;
+        VkCommandPool m_vkComputeCommandPool;
+
+        // Backend objects behind the handles stored everywhere else.
+        HandlePool<VulkanBuffer, BufferTag> m_vkBuffers;
+        HandlePool<VulkanImage, ImageTag> m_vkImages;
+        HandlePool<VkSampler, SamplerTag> m_vkSamplers;
+        HandlePool<VulkanPipeline, PipelineTag> m_vkPipelines;
 
         VkDeviceSize m_vkVertexBufferSize;
-        VkBuffer m_vkCombinedBuffer;
-        VkDeviceMemory m_vkCombinedBufferMemory;
+        BufferHandle m_vkCombinedBuffer;
 
-        std::vector<VkBuffer> m_vkUniformBuffers;
-        std::vector<VkDeviceMemory> m_vkUniformBuffersMemory;
-        std::vector<void*> m_vkUniformBuffersMapped;
+        std::vector<BufferHandle> m_vkUniformBuffers;
         VkDescriptorPool m_vkDescriptorPool;
         std::vector<VkDescriptorSet> m_vkDescriptorSets;
 
+        std::vector<CommandStream> m_vkSubmittedStreams;
+
+        // Two-phase occlusion culling. Objects visible last frame are drawn
+        // first, a farthest-depth pyramid is built from that depth, and everything
+        // is tested against it; the newly visible objects are drawn on top
+        // and the results become next frame's visible set.
+        bool m_vkOcclusionCullingSupported = false;
+        std::vector<SceneObject> m_sceneObjects;
+        BufferHandle m_vkSceneObjectBuffer;
+        BufferHandle m_vkVisibilityBuffer;
+        // Two lists of m_sceneObjects.size() VkDrawIndexedIndirectCommands, one per phase.
+        BufferHandle m_vkDrawCommandBuffer;
+        BufferHandle m_vkDrawCountBuffer;
+        BufferHandle m_vkHiZCounterBuffer;
+
+        // Kept in VK_IMAGE_LAYOUT_GENERAL; the first use transitions it.
+        ImageHandle m_vkDepthPyramid;
+        std::vector<VkImageView> m_vkDepthPyramidLevelViews;
+        VkExtent2D m_vkDepthPyramidExtent;
+        uint32_t m_vkDepthPyramidLevels = 0;
+        bool m_vkDepthPyramidInitialized = false;
+
+        ShaderReflection m_sceneReflection;
+        ShaderReflection m_cullReflection;
+        ShaderReflection m_hizReflection;
+        VkPipelineLayout m_vkScenePipelineLayout;
+        VkPipelineLayout m_vkCullPipelineLayout;
+        VkPipelineLayout m_vkHiZPipelineLayout;
+        std::unordered_map<uint32_t, PipelineHandle> m_vkScenePipelines;
+        PipelineHandle m_vkCullPipeline;
+        PipelineHandle m_vkHiZPipeline;
+
+        // Reference the depth buffer and pyramid, so the pool is replaced
+        // with them when the swapchain is recreated.
+        VkDescriptorPool m_vkCullingDescriptorPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> m_vkSceneDescriptorSets;
+        std::vector<VkDescriptorSet> m_vkCullDescriptorSets;
+        VkDescriptorSet m_vkHiZDescriptorSet;
+
         std::vector<VkCommandBuffer> m_vkCommandBuffers;
 
         std::vector<VkSemaphore> m_vkImageAvailableSemaphores;
         std::vector<VkSemaphore> m_vkRenderFinishedSemaphores;
-        std::vector<VkFence> m_vkInFlightFences;
+
+        QueueTimeline m_vkGraphicsTimeline;
+        // Graphics timeline value each frame slot signalled last time it was used.
+        uint64_t m_vkFrameTimelineValues[MAX_FRAMES_IN_FLIGHT] = {};
+        QueueTimeline m_vkComputeTimeline;
+
+        // Destruction of objects the GPU may still use, run once every queue
+        // has finished the work submitted before the entry was queued. The
+        // timelines only grow, so entries complete in order.
+        struct DeferredDeletion {
+            uint64_t graphicsValue;
+            uint64_t computeValue;
+            std::function<void(VkDevice)> destroy;
+        };
+        std::deque<DeferredDeletion> m_vkDeletionQueue;
+
+        // Buffers currently owned by the compute family; all others belong to graphics.
+        std::unordered_map<VkBuffer, uint32_t> m_vkBufferOwners;
+        // Consumed by the next graphics submission.
+        std::vector<VkBufferMemoryBarrier> m_vkPendingGraphicsAcquires;
+        VkPipelineStageFlags m_vkPendingGraphicsAcquireStages = 0;
+        std::vector<SemaphoreWait> m_vkPendingGraphicsWaits;
+
+        ShaderLibrary m_shaderLibrary;
+        ShaderReflection m_basicReflection;
+
+        std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, LayoutKeyHash> m_vkDescriptorSetLayoutCache;
+        std::unordered_map<std::vector<uint32_t>, VkPipelineLayout, LayoutKeyHash> m_vkPipelineLayoutCache;
 
         uint32_t currentFrame = 0;
 
+        FramePacer m_framePacer;
+        FrameArenas m_frameArenas{ MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_SIZE };
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+        std::unique_ptr<ShaderWatcher> m_shaderWatcher;
+
+        void reloadShaders();
+#endif
+
         const char** m_extraExtensions;
         int m_extraExtensionsCount;
 
@@ -160,13 +411,76 @@ namespace Nashi {
 
         void createRenderPass();
 
-        void createDescriptorSetLayout();
-        void createGraphicsPipeline();
-        VkShaderModule createShaderModule(const std::vector<char>& code);
+        VkDescriptorSetLayout getDescriptorSetLayout(const ShaderReflection& reflection, uint32_t set);
+        VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+            const std::vector<ReflectedPushConstant>& pushConstants);
+        void destroyLayoutCache();
 
+        void createDescriptorSetLayout();
+        void createPipelineLayout();
+        VkPipeline createGraphicsPipeline(uint32_t variantKey, const char* vertexStage,
+            const ShaderReflection& reflection, VkPipelineLayout layout, DepthPass pass = DepthPass::Single);
+        VkPipeline createComputePipeline(const char* stage, VkPipelineLayout layout,
+            const SpecializationConstants& constants = {});
+        PipelineHandle basicPipeline(uint32_t variantKey, DepthPass pass);
+        VkPipeline getBasicPipeline(uint32_t variantKey, DepthPass pass = DepthPass::Single);
+        void zeroPushConstants(VkCommandBuffer commandBuffer, const VulkanPipeline& pipeline);
+        SpecializationConstants depthConstants() const;
+        VkShaderModule createShaderModule(const ShaderBlob& code);
+
+        VkFormat findDepthFormat();
+        void createDepthResources();
+        void destroyDepthResources();
         void createFramebuffers();
         void createCommandPool();
 
+        void createTimeline(QueueTimeline& timeline, VkQueue queue);
+        void destroyTimeline(QueueTimeline& timeline);
+        uint64_t submitToQueue(QueueTimeline& timeline, std::span<const VkCommandBuffer> commandBuffers,
+            std::span<const SemaphoreWait> waits, std::span<const VkSemaphore> binarySignals);
+        bool hasCompleted(QueueTimeline& timeline, uint64_t value);
+        void waitForTimeline(QueueTimeline& timeline, uint64_t value);
+
+        void deferDestroy(std::function<void(VkDevice)> destroy);
+        void processDeletionQueue();
+        void flushDeletionQueue();
+
+        VkCommandBuffer beginOneTimeCommands(VkCommandPool pool);
+        void recordPendingGraphicsAcquires(VkCommandBuffer commandBuffer);
+
+        // GPU side of the trace: a timestamp pair around each pass, in the
+        // frame slot's range of m_vkTimestampPool. Read back once the slot
+        // comes around again and moved onto the trace clock with
+        // VK_EXT_calibrated_timestamps, or lined up with the submit time
+        // where that is missing. Only created when TRACE_ENABLED.
+        VkQueryPool m_vkTimestampPool = VK_NULL_HANDLE;
+        double m_vkTimestampPeriod = 1.0;
+        uint64_t m_vkTimestampMask = 0;
+        PFN_vkGetCalibratedTimestampsEXT m_vkGetCalibratedTimestamps = nullptr;
+        std::vector<const char*> m_vkGpuScopes[MAX_FRAMES_IN_FLIGHT];
+        uint64_t m_vkFrameSubmitNs[MAX_FRAMES_IN_FLIGHT] = {};
+        TraceTrack* m_gpuTraceTrack = nullptr;
+
+        void createTimestampQueries();
+        // Returns the scope to pass to endGpuScope(); UINT32_MAX when the
+        // frame is out of scopes or timestamps are unavailable.
+        uint32_t beginGpuScope(VkCommandBuffer commandBuffer, const char* name);
+        void endGpuScope(VkCommandBuffer commandBuffer, uint32_t scope);
+        void collectGpuScopes();
+
+        // Counted into m_vkFrameStats from the end of one draw() to the end
+        // of the next, so work between frames lands in the following one.
+        // The slot's pipeline statistics query covers its whole command
+        // buffer and is read back when the slot comes around again.
+        RenderStats m_vkFrameStats;
+        RenderStatsHistory m_renderStats;
+        bool m_vkPipelineStatisticsSupported = false;
+        VkQueryPool m_vkStatisticsPool = VK_NULL_HANDLE;
+        bool m_vkStatisticsPending[MAX_FRAMES_IN_FLIGHT] = {};
+
+        void createStatisticsQueries();
+        void collectPipelineStatistics();
+
         const std::vector<Vertex> m_vertices = {
             // Front face
             {{-0.5f, -0.5f,  0.5f}, {1.0f, 0.0f, 0.0f}}, // 0
@@ -201,6 +515,16 @@ namespace Nashi {
             VkBuffer& buffer, VkDeviceMemory& bufferMemory);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
+        // Pooled resources. destroy* retire through the deletion queue, so a
+        // handle may be dropped while frames that use it are still in flight.
+        BufferHandle createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+        ImageHandle createImage(const VkImageCreateInfo& imageInfo, VkImageAspectFlags aspect);
+        void destroyImage(ImageHandle handle);
+        SamplerHandle createSampler(const VkSamplerCreateInfo& samplerInfo);
+        void destroySampler(SamplerHandle handle);
+        void destroyPipeline(PipelineHandle handle);
+        void destroyResourcePools();
+
         void createCombinedBuffer();
 
         void createUniformBuffers();
@@ -208,19 +532,60 @@ namespace Nashi {
         void createDescriptorPool();
         void createDescriptorSets();
 
+        void createScene();
+        void createCullingPipelines();
+        PipelineHandle scenePipeline(uint32_t variantKey, DepthPass pass = DepthPass::Single);
+        void createCullingDescriptorSets();
+        void recordCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+        void recordDepthPyramid(VkCommandBuffer commandBuffer);
+        void recordSceneDraws(VkCommandBuffer commandBuffer, uint32_t phase);
+
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
         void createCommandBuffers();
 
         void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+        void beginFramePass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool clear);
+        void endFramePass(VkCommandBuffer commandBuffer);
+        void executeCommandStreams(VkCommandBuffer commandBuffer, uint32_t imageIndex);
         void createSyncObjects();
 
     public:
-        bool m_windowResized;
+        bool m_windowResized = false;
+        uint32_t m_shaderVariant = 0;
+        // Draws the culled object grid instead of the single cube; ignored
+        // when the device lacks the indirect count features.
+        bool m_occlusionCulling = false;
+        // Near maps to depth 1 and far to 0: cleared to 0, tested with
+        // GREATER, and the Hi-Z pyramid keeps minimums. Float depth then
+        // keeps its precision far from the camera. Read once by init().
+        bool m_reverseZ = false;
+        // Depth-only prepass for the built-in scene, see DepthPass.
+        bool m_depthPrepass = false;
+        // Render without render pass and framebuffer objects where the
+        // device supports Vulkan 1.3. Read once by init().
+        bool m_dynamicRendering = false;
         VulkanRenderer(const char** m_extraExtensions, int m_extraExtensionsCount, SDL_Window* window, SDL_Event event);
         void init();
         void draw();
         void cleanup();
+
+        void setFramePacing(const FramePacingPolicy& policy);
+        void markInput(uint64_t timestampNs);
+
+        BufferHandle createBuffer(const BufferDesc& desc);
+        void destroyBuffer(BufferHandle handle);
+        void* getMappedData(BufferHandle buffer);
+        PipelineHandle basicPipeline(uint32_t variantKey);
+        void submit(const CommandStream& stream);
+        LinearArena& frameArena();
+
+        // Records and submits job on the compute queue, overlapping with
+        // graphics. Returns the compute timeline value that signals completion.
+        uint64_t submitCompute(const ComputeJob& job);
+
+        // Per-frame counters of the last RENDER_STATS_WINDOW frames.
+        const RenderStatsHistory& renderStats() const { return m_renderStats; }
     };
 };
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace Nashi {
+    // On-disk layout of shaders.nsl, written by tools/shaderpack.cpp:
+    //   ShaderLibraryHeader
+    //   ShaderLibraryEntry[entryCount]   sorted by hash
+    //   stage blobs, each aligned to SHADER_LIBRARY_ALIGNMENT
+    constexpr uint32_t SHADER_LIBRARY_MAGIC = 0x4C48534E; // "NSHL"
+    constexpr uint32_t SHADER_LIBRARY_VERSION = 1;
+    constexpr uint64_t SHADER_LIBRARY_ALIGNMENT = 16;
+    constexpr const char* SHADER_LIBRARY_FILE_NAME = "shaders.nsl";
+
+    struct ShaderLibraryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    struct ShaderLibraryEntry {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // 64-bit FNV-1a over the artifact file name, e.g. "basic.vert.spv".
+    constexpr uint64_t hashShaderName(std::string_view name) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (char c : name) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    struct ShaderBlob {
+        const void* data = nullptr;
+        size_t size = 0;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    // Read-only view of a packed shader library. The file is mapped once and
+    // every ShaderBlob points straight into the mapping, so blobs stay valid
+    // until close().
+    class ShaderLibrary {
+    public:
+        ShaderLibrary() = default;
+        ~ShaderLibrary();
+
+        ShaderLibrary(const ShaderLibrary&) = delete;
+        ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+        bool open(const std::filesystem::path& path);
+        void close();
+        bool isOpen() const { return m_data != nullptr; }
+
+        ShaderBlob find(std::string_view name) const;
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+
+        const ShaderLibraryEntry* m_entries = nullptr;
+        uint32_t m_entryCount = 0;
+
+#ifdef _WIN32
+        void* m_fileHandle = nullptr;
+        void* m_mappingHandle = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Nashi {
+    // Compact per-stage metadata generated at build time from the SPIR-V of
+    // every shader and stored in the shader library as "<stage>.refl", e.g.
+    // "basic.vert.refl". Backends build descriptor/pipeline layouts, root
+    // signatures and vertex input state from it instead of mirroring the
+    // shader by hand.
+    constexpr uint32_t SHADER_REFLECTION_MAGIC = 0x4652534E; // "NSRF"
+    constexpr uint32_t SHADER_REFLECTION_VERSION = 2;
+
+    enum ShaderStageBits : uint32_t {
+        SHADER_STAGE_VERTEX = 1 << 0,
+        SHADER_STAGE_FRAGMENT = 1 << 1,
+        SHADER_STAGE_COMPUTE = 1 << 2,
+    };
+
+    enum class ReflectedDescriptorType : uint32_t {
+        UniformBuffer,
+        StorageBuffer,
+        SampledImage,
+        StorageImage,
+        Sampler,
+        CombinedImageSampler,
+        // A storage buffer the shader never writes (StructuredBuffer in
+        // HLSL); an SRV rather than a UAV on D3D12.
+        ReadOnlyStorageBuffer,
+    };
+
+    enum class ReflectedFormat : uint32_t {
+        Unknown,
+        Float1, Float2, Float3, Float4,
+        Int1, Int2, Int3, Int4,
+        UInt1, UInt2, UInt3, UInt4,
+    };
+
+    struct ReflectedBinding {
+        uint32_t set;
+        uint32_t binding;
+        ReflectedDescriptorType type;
+        uint32_t count;
+        uint32_t size;
+        uint32_t stageMask;
+    };
+
+    struct ReflectedPushConstant {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t stageMask;
+    };
+
+    struct ReflectedVertexInput {
+        uint32_t location;
+        ReflectedFormat format;
+        char semantic[24];
+    };
+
+    struct ShaderReflection {
+        uint32_t stageMask = 0;
+        std::vector<ReflectedBinding> bindings;
+        std::vector<ReflectedPushConstant> pushConstants;
+        std::vector<ReflectedVertexInput> vertexInputs;
+
+        // Folds another stage of the same pipeline into this one; bindings that
+        // appear in both stages are merged into a single entry.
+        void merge(const ShaderReflection& other);
+
+        // Vertex inputs packed tightly in location order, as one interleaved
+        // buffer. Returns the stride and writes one offset per input.
+        uint32_t vertexLayout(std::vector<uint32_t>& offsets) const;
+
+        std::vector<uint8_t> serialize() const;
+        static bool deserialize(const void* data, size_t size, ShaderReflection& reflection);
+    };
+
+    uint32_t reflectedFormatSize(ReflectedFormat format);
+    uint32_t reflectedFormatComponents(ReflectedFormat format);
+
+    // Key used by the backends' layout caches: identical layouts across
+    // shaders hash to the same key and share one API object.
+    struct LayoutKeyHash {
+        size_t operator()(const std::vector<uint32_t>& key) const {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (uint32_t word : key) {
+                hash ^= word;
+                hash *= 0x100000001b3ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+}
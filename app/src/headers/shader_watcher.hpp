@@ -0,0 +1,56 @@
+#pragma once
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Nashi {
+    enum class ShaderTarget {
+        SPIRV,
+        GLSL
+    };
+
+    // Watches the shader source directory with inotify and recompiles changed
+    // stages on a background thread, every variant key variants.txt lists for
+    // them included. The renderer polls takeReloaded() once per frame and
+    // rebuilds whatever pipelines use the returned stages.
+    class ShaderWatcher {
+    public:
+        ShaderWatcher(std::filesystem::path sourceDir, std::filesystem::path outputDir, ShaderTarget target);
+        ~ShaderWatcher();
+
+        void start();
+        void stop();
+
+        // Names of the stages that recompiled successfully since the last call,
+        // e.g. "basic.vert".
+        std::vector<std::string> takeReloaded();
+
+    private:
+        std::filesystem::path m_sourceDir;
+        std::filesystem::path m_outputDir;
+        ShaderTarget m_target;
+
+        int m_inotifyFd = -1;
+        int m_watchFd = -1;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running = false;
+
+        std::mutex m_reloadedMutex;
+        std::vector<std::string> m_reloaded;
+
+        void run();
+        bool readEvents(std::set<std::string>& changed);
+        bool compile(const std::string& fileName);
+        bool compileVariant(const std::string& fileName, uint32_t key);
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NASHI_SIMD_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Lane types for CPU kernels written once as templates over Float/Mask
+// operations. Only include from files built for the baseline instruction
+// set; wider instruction sets get their own translation unit, see
+// occlusion_kernels.hpp.
+namespace Nashi {
+    struct ScalarLanes {
+        using Float = float;
+        using Mask = bool;
+        static constexpr int32_t WIDTH = 1;
+
+        static Float set1(float value) { return value; }
+        static Float ramp() { return 0.0f; }
+        static Float load(const float* pointer) { return *pointer; }
+        static void store(float* pointer, Float value) { *pointer = value; }
+        static Float add(Float a, Float b) { return a + b; }
+        static Float sub(Float a, Float b) { return a - b; }
+        static Float mul(Float a, Float b) { return a * b; }
+        static Float div(Float a, Float b) { return a / b; }
+        static Float min(Float a, Float b) { return a < b ? a : b; }
+        static Float max(Float a, Float b) { return a > b ? a : b; }
+        static Mask greaterEqual(Float a, Float b) { return a >= b; }
+        static Mask greaterThan(Float a, Float b) { return a > b; }
+        static Mask bitAnd(Mask a, Mask b) { return a && b; }
+        static Float select(Mask mask, Float a, Float b) { return mask ? a : b; }
+        static bool any(Mask mask) { return mask; }
+        // Bit i set for active lane i.
+        static uint32_t bits(Mask mask) { return mask ? 1u : 0u; }
+        static float horizontalMax(Float value) { return value; }
+    };
+
+#if defined(NASHI_SIMD_SSE)
+    struct SseLanes {
+        using Float = __m128;
+        using Mask = __m128;
+        static constexpr int32_t WIDTH = 4;
+
+        static Float set1(float value) { return _mm_set1_ps(value); }
+        static Float ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+        static Float load(const float* pointer) { return _mm_loadu_ps(pointer); }
+        static void store(float* pointer, Float value) { _mm_storeu_ps(pointer, value); }
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Mask greaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static Mask greaterThan(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+        static Mask bitAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        static Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static bool any(Mask mask) { return _mm_movemask_ps(mask) != 0; }
+        static uint32_t bits(Mask mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+        static float horizontalMax(Float value) {
+            value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+            value = _mm_max_ss(value, _mm_shuffle_ps(value, value, 1));
+            return _mm_cvtss_f32(value);
+        }
+    };
+
+    using NativeLanes = SseLanes;
+#else
+    using NativeLanes = ScalarLanes;
+#endif
+}
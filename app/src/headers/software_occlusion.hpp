@@ -0,0 +1,92 @@
+#pragma once
+
+#include <occlusion_kernels.hpp>
+#include <tile_jobs.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace Nashi {
+    // CPU occlusion culling for paths without GPU-driven culling. Per frame:
+    //   beginFrame(); addOccluder(...) for large, simple meshes;
+    //   rasterize(); then isVisible(...) per object before recording its draw.
+    // The depth buffer is low resolution and split into tiles that are
+    // rasterized in parallel; each tile also keeps its farthest depth, so
+    // most tests never touch pixels. Occluder triangles with a vertex in
+    // front of the near plane are dropped, which only makes more objects
+    // visible.
+    //
+    // Matrices are column-major 4x4 floats (glm::value_ptr layout) from
+    // object to clip space, and must use forward Z whatever the renderer
+    // does: z / w runs from 0 at the near plane to 1 at the far one, the
+    // buffer clears to 1 and keeps minimums. Clip z < 0 counts as in front
+    // of the near plane, which is exact for Vulkan/D3D and conservative for
+    // GL. A reverse-Z renderer builds objectToClip from a forward projection
+    // of the same frustum.
+    class SoftwareOcclusionCuller {
+    public:
+        // width and height are rounded up to whole tiles. workerCount
+        // threads join the calling thread in rasterize().
+        SoftwareOcclusionCuller(uint32_t width, uint32_t height,
+            uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+        // Runs the given kernels instead of the widest the CPU supports.
+        SoftwareOcclusionCuller(uint32_t width, uint32_t height, const OcclusionKernels& kernels,
+            uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+        SoftwareOcclusionCuller(const SoftwareOcclusionCuller&) = delete;
+        SoftwareOcclusionCuller& operator=(const SoftwareOcclusionCuller&) = delete;
+
+        void beginFrame();
+
+        // positions are float3 at the given byte stride. Both windings are
+        // rasterized, so occluders need no particular orientation.
+        void addOccluder(const float* positions, size_t stride, const uint16_t* indices, size_t indexCount,
+            const float* objectToClip);
+        void addOccluder(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount,
+            const float* objectToClip);
+
+        void rasterize();
+
+        // Object-space box. False only when it is hidden behind the
+        // occluders or entirely off screen.
+        bool isVisible(const float boundsMin[3], const float boundsMax[3], const float* objectToClip) const;
+
+        // Nearest occluder depth at a pixel, 1.0 where nothing was drawn.
+        float depthAt(uint32_t x, uint32_t y) const;
+
+        uint32_t width() const { return m_width; }
+        uint32_t height() const { return m_height; }
+        size_t triangleCount() const { return m_triangles.size(); }
+        const char* kernelName() const { return m_kernels.name; }
+
+    private:
+        template<typename Index>
+        void addTriangles(const float* positions, size_t stride, const Index* indices, size_t indexCount,
+            const float* objectToClip);
+        void setupTriangle(const float* a, const float* b, const float* c);
+
+        void rasterizeTile(uint32_t tile);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_tilesX;
+        uint32_t m_tilesY;
+        OcclusionKernels m_kernels;
+
+        // Tile-major, OCCLUSION_TILE_PIXELS floats per tile stored row by row.
+        std::vector<float> m_depth;
+        std::vector<float> m_tileMaxDepth;
+        // Clip-space positions of the occluder being added, reused between calls.
+        std::vector<float> m_clipPositions;
+        std::vector<OcclusionTriangle> m_triangles;
+        std::vector<std::vector<uint32_t>> m_tileBins;
+
+        TileJobs m_tileJobs;
+    };
+
+    // Every kernel set this CPU can run, narrowest first.
+    std::vector<OcclusionKernels> supportedOcclusionKernels();
+}
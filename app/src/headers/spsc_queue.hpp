@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace Nashi {
+    // Bounded ring between exactly one producer and one consumer thread.
+    // tryPush and tryPop never lock: each side owns one counter and only
+    // reads the other's. push and pop park on a condition variable while the
+    // ring is full or empty, and the other side only takes the mutex to wake
+    // them when someone is actually parked. The counters sit on their own
+    // cache lines so the two sides do not invalidate each other on every
+    // operation.
+    template<typename T>
+    class SpscQueue {
+    public:
+        explicit SpscQueue(uint32_t capacity)
+            : m_slots(std::make_unique<T[]>(capacity)), m_capacity(capacity) {}
+
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        // Moves from value only when it returns true.
+        bool tryPush(T& value) {
+            const uint64_t head = m_head.value.load(std::memory_order_relaxed);
+            if (head - m_tail.value.load(std::memory_order_acquire) == m_capacity) {
+                return false;
+            }
+            publish(head, value);
+            return true;
+        }
+
+        void push(T value) {
+            while (!tryPush(value)) {
+                park([this] {
+                    return m_head.value.load(std::memory_order_relaxed) - m_tail.value.load(std::memory_order_acquire) < m_capacity;
+                });
+            }
+        }
+
+        std::optional<T> tryPop() {
+            const uint64_t tail = m_tail.value.load(std::memory_order_relaxed);
+            if (m_head.value.load(std::memory_order_acquire) == tail) {
+                return std::nullopt;
+            }
+            return consume(tail);
+        }
+
+        T pop() {
+            for (;;) {
+                if (std::optional<T> value = tryPop()) {
+                    return std::move(*value);
+                }
+                park([this] {
+                    return m_head.value.load(std::memory_order_acquire) != m_tail.value.load(std::memory_order_relaxed);
+                });
+            }
+        }
+
+        uint32_t capacity() const { return m_capacity; }
+
+    private:
+        void publish(uint64_t head, T& value) {
+            m_slots[head % m_capacity] = std::move(value);
+            m_head.value.store(head + 1, std::memory_order_release);
+            wake();
+        }
+
+        T consume(uint64_t tail) {
+            T value = std::move(m_slots[tail % m_capacity]);
+            m_tail.value.store(tail + 1, std::memory_order_release);
+            wake();
+            return value;
+        }
+
+        // The fences pair the counter stores with the m_parked checks: either
+        // wake() sees the parked thread, or that thread's ready() sees the
+        // new counter before it sleeps.
+        template<typename Ready>
+        void park(Ready ready) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_parked.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_changed.wait(lock, ready);
+            m_parked.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void wake() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_parked.load(std::memory_order_relaxed) != 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_changed.notify_all();
+            }
+        }
+
+        // 64 bytes rather than std::hardware_destructive_interference_size,
+        // which GCC warns about using in headers.
+        struct alignas(64) Counter {
+            std::atomic<uint64_t> value{ 0 };
+        };
+
+        std::unique_ptr<T[]> m_slots;
+        uint32_t m_capacity;
+        // Pushed and popped counts; the ring holds head - tail values.
+        Counter m_head;
+        Counter m_tail;
+
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::atomic<uint32_t> m_parked{ 0 };
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Nashi {
+    // Worker threads for the software rasterizers. run() hands the tiles of
+    // one pass out through an atomic counter to the workers and the calling
+    // thread, and returns once every tile is done, so a tile is never run
+    // twice and the job may write anything that belongs to its tile.
+    // Whatever the caller wrote before run() is visible to the job.
+    class TileJobs {
+    public:
+        explicit TileJobs(uint32_t workerCount = 0);
+        ~TileJobs();
+
+        TileJobs(const TileJobs&) = delete;
+        TileJobs& operator=(const TileJobs&) = delete;
+
+        // Stops the current workers first. With no workers run() does all
+        // the tiles itself.
+        void start(uint32_t workerCount);
+        void stop();
+
+        void run(uint32_t tileCount, const std::function<void(uint32_t tile)>& job);
+
+        uint32_t workerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        uint64_t m_generation = 0;
+        uint32_t m_busyWorkers = 0;
+        bool m_stop = false;
+
+        // Set for the duration of run().
+        const std::function<void(uint32_t)>* m_job = nullptr;
+        uint32_t m_tileCount = 0;
+        std::atomic<uint32_t> m_nextTile{ 0 };
+
+        void runTiles();
+        void workerLoop(uint64_t generation);
+    };
+}
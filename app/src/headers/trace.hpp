@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Trace scopes are compiled into development builds. Release builds drop
+// them unless configured with -DNASHI_TRACE=ON.
+#if !defined(NASHI_RELEASE_BUILD) || defined(NASHI_TRACE)
+#define NASHI_TRACE_ENABLED 1
+#else
+#define NASHI_TRACE_ENABLED 0
+#endif
+
+namespace Nashi {
+    constexpr bool TRACE_ENABLED = NASHI_TRACE_ENABLED;
+    // Events a track keeps; older ones are overwritten.
+    constexpr uint32_t TRACE_TRACK_CAPACITY = 1 << 15;
+
+    // A named span on the trace clock. The name is not copied, so it has to
+    // be a string literal or otherwise outlive the trace.
+    struct TraceEvent {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    // Ring of events with a single producer: the thread it belongs to, or
+    // whoever owns a track like a GPU queue's. push() never locks or
+    // blocks. The producer claims a slot before it overwrites it, and
+    // readers copy the ring and then drop every slot claimed meanwhile, so a
+    // half overwritten event is never reported.
+    class TraceTrack {
+    public:
+        TraceTrack(uint32_t id, std::string name);
+
+        void push(const TraceEvent& event) {
+            const uint64_t index = m_written.load(std::memory_order_relaxed);
+            // A reader that sees any of the slot stores below also sees the
+            // claim, and with it that event index - CAPACITY is gone.
+            m_claimed.store(index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            Slot& slot = m_slots[index % TRACE_TRACK_CAPACITY];
+            slot.name.store(event.name, std::memory_order_relaxed);
+            slot.startNs.store(event.startNs, std::memory_order_relaxed);
+            slot.endNs.store(event.endNs, std::memory_order_relaxed);
+            m_written.store(index + 1, std::memory_order_release);
+        }
+
+        uint32_t id() const { return m_id; }
+        const std::string& name() const { return m_name; }
+        // Goes through setTraceThreadName(), which orders it with dumps.
+        void setName(std::string name) { m_name = std::move(name); }
+
+        // Calls fn(const TraceEvent&) for the events still in the ring,
+        // oldest first.
+        template<typename Fn>
+        void read(Fn fn) const;
+
+    private:
+        struct Slot {
+            std::atomic<const char*> name{ nullptr };
+            std::atomic<uint64_t> startNs{ 0 };
+            std::atomic<uint64_t> endNs{ 0 };
+        };
+
+        uint32_t m_id;
+        std::string m_name;
+        std::unique_ptr<Slot[]> m_slots;
+        // Events started and finished; claimed runs at most one ahead.
+        std::atomic<uint64_t> m_claimed{ 0 };
+        std::atomic<uint64_t> m_written{ 0 };
+    };
+
+    // Nanoseconds on std::chrono::steady_clock, which is CLOCK_MONOTONIC on
+    // Linux; GPU timestamps are calibrated against that domain.
+    uint64_t traceNow();
+
+    // The calling thread's track, created on first use.
+    TraceTrack& threadTraceTrack();
+    void setTraceThreadName(const char* name);
+    // A track that is not a thread's, e.g. a GPU queue. Lives until exit.
+    TraceTrack& createTraceTrack(const char* name);
+
+    // Writes every track as Chrome trace JSON, which Perfetto and
+    // chrome://tracing open. Safe to call while other threads trace.
+    bool writeChromeTrace(const std::string& path);
+
+    class TraceScope {
+    public:
+        explicit TraceScope(const char* name) : m_name(name), m_startNs(traceNow()) {}
+        ~TraceScope() { threadTraceTrack().push({ m_name, m_startNs, traceNow() }); }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_startNs;
+    };
+
+    template<typename Fn>
+    void TraceTrack::read(Fn fn) const {
+        const uint64_t written = m_written.load(std::memory_order_acquire);
+        const uint64_t first = written > TRACE_TRACK_CAPACITY ? written - TRACE_TRACK_CAPACITY : 0;
+        // Copied before anything is reported, so slots the producer reaches
+        // during the copy can still be told apart afterwards.
+        std::unique_ptr<TraceEvent[]> events(new TraceEvent[written - first]);
+        for (uint64_t i = first; i < written; i++) {
+            const Slot& slot = m_slots[i % TRACE_TRACK_CAPACITY];
+            events[i - first] = {
+                slot.name.load(std::memory_order_relaxed),
+                slot.startNs.load(std::memory_order_relaxed),
+                slot.endNs.load(std::memory_order_relaxed) };
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = m_claimed.load(std::memory_order_relaxed);
+        const uint64_t valid = claimed > TRACE_TRACK_CAPACITY ? claimed - TRACE_TRACK_CAPACITY : 0;
+        for (uint64_t i = first > valid ? first : valid; i < written; i++) {
+            fn(events[i - first]);
+        }
+    }
+}
+
+#if NASHI_TRACE_ENABLED
+#define NASHI_TRACE_CONCAT_(a, b) a##b
+#define NASHI_TRACE_CONCAT(a, b) NASHI_TRACE_CONCAT_(a, b)
+// Traces the rest of the enclosing block under name.
+#define NASHI_TRACE_SCOPE(name) ::Nashi::TraceScope NASHI_TRACE_CONCAT(nashiTraceScope, __LINE__)(name)
+#define NASHI_TRACE_THREAD_NAME(name) ::Nashi::setTraceThreadName(name)
+#else
+#define NASHI_TRACE_SCOPE(name) ((void)0)
+#define NASHI_TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,53 @@
+#include <linear_arena.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace Nashi {
+    LinearArena::LinearArena(size_t capacity)
+        : m_memory(static_cast<uint8_t*>(::operator new(capacity, std::align_val_t{ alignof(std::max_align_t) })))
+        , m_capacity(capacity) {
+    }
+
+    LinearArena::~LinearArena() {
+        ::operator delete(m_memory, std::align_val_t{ alignof(std::max_align_t) });
+    }
+
+    void* LinearArena::allocate(size_t size, size_t alignment) {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= alignof(std::max_align_t));
+
+        // Over-reserve by the worst-case padding so the add never has to be
+        // retried; the slack is at most alignment - 1 bytes per allocation.
+        size_t reserved = size + alignment - 1;
+        size_t offset = m_offset.fetch_add(reserved, std::memory_order_relaxed);
+        if (offset + reserved > m_capacity) {
+            return nullptr;
+        }
+
+        uintptr_t address = reinterpret_cast<uintptr_t>(m_memory + offset);
+        address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        return reinterpret_cast<void*>(address);
+    }
+
+    size_t LinearArena::used() const {
+        return std::min(m_offset.load(std::memory_order_relaxed), m_capacity);
+    }
+
+    FrameArenas::FrameArenas(size_t frameCount, size_t capacityPerFrame) {
+        assert(frameCount >= 2);
+        for (size_t i = 0; i < frameCount; i++) {
+            m_arenas.push_back(std::make_unique<LinearArena>(capacityPerFrame));
+        }
+    }
+
+    void FrameArenas::endFrame() {
+        m_current = (m_current + 1) % m_arenas.size();
+        m_arenas[m_current]->reset();
+    }
+
+    LinearArena& scratchArena() {
+        thread_local LinearArena arena(SCRATCH_ARENA_SIZE);
+        return arena;
+    }
+}
@@ -6,17 +6,91 @@
 #   include <renderer_d3d12.hpp>
 #elif NASHI_USE_METAL
 #   include <renderer_mtl.hpp>
+#elif NASHI_USE_SOFTWARE
+#   include <renderer_sw.hpp>
 #endif
 
 
+#include <app_scene.hpp>
+#include <frame_capture.hpp>
+#include <render_thread.hpp>
+#include <trace.hpp>
+
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
-int main() {
+int main(int argc, char** argv) {
+  NASHI_TRACE_THREAD_NAME("main");
+  Nashi::FramePacingPolicy framePacing = Nashi::parseFramePacingArgs(argc, argv);
+
+#ifdef NASHI_USE_SOFTWARE
+  // --offscreen=N renders N frames without SDL video or a window, for
+  // machines that have neither; --save-frame=path.ppm keeps the last one.
+  uint32_t offscreenFrames = 0;
+  const char* saveFramePath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--offscreen=")) {
+      offscreenFrames = static_cast<uint32_t>(std::atoi(argv[i] + arg.find('=') + 1));
+    } else if (arg.starts_with("--save-frame=")) {
+      saveFramePath = argv[i] + arg.find('=') + 1;
+    }
+  }
+
+  if (offscreenFrames > 0) {
+    SDL_Event offscreenEvent;
+    memset(&offscreenEvent, 0, sizeof(offscreenEvent));
+    Nashi::SoftwareRenderer offscreenRenderer(nullptr, offscreenEvent);
+    offscreenRenderer.setFramePacing(framePacing);
+    offscreenRenderer.init();
+
+    uint64_t startNs = SDL_GetTicksNS();
+    for (uint32_t frame = 0; frame < offscreenFrames; frame++) {
+      offscreenRenderer.draw();
+    }
+    double frameMs = (SDL_GetTicksNS() - startNs) / 1e6 / offscreenFrames;
+    std::cout << offscreenFrames << " frames at " << offscreenRenderer.width() << "x" << offscreenRenderer.height()
+      << ", " << frameMs << " ms per frame" << std::endl;
+
+    int result = EXIT_SUCCESS;
+    if (saveFramePath && !offscreenRenderer.saveFrame(saveFramePath)) {
+      std::cerr << "failed to write " << saveFramePath << "\n";
+      result = EXIT_FAILURE;
+    }
+    offscreenRenderer.cleanup();
+    return result;
+  }
+#endif
+
   if(SDL_Init(SDL_INIT_VIDEO) == false) {
     return EXIT_FAILURE;
   }
 
+#ifdef NASHI_USE_VULKAN
+  bool occlusionCulling = false;
+  bool reverseZ = false;
+  bool depthPrepass = false;
+  bool dynamicRendering = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--occlusion-culling") {
+      occlusionCulling = true;
+    }
+    else if (std::string_view(argv[i]) == "--reverse-z") {
+      reverseZ = true;
+    }
+    else if (std::string_view(argv[i]) == "--depth-prepass") {
+      depthPrepass = true;
+    }
+    else if (std::string_view(argv[i]) == "--dynamic-rendering") {
+      dynamicRendering = true;
+    }
+  }
+#endif
+
 #ifdef NASHI_USE_OPENGL
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
@@ -43,6 +117,46 @@ int main() {
     return EXIT_FAILURE;
   }
 
+#if defined(NASHI_USE_VULKAN) || defined(NASHI_USE_OPENGL)
+  // --render-stats logs the rolling per-frame averages once a second.
+  bool renderStats = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--render-stats") {
+      renderStats = true;
+    }
+  }
+  uint64_t renderStatsLoggedNs = SDL_GetTicksNS();
+#endif
+
+#ifndef NASHI_USE_METAL
+  // --threaded[=N] moves the renderer to a render thread that trails the
+  // event loop by at most N frames (1 by default).
+  bool threaded = false;
+  uint32_t renderQueueDepth = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--threaded") {
+      threaded = true;
+    } else if (arg.starts_with("--threaded=")) {
+      threaded = true;
+      renderQueueDepth = static_cast<uint32_t>(std::atoi(argv[i] + arg.find('=') + 1));
+    }
+  }
+
+  // --capture=path records what is created and submitted over the next
+  // --capture-frames=N frames (300 by default) for nashi_replay.
+  const char* capturePath = nullptr;
+  uint32_t captureFrames = 300;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--capture=")) {
+      capturePath = argv[i] + arg.find('=') + 1;
+    } else if (arg.starts_with("--capture-frames=")) {
+      captureFrames = static_cast<uint32_t>(std::atoi(argv[i] + arg.find('=') + 1));
+    }
+  }
+#endif
+
   bool running = true;
   SDL_Event event;
   memset(&event, 0, sizeof(event));
@@ -70,21 +184,111 @@ int main() {
   SDL_memcpy(&extensions[1], instance_extensions, count_instance_extensions * sizeof(const char*)); 
 
   Nashi::VulkanRenderer* vkRenderer = new Nashi::VulkanRenderer(extensions, countExtensions, window, event);
-  vkRenderer->init();
+  vkRenderer->setFramePacing(framePacing);
+  vkRenderer->m_occlusionCulling = occlusionCulling;
+  vkRenderer->m_reverseZ = reverseZ;
+  vkRenderer->m_depthPrepass = depthPrepass;
+  vkRenderer->m_dynamicRendering = dynamicRendering;
 #elif NASHI_USE_OPENGL
   Nashi::OpenGLRenderer* openGLRenderer = new Nashi::OpenGLRenderer(window, event);
-  openGLRenderer->init();
+  openGLRenderer->setFramePacing(framePacing);
 
 #elif NASHI_USE_DIRECT3D12
   HWND hwnd = (HWND) SDL_GetPointerProperty(SDL_GetWindowProperties(window), SDL_PROP_WINDOW_WIN32_HWND_POINTER, NULL);
 
   Nashi::Direct3D12Renderer* direct3D12Renderer = new Nashi::Direct3D12Renderer(window, event, hwnd);
+  direct3D12Renderer->setFramePacing(framePacing);
+#elif NASHI_USE_SOFTWARE
+  Nashi::SoftwareRenderer* softwareRenderer = new Nashi::SoftwareRenderer(window, event);
+  softwareRenderer->setFramePacing(framePacing);
+#endif
 
-  direct3D12Renderer->init();
+#ifdef NASHI_USE_VULKAN
+  Nashi::VulkanRenderer* renderer = vkRenderer;
+#elif NASHI_USE_OPENGL
+  Nashi::OpenGLRenderer* renderer = openGLRenderer;
+#elif NASHI_USE_DIRECT3D12
+  Nashi::Direct3D12Renderer* renderer = direct3D12Renderer;
+#elif NASHI_USE_SOFTWARE
+  Nashi::SoftwareRenderer* renderer = softwareRenderer;
 #endif
 
+#ifndef NASHI_USE_METAL
+  // The app creates and submits everything through the recorder, which
+  // only forwards to the renderer when there is nothing to capture.
+  using CaptureRecorder = Nashi::FrameRecorder<std::remove_pointer_t<decltype(renderer)>>;
+  auto recorder = std::make_unique<CaptureRecorder>(*renderer,
+    capturePath ? capturePath : "", capturePath ? captureFrames : 0);
+  Nashi::AppScene<CaptureRecorder> appScene;
+  // The app thread builds each frame's floor into the next of these and
+  // hands it over in the packet; see MAX_RENDER_PACKETS_IN_FLIGHT.
+  auto sceneFrames = std::make_unique<Nashi::AppSceneFrame[]>(Nashi::MAX_RENDER_PACKETS_IN_FLIGHT);
+  // The app thread's copy of the shader variant key the floor draws with.
+  uint32_t sceneVariant = 0;
 
+  // Everything below touches the renderer, so with --threaded it only runs
+  // on the render thread. It only submits what the packet carries.
+  auto renderFrame = [&](const Nashi::FramePacket& packet) {
+    if (packet.windowResized) {
+      renderer->m_windowResized = true;
+    }
+    if (packet.inputTimestampNs != 0) {
+      renderer->markInput(packet.inputTimestampNs);
+    }
+    renderer->m_shaderVariant ^= packet.shaderVariantToggles;
+#if defined(NASHI_USE_VULKAN) || defined(NASHI_USE_SOFTWARE)
+    if (packet.toggleOcclusionCulling) {
+      renderer->m_occlusionCulling = !renderer->m_occlusionCulling;
+    }
+#endif
+#ifdef NASHI_USE_VULKAN
+    if (packet.toggleDepthPrepass) {
+      renderer->m_depthPrepass = !renderer->m_depthPrepass;
+    }
+#endif
+
+    if (packet.windowMinimized) {
+      return;
+    }
+    if (packet.scene) {
+      appScene.submit(*recorder, *packet.scene);
+    }
+    recorder->endFrame();
+    renderer->draw();
+
+#if defined(NASHI_USE_VULKAN) || defined(NASHI_USE_OPENGL)
+    if (renderStats && SDL_GetTicksNS() - renderStatsLoggedNs >= 1000000000) {
+      renderStatsLoggedNs = SDL_GetTicksNS();
+      std::cout << Nashi::formatRenderStats(renderer->renderStats().average()) << std::endl;
+    }
+#endif
+  };
+
+  std::unique_ptr<Nashi::RenderThread> renderThread;
+  if (threaded) {
+#ifdef NASHI_USE_OPENGL
+    renderer->createContext();
+#endif
+    renderThread = std::make_unique<Nashi::RenderThread>(renderQueueDepth,
+      [&] { renderer->init(); appScene.create(*recorder); }, renderFrame,
+      [&] { appScene.destroy(*recorder); renderer->cleanup(); });
+    renderThread->start();
+  }
+  else {
+    renderer->init();
+    appScene.create(*recorder);
+  }
+#endif
+
+  uint64_t frameIndex = 0;
   while(running) {
+    // Nothing gets drawn while minimized, so sleep until SDL has news
+    // rather than spinning through empty frames.
+    if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
+      SDL_WaitEvent(nullptr);
+    }
+    Nashi::FramePacket packet;
+    packet.frame = frameIndex++;
     while (SDL_PollEvent(&event)) {
       switch(event.type) {
         case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
@@ -92,31 +296,66 @@ int main() {
           running = false;
           break;
         case SDL_EVENT_WINDOW_RESIZED:
-#ifdef NASHI_USE_VULKAN
-          vkRenderer->m_windowResized = true;
-#elif NASHI_USE_OPENGL
-          openGLRenderer->m_windowResized = true;
-#elif NASHI_USE_DIRECT3D12
-          direct3D12Renderer->m_windowResized = true;
+          packet.windowResized = true;
+          break;
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_MOTION:
+          if (packet.inputTimestampNs == 0 || event.common.timestamp < packet.inputTimestampNs) {
+            packet.inputTimestampNs = event.common.timestamp;
+          }
+          if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F2) {
+            packet.shaderVariantToggles ^= Nashi::BASIC_FEATURE_DESATURATE;
+          }
+          if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F3) {
+            packet.toggleOcclusionCulling = !packet.toggleOcclusionCulling;
+          }
+          if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F4) {
+            packet.toggleDepthPrepass = !packet.toggleDepthPrepass;
+          }
+#if NASHI_TRACE_ENABLED
+          // Everything traced so far; open it in ui.perfetto.dev.
+          if (event.type == SDL_EVENT_KEY_DOWN && event.key.key == SDLK_F5) {
+            if (Nashi::writeChromeTrace("nashi_trace.json")) {
+              std::cout << "trace written to nashi_trace.json" << std::endl;
+            }
+            else {
+              std::cerr << "failed to write nashi_trace.json" << std::endl;
+            }
+          }
 #endif
           break;
       }
     }
-#ifdef NASHI_USE_VULKAN
-    vkRenderer->draw();
-#elif NASHI_USE_OPENGL
-    openGLRenderer->draw();
-#elif NASHI_USE_DIRECT3D12
-    direct3D12Renderer->draw();
+    packet.windowMinimized = (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) != 0;
+#ifndef NASHI_USE_METAL
+    sceneVariant ^= packet.shaderVariantToggles;
+    if (!packet.windowMinimized) {
+      Nashi::AppSceneFrame& sceneFrame = sceneFrames[packet.frame % Nashi::MAX_RENDER_PACKETS_IN_FLIGHT];
+      if (appScene.build(sceneFrame, packet.frame, sceneVariant)) {
+        packet.scene = &sceneFrame;
+      }
+    }
+    if (renderThread) {
+      renderThread->push(packet);
+    }
+    else {
+      renderFrame(packet);
+    }
 #endif
-
   }
-#ifdef NASHI_USE_VULKAN
-  vkRenderer->cleanup();
-#elif NASHI_USE_OPENGL
-  openGLRenderer->cleanup();
-#elif NASHI_USE_DIRECT3D12
-  direct3D12Renderer->cleanup();
+#ifndef NASHI_USE_METAL
+  if (renderThread) {
+    renderThread->stop();
+#ifdef NASHI_USE_OPENGL
+    renderer->destroyContext();
+#endif
+  }
+  else {
+    appScene.destroy(*recorder);
+    renderer->cleanup();
+  }
+  recorder.reset();
 #endif
 
   SDL_DestroyWindow(window);
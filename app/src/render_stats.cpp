@@ -0,0 +1,91 @@
+#include <render_stats.hpp>
+
+#include <cstdio>
+
+namespace Nashi {
+    namespace {
+        // Applies fn(uint64_t& field, const uint64_t& source) to every CPU
+        // counter.
+        template<typename Fn>
+        void forEachCpuCounter(RenderStats& stats, const RenderStats& source, Fn fn) {
+            fn(stats.draws, source.draws);
+            fn(stats.instances, source.instances);
+            fn(stats.triangles, source.triangles);
+            fn(stats.dispatches, source.dispatches);
+            fn(stats.pipelineBinds, source.pipelineBinds);
+            fn(stats.descriptorBinds, source.descriptorBinds);
+            fn(stats.descriptorUpdates, source.descriptorUpdates);
+            fn(stats.bytesUploaded, source.bytesUploaded);
+            fn(stats.allocations, source.allocations);
+            fn(stats.frameTimeNs, source.frameTimeNs);
+        }
+
+        template<typename Fn>
+        void forEachGpuCounter(RenderStats& stats, const RenderStats& source, Fn fn) {
+            fn(stats.vertexInvocations, source.vertexInvocations);
+            fn(stats.fragmentInvocations, source.fragmentInvocations);
+            fn(stats.computeInvocations, source.computeInvocations);
+        }
+    }
+
+    std::string formatRenderStats(const RenderStats& stats) {
+        char gpu[128] = "n/a";
+        if (stats.gpuCountersValid) {
+            snprintf(gpu, sizeof(gpu), "%llu vs, %llu fs, %llu cs",
+                static_cast<unsigned long long>(stats.vertexInvocations),
+                static_cast<unsigned long long>(stats.fragmentInvocations),
+                static_cast<unsigned long long>(stats.computeInvocations));
+        }
+
+        char line[512];
+        snprintf(line, sizeof(line),
+            "cpu %.2f ms | draws %llu, instances %llu, triangles %llu, dispatches %llu | "
+            "binds %llu pipeline, %llu descriptor, %llu descriptor updates | "
+            "uploaded %llu B, %llu allocations | gpu invocations %s",
+            static_cast<double>(stats.frameTimeNs) / 1e6,
+            static_cast<unsigned long long>(stats.draws),
+            static_cast<unsigned long long>(stats.instances),
+            static_cast<unsigned long long>(stats.triangles),
+            static_cast<unsigned long long>(stats.dispatches),
+            static_cast<unsigned long long>(stats.pipelineBinds),
+            static_cast<unsigned long long>(stats.descriptorBinds),
+            static_cast<unsigned long long>(stats.descriptorUpdates),
+            static_cast<unsigned long long>(stats.bytesUploaded),
+            static_cast<unsigned long long>(stats.allocations),
+            gpu);
+        return line;
+    }
+
+    void RenderStatsHistory::push(const RenderStats& stats) {
+        m_frames[m_next] = stats;
+        m_next = (m_next + 1) % RENDER_STATS_WINDOW;
+        if (m_count < RENDER_STATS_WINDOW) {
+            m_count++;
+        }
+    }
+
+    RenderStats RenderStatsHistory::average() const {
+        auto add = [](uint64_t& field, const uint64_t& value) { field += value; };
+        auto divideBy = [](uint64_t count) {
+            return [count](uint64_t& field, const uint64_t&) { field = (field + count / 2) / count; };
+        };
+
+        RenderStats sum;
+        uint64_t gpuFrames = 0;
+        for (uint32_t i = 0; i < m_count; i++) {
+            forEachCpuCounter(sum, m_frames[i], add);
+            if (m_frames[i].gpuCountersValid) {
+                forEachGpuCounter(sum, m_frames[i], add);
+                gpuFrames++;
+            }
+        }
+        if (m_count > 1) {
+            forEachCpuCounter(sum, sum, divideBy(m_count));
+        }
+        if (gpuFrames > 1) {
+            forEachGpuCounter(sum, sum, divideBy(gpuFrames));
+        }
+        sum.gpuCountersValid = gpuFrames > 0;
+        return sum;
+    }
+}
@@ -0,0 +1,57 @@
+#include <render_thread.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+
+namespace Nashi {
+    RenderThread::RenderThread(uint32_t queueDepth, std::function<void()> init,
+        std::function<void(const FramePacket&)> frame, std::function<void()> cleanup)
+        : m_packets(std::clamp(queueDepth, 1u, MAX_RENDER_QUEUE_DEPTH)),
+        m_init(std::move(init)), m_frame(std::move(frame)), m_cleanup(std::move(cleanup)) {}
+
+    RenderThread::~RenderThread() {
+        stop();
+    }
+
+    void RenderThread::start() {
+        if (m_thread.joinable()) {
+            return;
+        }
+        std::promise<void> initialized;
+        std::future<void> ready = initialized.get_future();
+        m_thread = std::thread(&RenderThread::run, this, std::ref(initialized));
+        ready.wait();
+    }
+
+    void RenderThread::push(const FramePacket& packet) {
+        NASHI_TRACE_SCOPE("RenderThread::push");
+        m_packets.push(packet);
+    }
+
+    void RenderThread::stop() {
+        if (!m_thread.joinable()) {
+            return;
+        }
+        FramePacket quit;
+        quit.quit = true;
+        m_packets.push(quit);
+        m_thread.join();
+    }
+
+    void RenderThread::run(std::promise<void>& initialized) {
+        NASHI_TRACE_THREAD_NAME("render");
+        m_init();
+        initialized.set_value();
+        for (;;) {
+            FramePacket packet = [this] {
+                NASHI_TRACE_SCOPE("RenderThread::wait");
+                return m_packets.pop();
+            }();
+            if (packet.quit) {
+                break;
+            }
+            m_frame(packet);
+        }
+        m_cleanup();
+    }
+}
@@ -120,7 +120,8 @@ namespace Nashi {
 		swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
 		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 		swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-		swapChainDesc.Flags = m_dxTearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT |
+			(m_dxTearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
 
 		ComPtr<IDXGISwapChain1> swapChain1;
 		CHECK_DX(m_dxFactory5->CreateSwapChainForHwnd(m_dxCommandQueue.Get(),
@@ -130,6 +131,11 @@ namespace Nashi {
 
 		CHECK_DX(swapChain1.As(&m_dxSwapChain));
 
+		// All m_dxNumFrames buffers exist, DXGI blocks the CPU once
+		// frameQueueDepth presents are queued.
+		CHECK_DX(m_dxSwapChain->SetMaximumFrameLatency(m_framePacer.policy().frameQueueDepth));
+		m_dxFrameLatencyWaitable = m_dxSwapChain->GetFrameLatencyWaitableObject();
+
 		m_dxCurrentBackBufferIndex = m_dxSwapChain->GetCurrentBackBufferIndex();
 
 		createDescriptorHeap();
@@ -192,32 +198,142 @@ namespace Nashi {
 		return fenceValueForSignal;
 	}
 
-	void Direct3D12Renderer::waitForFenceValue(std::chrono::milliseconds duration) {
-		if (m_dxFence->GetCompletedValue() < m_dxFenceValue) {
-			CHECK_DX(m_dxFence->SetEventOnCompletion(m_dxFenceValue, m_dxFenceEvent));
+	void Direct3D12Renderer::waitForFenceValue(uint64_t fenceValue, std::chrono::milliseconds duration) {
+		if (m_dxFence->GetCompletedValue() < fenceValue) {
+			CHECK_DX(m_dxFence->SetEventOnCompletion(fenceValue, m_dxFenceEvent));
 			::WaitForSingleObject(m_dxFenceEvent, static_cast<DWORD>(duration.count()));
 		}
 	}
 
 	void Direct3D12Renderer::flush() {
-		signalFence();
-		waitForFenceValue();
+		waitForFenceValue(signalFence());
+	}
+
+	void Direct3D12Renderer::deferRelease(ComPtr<IUnknown> object) {
+		m_dxDeferredReleases.emplace(m_dxFenceValue, std::move(object));
+	}
+
+	void Direct3D12Renderer::processDeferredReleases() {
+		uint64_t completed = m_dxFence->GetCompletedValue();
+		while (!m_dxDeferredReleases.empty() && m_dxDeferredReleases.front().first <= completed) {
+			m_dxDeferredReleases.pop();
+		}
+	}
+
+	BufferHandle Direct3D12Renderer::createBuffer(D3D12_HEAP_TYPE heapType, UINT64 size, D3D12_RESOURCE_STATES initialState,
+		D3D12_RESOURCE_FLAGS flags) {
+		const CD3DX12_HEAP_PROPERTIES heapProps{ heapType };
+		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+
+		ComPtr<ID3D12Resource> buffer;
+		CHECK_DX(m_dxDevice->CreateCommittedResource(
+			&heapProps,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferDesc,
+			initialState,
+			nullptr,
+			IID_PPV_ARGS(&buffer)));
+		return m_dxBuffers.create({ std::move(buffer), size, heapType, nullptr });
+	}
+
+	ID3D12Resource* Direct3D12Renderer::getBuffer(BufferHandle handle) const {
+		const DirectXBuffer* buffer = m_dxBuffers.get(handle);
+		return buffer ? buffer->resource.Get() : nullptr;
+	}
+
+	void Direct3D12Renderer::destroyBuffer(BufferHandle handle) {
+		if (std::optional<DirectXBuffer> buffer = m_dxBuffers.remove(handle)) {
+			deferRelease(std::move(buffer->resource));
+		}
+	}
+
+	// Host-visible buffers live in the upload heap and stay in GENERIC_READ.
+	// Default-heap buffers rest in COMMON between frames; command streams
+	// transition them as they are used and back again at the end.
+	BufferHandle Direct3D12Renderer::createBuffer(const BufferDesc& desc) {
+		if (desc.hostVisible) {
+			BufferHandle handle = createBuffer(D3D12_HEAP_TYPE_UPLOAD, desc.size, D3D12_RESOURCE_STATE_GENERIC_READ);
+			DirectXBuffer* buffer = m_dxBuffers.get(handle);
+
+			CD3DX12_RANGE readRange{ 0, 0 };
+			CHECK_DX(buffer->resource->Map(0, &readRange, &buffer->mapped));
+			if (desc.initialData) {
+				memcpy(buffer->mapped, desc.initialData, desc.size);
+			}
+			return handle;
+		}
+
+		D3D12_RESOURCE_FLAGS flags = desc.usage & BUFFER_USAGE_STORAGE
+			? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
+		BufferHandle handle = createBuffer(D3D12_HEAP_TYPE_DEFAULT, desc.size, D3D12_RESOURCE_STATE_COMMON, flags);
+		if (!desc.initialData) {
+			return handle;
+		}
+
+		BufferHandle upload = createBuffer(D3D12_HEAP_TYPE_UPLOAD, desc.size, D3D12_RESOURCE_STATE_GENERIC_READ);
+		ID3D12Resource* uploadBuffer = getBuffer(upload);
+		void* data = nullptr;
+		CD3DX12_RANGE readRange{ 0, 0 };
+		CHECK_DX(uploadBuffer->Map(0, &readRange, &data));
+		memcpy(data, desc.initialData, desc.size);
+		uploadBuffer->Unmap(0, nullptr);
+
+		// Same one-off upload as createVertexBuffer, on the current back buffer's list.
+		auto commandAllocator = m_dxCommandAllocators[m_dxCurrentBackBufferIndex];
+		auto commandList = m_dxCommandLists[m_dxCurrentBackBufferIndex];
+		waitForFenceValue(m_dxFrameFenceValues[m_dxCurrentBackBufferIndex]);
+		CHECK_DX(commandAllocator->Reset());
+		CHECK_DX(commandList->Reset(commandAllocator.Get(), nullptr));
+
+		ID3D12Resource* buffer = getBuffer(handle);
+		const auto barrierBeforeCopy = CD3DX12_RESOURCE_BARRIER::Transition(
+			buffer, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+		commandList->ResourceBarrier(1, &barrierBeforeCopy);
+		commandList->CopyBufferRegion(buffer, 0, uploadBuffer, 0, desc.size);
+		const auto barrierAfterCopy = CD3DX12_RESOURCE_BARRIER::Transition(
+			buffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COMMON);
+		commandList->ResourceBarrier(1, &barrierAfterCopy);
+		CHECK_DX(commandList->Close());
+
+		ID3D12CommandList* const commandLists[] = { commandList.Get() };
+		m_dxCommandQueue->ExecuteCommandLists((UINT)std::size(commandLists), commandLists);
+		m_dxFrameFenceValues[m_dxCurrentBackBufferIndex] = signalFence();
+
+		destroyBuffer(upload);
+		return handle;
+	}
+
+	void* Direct3D12Renderer::getMappedData(BufferHandle buffer) {
+		DirectXBuffer* dxBuffer = m_dxBuffers.get(buffer);
+		return dxBuffer ? dxBuffer->mapped : nullptr;
 	}
 
 	void Direct3D12Renderer::resizeWindow() {
-		flush();
+		// Minimized: nothing to size the back buffers to, so the resize waits
+		// for the first draw() after the app sees the window restored.
+		int width = 0, height = 0;
+		SDL_GetWindowSizeInPixels(m_window, &width, &height);
+		if (width == 0 || height == 0) {
+			m_windowResized = true;
+			return;
+		}
+
+		// ResizeBuffers requires the GPU to be done with every back buffer, and
+		// every frame in flight renders to one, so this is a full flush: it
+		// waits for everything submitted so far. Nothing sized to the window
+		// can still be in use after it, so it is all released right away.
+		waitForFenceValue(m_dxFenceValue);
 
 		for (int i = 0; i < m_dxNumFrames; ++i) {
 			m_dxBackBuffers[i].Reset();
 		}
 
+		// RTV and DSV heaps are CPU-only; command lists copied their descriptors at record time.
 		m_dxRTVDescriptorHeap.Reset();
+		m_dxDepthStencilBuffer.Reset();
 
-		SDL_GetWindowSizeInPixels(m_window, &m_windowWidth, &m_windowHeight);
-
-		while (SDL_GetWindowFlags(m_window) & SDL_WINDOW_MINIMIZED) {
-			SDL_WaitEvent(&m_event);
-		}
+		m_windowWidth = width;
+		m_windowHeight = height;
 
 		DXGI_SWAP_CHAIN_DESC swapChainDesc{};
 		CHECK_DX(m_dxSwapChain->GetDesc(&swapChainDesc));
@@ -277,19 +393,12 @@ namespace Nashi {
 		size_t bufferSize = sizeof(m_vertices[0]) * sizeof(Vertex);
 
 		// Create default heap (GPU local)
-		const CD3DX12_HEAP_PROPERTIES defaultHeapProps{ D3D12_HEAP_TYPE_DEFAULT };
-		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-
-		CHECK_DX(m_dxDevice->CreateCommittedResource(
-			&defaultHeapProps,
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_COMMON,
-			nullptr,
-			IID_PPV_ARGS(&m_dxVertexBuffer)));
+		m_dxVertexBuffer = createBuffer(D3D12_HEAP_TYPE_DEFAULT, bufferSize, D3D12_RESOURCE_STATE_COMMON);
+		ID3D12Resource* vertexBuffer = getBuffer(m_dxVertexBuffer);
 
 		// Create upload heap
 		const CD3DX12_HEAP_PROPERTIES uploadHeapProps{ D3D12_HEAP_TYPE_UPLOAD };
+		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
 		CHECK_DX(m_dxDevice->CreateCommittedResource(
 			&uploadHeapProps,
 			D3D12_HEAP_FLAG_NONE,
@@ -312,17 +421,17 @@ namespace Nashi {
 
 		// Transition from COMMON to COPY_DEST before copy
 		const auto barrierBeforeCopy = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_dxVertexBuffer.Get(),
+			vertexBuffer,
 			D3D12_RESOURCE_STATE_COMMON,
 			D3D12_RESOURCE_STATE_COPY_DEST);
 		m_dxCommandLists[m_dxCurrentBackBufferIndex]->ResourceBarrier(1, &barrierBeforeCopy);
 
 		// Copy data from upload heap to default heap
-		m_dxCommandLists[m_dxCurrentBackBufferIndex]->CopyResource(m_dxVertexBuffer.Get(), vertexBufferUpload.Get());
+		m_dxCommandLists[m_dxCurrentBackBufferIndex]->CopyResource(vertexBuffer, vertexBufferUpload.Get());
 
 		// Transition vertex buffer to VERTEX_AND_CONSTANT_BUFFER for use in IA stage
 		const auto barrierAfterCopy = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_dxVertexBuffer.Get(),
+			vertexBuffer,
 			D3D12_RESOURCE_STATE_COPY_DEST,
 			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 		m_dxCommandLists[m_dxCurrentBackBufferIndex]->ResourceBarrier(1, &barrierAfterCopy);
@@ -335,10 +444,10 @@ namespace Nashi {
 
 		// Wait for GPU to finish copying
 		m_dxFrameFenceValues[m_dxCurrentBackBufferIndex] = signalFence();
-		waitForFenceValue();
+		waitForFenceValue(m_dxFrameFenceValues[m_dxCurrentBackBufferIndex]);
 
 		// Setup vertex buffer view for IA stage
-		m_dxVertexBufferView.BufferLocation = m_dxVertexBuffer->GetGPUVirtualAddress();
+		m_dxVertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
 		m_dxVertexBufferView.SizeInBytes = static_cast<UINT>(bufferSize);
 		m_dxVertexBufferView.StrideInBytes = sizeof(Vertex);
 	}
@@ -346,56 +455,50 @@ namespace Nashi {
 	void Direct3D12Renderer::createIndexBuffer() {
 		const UINT indexBufferSize = static_cast<UINT>(m_indices.size() * sizeof(uint16_t));
 
-		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize);
-
-		CHECK_DX(m_dxDevice->CreateCommittedResource(
-			&heapProps,
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_dxIndexBuffer)
-		));
+		m_dxIndexBuffer = createBuffer(D3D12_HEAP_TYPE_UPLOAD, indexBufferSize, D3D12_RESOURCE_STATE_GENERIC_READ);
+		ID3D12Resource* indexBuffer = getBuffer(m_dxIndexBuffer);
 
 		uint16_t* indexData = nullptr;
 		CD3DX12_RANGE readRange{ 0, 0 };
 
-		CHECK_DX(m_dxIndexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&indexData)));
+		CHECK_DX(indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&indexData)));
 		memcpy(indexData, m_indices.data(), indexBufferSize);
-		m_dxIndexBuffer->Unmap(0, nullptr);
+		indexBuffer->Unmap(0, nullptr);
 
-		m_dxIndexBufferView.BufferLocation = m_dxIndexBuffer->GetGPUVirtualAddress();
+		m_dxIndexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
 		m_dxIndexBufferView.SizeInBytes = indexBufferSize;
 		m_dxIndexBufferView.Format = DXGI_FORMAT_R16_UINT;
 	}
 
 	void Direct3D12Renderer::createConstantBuffer() {
-		const UINT constantBufferSize = (sizeof(UniformBufferObject) + 255) & ~255;
-
-		auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(constantBufferSize);
+		// One slice per back buffer so the CPU never writes a slice the GPU
+		// may still be reading for a queued frame.
+		m_dxConstantBufferStride = (sizeof(UniformBufferObject) + 255) & ~255;
 
-		CHECK_DX(m_dxDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
-			&bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, 
-			nullptr, IID_PPV_ARGS(&m_dxConstantBuffer)));
+		m_dxConstantBuffer = createBuffer(D3D12_HEAP_TYPE_UPLOAD, m_dxConstantBufferStride * m_dxNumFrames, D3D12_RESOURCE_STATE_GENERIC_READ);
+		ID3D12Resource* constantBuffer = getBuffer(m_dxConstantBuffer);
 
 		CD3DX12_RANGE readRange{ 0, 0 };
 
-		CHECK_DX(m_dxConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_dxUbo)));
+		CHECK_DX(constantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_dxConstantBufferMapped)));
 
 		D3D12_DESCRIPTOR_HEAP_DESC heapDesc{};
-		heapDesc.NumDescriptors = 1;
+		heapDesc.NumDescriptors = m_dxNumFrames;
 		heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 		heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
 		CHECK_DX(m_dxDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_dxConstantBufferHeap)));
 
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc{};
-		cbvDesc.BufferLocation = m_dxConstantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = constantBufferSize;
+		m_dxCBVDescriptorSize = m_dxDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		CD3DX12_CPU_DESCRIPTOR_HANDLE cbvHandle(m_dxConstantBufferHeap->GetCPUDescriptorHandleForHeapStart());
+		for (int i = 0; i < m_dxNumFrames; ++i) {
+			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc{};
+			cbvDesc.BufferLocation = constantBuffer->GetGPUVirtualAddress() + i * m_dxConstantBufferStride;
+			cbvDesc.SizeInBytes = m_dxConstantBufferStride;
 
-		m_dxDevice->CreateConstantBufferView(&cbvDesc, m_dxConstantBufferHeap->GetCPUDescriptorHandleForHeapStart());
+			m_dxDevice->CreateConstantBufferView(&cbvDesc, cbvHandle);
+			cbvHandle.Offset(1, m_dxCBVDescriptorSize);
+		}
 	}
 
 	void Direct3D12Renderer::updateUniformBufferObject() {
@@ -413,20 +516,89 @@ namespace Nashi {
 		const auto aspectRatio = float(m_windowWidth) / float(m_windowHeight);
 		const auto projMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.0f), aspectRatio, 0.1f, 10.0f);
 
-		m_dxUbo->model = modelMatrix;
-		m_dxUbo->view = viewMatrix;
-		m_dxUbo->proj = projMatrix;
+		auto* ubo = reinterpret_cast<UniformBufferObject*>(
+			m_dxConstantBufferMapped + m_dxCurrentBackBufferIndex * m_dxConstantBufferStride);
+		ubo->model = modelMatrix;
+		ubo->view = viewMatrix;
+		ubo->proj = projMatrix;
 	}
 
-	void Direct3D12Renderer::createRootSignature() {
-		CD3DX12_DESCRIPTOR_RANGE cbvRange;
-		cbvRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
+	static D3D12_DESCRIPTOR_RANGE_TYPE toDxRangeType(ReflectedDescriptorType type) {
+		switch (type) {
+		case ReflectedDescriptorType::UniformBuffer: return D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+		case ReflectedDescriptorType::StorageBuffer: return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		case ReflectedDescriptorType::ReadOnlyStorageBuffer: return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+		case ReflectedDescriptorType::StorageImage: return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		case ReflectedDescriptorType::Sampler: return D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+		default: return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+		}
+	}
+
+	static D3D12_SHADER_VISIBILITY toDxVisibility(uint32_t stageMask) {
+		switch (stageMask) {
+		case SHADER_STAGE_VERTEX: return D3D12_SHADER_VISIBILITY_VERTEX;
+		case SHADER_STAGE_FRAGMENT: return D3D12_SHADER_VISIBILITY_PIXEL;
+		default: return D3D12_SHADER_VISIBILITY_ALL;
+		}
+	}
+
+	static DXGI_FORMAT toDxgiFormat(ReflectedFormat format) {
+		switch (format) {
+		case ReflectedFormat::Float1: return DXGI_FORMAT_R32_FLOAT;
+		case ReflectedFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+		case ReflectedFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+		case ReflectedFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case ReflectedFormat::Int1: return DXGI_FORMAT_R32_SINT;
+		case ReflectedFormat::Int2: return DXGI_FORMAT_R32G32_SINT;
+		case ReflectedFormat::Int3: return DXGI_FORMAT_R32G32B32_SINT;
+		case ReflectedFormat::Int4: return DXGI_FORMAT_R32G32B32A32_SINT;
+		case ReflectedFormat::UInt1: return DXGI_FORMAT_R32_UINT;
+		case ReflectedFormat::UInt2: return DXGI_FORMAT_R32G32_UINT;
+		case ReflectedFormat::UInt3: return DXGI_FORMAT_R32G32B32_UINT;
+		case ReflectedFormat::UInt4: return DXGI_FORMAT_R32G32B32A32_UINT;
+		default: throw std::runtime_error("unsupported vertex input format");
+		}
+	}
+
+	// Push constants become root constants at b0 of their own register space,
+	// clear of every descriptor set; shaders declare them there outside SPIR-V.
+	static constexpr UINT ROOT_CONSTANTS_REGISTER_SPACE = 8;
+
+	// One descriptor table per reflected binding, in binding order, so root
+	// parameter N always matches the Nth binding of the merged reflection.
+	// Bindings map 1:1 to registers: set is the register space.
+	ComPtr<ID3D12RootSignature> Direct3D12Renderer::getRootSignature(const ShaderReflection& reflection) {
+		std::vector<uint32_t> key;
+		for (const auto& binding : reflection.bindings) {
+			key.insert(key.end(), { binding.set, binding.binding, static_cast<uint32_t>(binding.type), binding.count, binding.stageMask });
+		}
+		for (const auto& pushConstant : reflection.pushConstants) {
+			key.insert(key.end(), { pushConstant.offset, pushConstant.size, pushConstant.stageMask });
+		}
+
+		auto cached = m_dxRootSignatureCache.find(key);
+		if (cached != m_dxRootSignatureCache.end()) {
+			return cached->second;
+		}
 
-		CD3DX12_ROOT_PARAMETER rootParameters[1];
-		rootParameters[0].InitAsDescriptorTable(1, &cbvRange, D3D12_SHADER_VISIBILITY_VERTEX);
+		std::vector<CD3DX12_DESCRIPTOR_RANGE> ranges(reflection.bindings.size());
+		std::vector<CD3DX12_ROOT_PARAMETER> rootParameters;
+		for (size_t i = 0; i < reflection.bindings.size(); i++) {
+			const auto& binding = reflection.bindings[i];
+			ranges[i].Init(toDxRangeType(binding.type), binding.count ? binding.count : UINT_MAX, binding.binding, binding.set);
+
+			CD3DX12_ROOT_PARAMETER parameter;
+			parameter.InitAsDescriptorTable(1, &ranges[i], toDxVisibility(binding.stageMask));
+			rootParameters.push_back(parameter);
+		}
+		for (const auto& pushConstant : reflection.pushConstants) {
+			CD3DX12_ROOT_PARAMETER parameter;
+			parameter.InitAsConstants(pushConstant.size / 4, 0, ROOT_CONSTANTS_REGISTER_SPACE, toDxVisibility(pushConstant.stageMask));
+			rootParameters.push_back(parameter);
+		}
 
 		CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-		rootSignatureDesc.Init((UINT)std::size(rootParameters), rootParameters,
+		rootSignatureDesc.Init((UINT)rootParameters.size(), rootParameters.data(),
 			0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 		ComPtr<ID3DBlob> signatureBlob;
@@ -440,28 +612,49 @@ namespace Nashi {
 			}
 			CHECK_DX(hr);
 		}
-		CHECK_DX(m_dxDevice->CreateRootSignature(0, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_dxRootSignature)));
+		ComPtr<ID3D12RootSignature> rootSignature;
+		CHECK_DX(m_dxDevice->CreateRootSignature(0, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
 
+		m_dxRootSignatureCache.emplace(std::move(key), rootSignature);
+		return rootSignature;
 	}
 
-	void Direct3D12Renderer::createGraphicsPipeline() {
-		const D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	void Direct3D12Renderer::createRootSignature() {
+		m_basicReflection = loadShaderReflection(m_shaderLibrary, "basic.vert");
+		m_basicReflection.merge(loadShaderReflection(m_shaderLibrary, "basic.frag"));
 
-		};
+		m_dxRootSignature = getRootSignature(m_basicReflection);
+	}
 
-		ComPtr<ID3DBlob> vertexShaderBlob;
-		CHECK_DX(D3DReadFileToBlob(L"shaders/basic.vert.cso", &vertexShaderBlob));
+	ComPtr<ID3D12PipelineState> Direct3D12Renderer::createGraphicsPipeline(uint32_t variantKey) {
+		// Semantics arrive as written in HLSL ("TEXCOORD1"); D3D wants the
+		// trailing digits as a separate semantic index.
+		std::vector<uint32_t> offsets;
+		m_basicReflection.vertexLayout(offsets);
+
+		std::vector<std::string> semanticNames;
+		std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
+		semanticNames.reserve(m_basicReflection.vertexInputs.size());
+		for (size_t i = 0; i < m_basicReflection.vertexInputs.size(); i++) {
+			const auto& input = m_basicReflection.vertexInputs[i];
+			std::string semantic = input.semantic;
+			size_t digits = semantic.find_last_not_of("0123456789") + 1;
+			UINT semanticIndex = digits < semantic.size() ? (UINT)std::stoul(semantic.substr(digits)) : 0;
+			semanticNames.push_back(semantic.substr(0, digits));
+
+			inputLayout.push_back({ semanticNames.back().c_str(), semanticIndex, toDxgiFormat(input.format), 0,
+				offsets[i], D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		}
 
-		ComPtr<ID3DBlob> pixelShaderBlob;
-		CHECK_DX(D3DReadFileToBlob(L"shaders/basic.frag.cso", &pixelShaderBlob));
+		std::vector<char> vertexShaderFile, pixelShaderFile;
+		ShaderBlob vertexShader = loadShaderBlob(m_shaderLibrary, "basic.vert.cso", vertexShaderFile);
+		ShaderBlob pixelShader = loadShaderBlob(m_shaderLibrary, shaderVariantName("basic.frag", variantKey, ".cso"), pixelShaderFile);
 
 		m_dxPipelineStateStream.RootSignature = m_dxRootSignature.Get();
-		m_dxPipelineStateStream.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+		m_dxPipelineStateStream.InputLayout = { inputLayout.data(), (UINT)inputLayout.size() };
 		m_dxPipelineStateStream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		m_dxPipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(vertexShaderBlob.Get());
-		m_dxPipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(pixelShaderBlob.Get());
+		m_dxPipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(vertexShader.data, vertexShader.size);
+		m_dxPipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(pixelShader.data, pixelShader.size);
 		m_dxPipelineStateStream.RTVFormats = {
 			.RTFormats{ DXGI_FORMAT_B8G8R8A8_UNORM  },
 			.NumRenderTargets = 1,
@@ -487,7 +680,180 @@ namespace Nashi {
 			sizeof(PipelineStateStream), &m_dxPipelineStateStream
 		};
 
-		CHECK_DX(m_dxDevice->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_dxPipelineState)));
+		ComPtr<ID3D12PipelineState> pipelineState;
+		CHECK_DX(m_dxDevice->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&pipelineState)));
+		return pipelineState;
+	}
+
+	PipelineHandle Direct3D12Renderer::basicPipeline(uint32_t variantKey) {
+		auto cached = m_dxPipelineStates.find(variantKey);
+		if (cached != m_dxPipelineStates.end()) {
+			return cached->second;
+		}
+
+		std::vector<uint32_t> offsets;
+		DirectXPipeline pipeline;
+		pipeline.pipelineState = createGraphicsPipeline(variantKey);
+		pipeline.rootSignature = m_dxRootSignature;
+		pipeline.vertexStride = m_basicReflection.vertexLayout(offsets);
+		if (!m_basicReflection.pushConstants.empty()) {
+			pipeline.constantsRootIndex = (UINT)m_basicReflection.bindings.size();
+			pipeline.constantsCount = m_basicReflection.pushConstants.front().size / 4;
+		}
+		pipeline.bindsFrameConstants = !m_basicReflection.bindings.empty();
+
+		PipelineHandle handle = m_dxPipelines.create(std::move(pipeline));
+		m_dxPipelineStates.emplace(variantKey, handle);
+		return handle;
+	}
+
+	ComPtr<ID3D12PipelineState> Direct3D12Renderer::getPipelineState(uint32_t variantKey) {
+		return m_dxPipelines.get(basicPipeline(variantKey))->pipelineState;
+	}
+
+	void Direct3D12Renderer::submit(const CommandStream& stream) {
+		m_dxSubmittedStreams.push_back(stream);
+	}
+
+	// Records the submitted streams into the frame's list while the back
+	// buffer is still bound as render target. Default-heap buffers are
+	// transitioned on use and returned to COMMON at the end, so their state
+	// never has to be tracked across frames.
+	// Root constants are undefined until set, and basic.vert reads its
+	// per-draw constants on every draw.
+	void Direct3D12Renderer::zeroRootConstants(ID3D12GraphicsCommandList* commandList, const DirectXPipeline& pipeline) {
+		if (pipeline.constantsRootIndex == UINT_MAX) {
+			return;
+		}
+		const uint32_t zeros[MAX_COMMAND_CONSTANTS_SIZE / 4] = {};
+		commandList->SetGraphicsRoot32BitConstants(pipeline.constantsRootIndex,
+			std::min<UINT>(pipeline.constantsCount, MAX_COMMAND_CONSTANTS_SIZE / 4), zeros, 0);
+	}
+
+	void Direct3D12Renderer::executeCommandStreams(ID3D12GraphicsCommandList* commandList) {
+		using BufferState = std::pair<const uint32_t, D3D12_RESOURCE_STATES>;
+		ScratchScope scratch;
+		std::unordered_map<uint32_t, D3D12_RESOURCE_STATES, std::hash<uint32_t>, std::equal_to<uint32_t>, ArenaAllocator<BufferState>>
+			bufferStates(scratch.allocator<BufferState>());
+		auto transition = [&](BufferHandle handle, D3D12_RESOURCE_STATES state) -> DirectXBuffer* {
+			DirectXBuffer* buffer = m_dxBuffers.get(handle);
+			if (!buffer || buffer->heapType != D3D12_HEAP_TYPE_DEFAULT) {
+				return buffer;
+			}
+			auto [current, inserted] = bufferStates.try_emplace(handle.value, D3D12_RESOURCE_STATE_COMMON);
+			if (current->second != state) {
+				const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(buffer->resource.Get(), current->second, state);
+				commandList->ResourceBarrier(1, &barrier);
+				current->second = state;
+			}
+			return buffer;
+		};
+
+		const DirectXPipeline* pipeline = nullptr;
+		BufferHandle vertexBuffer;
+		uint32_t vertexOffset = 0;
+		bool vertexBufferDirty = false;
+		auto flushVertexBuffer = [&]() {
+			if (!vertexBufferDirty || !pipeline) {
+				return;
+			}
+			if (const DirectXBuffer* buffer = transition(vertexBuffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER)) {
+				D3D12_VERTEX_BUFFER_VIEW view{};
+				view.BufferLocation = buffer->resource->GetGPUVirtualAddress() + vertexOffset;
+				view.SizeInBytes = static_cast<UINT>(buffer->size - vertexOffset);
+				view.StrideInBytes = pipeline->vertexStride;
+				commandList->IASetVertexBuffers(0, 1, &view);
+			}
+			vertexBufferDirty = false;
+		};
+
+		CD3DX12_GPU_DESCRIPTOR_HANDLE cbvHandle(m_dxConstantBufferHeap->GetGPUDescriptorHandleForHeapStart(),
+			m_dxCurrentBackBufferIndex, m_dxCBVDescriptorSize);
+
+		for (const CommandStream& stream : m_dxSubmittedStreams) {
+			for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+				switch (cmd->type) {
+				case CommandType::BindPipeline:
+					pipeline = m_dxPipelines.get(commandAs<CmdBindPipeline>(cmd).pipeline);
+					if (pipeline) {
+						commandList->SetPipelineState(pipeline->pipelineState.Get());
+						commandList->SetGraphicsRootSignature(pipeline->rootSignature.Get());
+						if (pipeline->bindsFrameConstants) {
+							commandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+						}
+						zeroRootConstants(commandList, *pipeline);
+						vertexBufferDirty = vertexBuffer.value != 0;
+					}
+					break;
+				case CommandType::BindVertexBuffer: {
+					const auto& bind = commandAs<CmdBindVertexBuffer>(cmd);
+					vertexBuffer = bind.buffer;
+					vertexOffset = bind.offset;
+					vertexBufferDirty = true;
+					break;
+				}
+				case CommandType::BindIndexBuffer: {
+					const auto& bind = commandAs<CmdBindIndexBuffer>(cmd);
+					if (const DirectXBuffer* buffer = transition(bind.buffer, D3D12_RESOURCE_STATE_INDEX_BUFFER)) {
+						D3D12_INDEX_BUFFER_VIEW view{};
+						view.BufferLocation = buffer->resource->GetGPUVirtualAddress() + bind.offset;
+						view.SizeInBytes = static_cast<UINT>(buffer->size - bind.offset);
+						view.Format = bind.indexType == IndexType::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+						commandList->IASetIndexBuffer(&view);
+					}
+					break;
+				}
+				case CommandType::SetConstants: {
+					const auto& constants = commandAs<CmdSetConstants>(cmd);
+					if (pipeline && pipeline->constantsRootIndex != UINT_MAX) {
+						commandList->SetGraphicsRoot32BitConstants(pipeline->constantsRootIndex,
+							constants.size / 4, constants.data(), constants.offset / 4);
+					}
+					break;
+				}
+				case CommandType::Draw: {
+					const auto& draw = commandAs<CmdDraw>(cmd);
+					flushVertexBuffer();
+					commandList->DrawInstanced(draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+					break;
+				}
+				case CommandType::DrawIndexed: {
+					const auto& draw = commandAs<CmdDrawIndexed>(cmd);
+					flushVertexBuffer();
+					commandList->DrawIndexedInstanced(draw.indexCount, draw.instanceCount, draw.firstIndex,
+						draw.vertexOffset, draw.firstInstance);
+					break;
+				}
+				case CommandType::Dispatch: {
+					const auto& dispatch = commandAs<CmdDispatch>(cmd);
+					commandList->Dispatch(dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+					const auto barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+					commandList->ResourceBarrier(1, &barrier);
+					break;
+				}
+				case CommandType::CopyBuffer: {
+					const auto& copy = commandAs<CmdCopyBuffer>(cmd);
+					const DirectXBuffer* src = transition(copy.src, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					const DirectXBuffer* dst = transition(copy.dst, D3D12_RESOURCE_STATE_COPY_DEST);
+					if (src && dst) {
+						commandList->CopyBufferRegion(dst->resource.Get(), copy.dstOffset, src->resource.Get(), copy.srcOffset, copy.size);
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+		m_dxSubmittedStreams.clear();
+
+		for (const auto& [handle, state] : bufferStates) {
+			if (state != D3D12_RESOURCE_STATE_COMMON) {
+				const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+					m_dxBuffers.get(BufferHandle{ handle })->resource.Get(), state, D3D12_RESOURCE_STATE_COMMON);
+				commandList->ResourceBarrier(1, &barrier);
+			}
+		}
 	}
 
 	void Direct3D12Renderer::createViewport() {
@@ -523,19 +889,31 @@ namespace Nashi {
 		createIndexBuffer();
 		createConstantBuffer();
 
+		m_shaderLibrary.open(std::filesystem::current_path() / "shaders" / SHADER_LIBRARY_FILE_NAME);
+
 		createRootSignature();
-		createGraphicsPipeline();
+		m_dxPipelineState = getPipelineState(m_shaderVariant);
 
 		createViewport();
 	}
 
 	void Direct3D12Renderer::draw() {
 		if (m_windowResized) {
-			resizeWindow();
 			m_windowResized = false;
+			resizeWindow();
 		}
 
+		m_dxPipelineState = getPipelineState(m_shaderVariant);
+
+		const FramePacingPolicy& pacing = m_framePacer.policy();
+		if (!pacing.lateLatchCamera) {
+			m_framePacer.limit();
+		}
+		::WaitForSingleObjectEx(m_dxFrameLatencyWaitable, 1000, TRUE);
+
 		m_dxCurrentBackBufferIndex = m_dxSwapChain->GetCurrentBackBufferIndex();
+		waitForFenceValue(m_dxFrameFenceValues[m_dxCurrentBackBufferIndex]);
+		processDeferredReleases();
 
 		auto commandAllocator = m_dxCommandAllocators[m_dxCurrentBackBufferIndex];
 		auto backBuffer = m_dxBackBuffers[m_dxCurrentBackBufferIndex];
@@ -575,12 +953,19 @@ namespace Nashi {
 
 		ID3D12DescriptorHeap* descriptorHeaps[] = { m_dxConstantBufferHeap.Get() };
 		commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-		updateUniformBufferObject();
+		if (!pacing.lateLatchCamera) {
+			updateUniformBufferObject();
+		}
 
-		commandList->SetGraphicsRootDescriptorTable(0, m_dxConstantBufferHeap->GetGPUDescriptorHandleForHeapStart());
+		CD3DX12_GPU_DESCRIPTOR_HANDLE cbvHandle(m_dxConstantBufferHeap->GetGPUDescriptorHandleForHeapStart(),
+			m_dxCurrentBackBufferIndex, m_dxCBVDescriptorSize);
+		commandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+		zeroRootConstants(commandList, *m_dxPipelines.get(basicPipeline(m_shaderVariant)));
 
 		commandList->DrawIndexedInstanced((UINT)m_indices.size(), 1, 0, 0, 0);
 
+		executeCommandStreams(commandList.Get());
+
 		{
 			const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
 				backBuffer.Get(),
@@ -590,23 +975,55 @@ namespace Nashi {
 
 		CHECK_DX(commandList->Close());
 
+		if (pacing.lateLatchCamera) {
+			m_framePacer.limit();
+			updateUniformBufferObject();
+		}
+
 		ID3D12CommandList* const commandLists[] = {
 			commandList.Get()
 		};
 
 		m_dxCommandQueue->ExecuteCommandLists(std::size(commandLists), commandLists);
 
-		UINT syncInternal = m_dxVsync ? 1 : 0;
-		UINT presentFlags = m_dxTearingSupported && !m_dxVsync ? DXGI_PRESENT_ALLOW_TEARING : 0;
+		// DXGI has no mailbox or relaxed FIFO: flip-model sync interval 0
+		// without tearing lets DWM show the newest frame each vblank, and
+		// relaxed FIFO falls back to plain vsync.
+		bool vsync = pacing.presentMode == PresentMode::Fifo || pacing.presentMode == PresentMode::FifoRelaxed;
+		bool tearing = pacing.presentMode == PresentMode::Immediate && m_dxTearingSupported;
+		UINT syncInternal = vsync ? 1 : 0;
+		UINT presentFlags = tearing ? DXGI_PRESENT_ALLOW_TEARING : 0;
 		CHECK_DX(m_dxSwapChain->Present(syncInternal, presentFlags));
+		m_framePacer.onPresent();
 
 		m_dxFrameFenceValues[m_dxCurrentBackBufferIndex] = signalFence();
-		waitForFenceValue();
+		m_frameArenas.endFrame();
+	}
+
+	LinearArena& Direct3D12Renderer::frameArena() {
+		return m_frameArenas.current();
+	}
+
+	void Direct3D12Renderer::setFramePacing(const FramePacingPolicy& policy) {
+		m_framePacer.setPolicy(policy);
+		if (m_dxSwapChain) {
+			CHECK_DX(m_dxSwapChain->SetMaximumFrameLatency(m_framePacer.policy().frameQueueDepth));
+		}
+	}
 
+	void Direct3D12Renderer::markInput(uint64_t timestampNs) {
+		m_framePacer.markInput(timestampNs);
 	}
 
 	void Direct3D12Renderer::cleanup() {
 		flush();
+		processDeferredReleases();
+		::CloseHandle(m_dxFrameLatencyWaitable);
+		m_dxPipelineStates.clear();
+		m_dxPipelines.clear();
+		m_dxBuffers.clear();
+		m_dxRootSignatureCache.clear();
+		m_shaderLibrary.close();
 	}
 }
 #endif
\ No newline at end of file
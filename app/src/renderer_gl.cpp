@@ -1,6 +1,11 @@
 #ifdef NASHI_USE_OPENGL
 #include <renderer_gl.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <string_view>
 
 namespace Nashi {
 	OpenGLRenderer::OpenGLRenderer(SDL_Window* window, SDL_Event event) {
@@ -10,95 +15,357 @@ namespace Nashi {
 
 	void OpenGLRenderer::resizeWindow() {
 		SDL_GetWindowSizeInPixels(m_window, &m_windowWidth, &m_windowHeight);
-		glViewport(0, 0, m_windowWidth, m_windowHeight);
+		m_glState.viewport(0, 0, m_windowWidth, m_windowHeight);
 
 	}
 
-	unsigned int OpenGLRenderer::createShader(GLenum shaderType, const std::string& filename) {
+	// Continues a 64-bit FNV-1a hash, the same one hashShaderName uses.
+	static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	// Status is not queried here, so compiles overlap; finishProgram()
+	// reports errors once the program has linked. The constants' defines go
+	// right after the #version line, which has to stay first.
+	unsigned int OpenGLRenderer::createShader(GLenum shaderType, const ShaderBlob& source, const GLSpecializationConstants& constants) {
 		unsigned int shader = glCreateShader(shaderType);
-		auto shaderData = readFileText(filename);
-		const char* shaderSource = shaderData.data();
-		glShaderSource(shader, 1, &shaderSource, NULL);
+		const char* text = static_cast<const char*>(source.data);
+		const std::string_view sourceText(text, source.size);
+		const size_t versionEnd = sourceText.starts_with("#version") ? sourceText.find('\n') + 1 : 0;
+
+		const char* strings[] = { text, constants.defines.data(), text + versionEnd };
+		const GLint lengths[] = {
+			static_cast<GLint>(versionEnd),
+			static_cast<GLint>(constants.defines.size()),
+			static_cast<GLint>(source.size - versionEnd),
+		};
+		glShaderSource(shader, 3, strings, lengths);
 		glCompileShader(shader);
+		return shader;
+	}
 
-		int success;
-		char infoLog[512];
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(shader, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" <<
-				infoLog << std::endl;
+	// The SPIR-V is what dxc built for Vulkan; specialization runs the
+	// module's front end, so nothing is parsed from text.
+	unsigned int OpenGLRenderer::createSpirvShader(GLenum shaderType, const ShaderBlob& binary, const GLSpecializationConstants& constants) {
+		unsigned int shader = glCreateShader(shaderType);
+		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, binary.data, static_cast<GLsizei>(binary.size));
+		glSpecializeShader(shader, SHADER_ENTRY_POINT, static_cast<GLuint>(constants.ids.size()),
+			constants.ids.data(), constants.values.data());
+		return shader;
+	}
+
+	// Sets up the program binary cache, parallel compilation and, on GL 4.6
+	// drivers that list the SPIR-V binary format, the SPIR-V path.
+	void OpenGLRenderer::initShaderCompiler() {
+		const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		m_glDriverHash = hashShaderName(std::string(renderer ? renderer : "") + "\n" + (version ? version : ""));
+
+		GLint binaryFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+		m_glProgramCacheDirectory = std::filesystem::current_path() / "cache" / "gl";
+		std::error_code error;
+		std::filesystem::create_directories(m_glProgramCacheDirectory, error);
+		m_glProgramCacheEnabled = binaryFormats > 0 && !error;
+
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; i++) {
+			std::string_view extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension == "GL_KHR_parallel_shader_compile") {
+				m_glMaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+					SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+			}
+			else if (extension == "GL_ARB_parallel_shader_compile" && !m_glMaxShaderCompilerThreads) {
+				m_glMaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+					SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB"));
+			}
+		}
+		// 0xFFFFFFFF lets the driver pick how many threads it compiles on.
+		if (m_glMaxShaderCompilerThreads) {
+			m_glMaxShaderCompilerThreads(0xFFFFFFFF);
 		}
 
-		return shader;
+		GLint shaderBinaryFormatCount = 0;
+		glGetIntegerv(GL_NUM_SHADER_BINARY_FORMATS, &shaderBinaryFormatCount);
+		std::vector<GLint> shaderBinaryFormats(shaderBinaryFormatCount);
+		if (shaderBinaryFormatCount > 0) {
+			glGetIntegerv(GL_SHADER_BINARY_FORMATS, shaderBinaryFormats.data());
+		}
+		m_glSpirvEnabled = GLAD_GL_VERSION_4_6 && glSpecializeShader &&
+			std::find(shaderBinaryFormats.begin(), shaderBinaryFormats.end(), GL_SHADER_BINARY_FORMAT_SPIR_V) != shaderBinaryFormats.end();
 	}
 
-	void OpenGLRenderer::createShaderProgram() {
-		m_glShaderProgram = glCreateProgram();
-		glAttachShader(m_glShaderProgram, m_glVertexShader);
-		glAttachShader(m_glShaderProgram, m_glFragmentShader);
-		glLinkProgram(m_glShaderProgram);
+	// A binary the driver rejects (after a driver update the strings usually
+	// change first, but not always) is deleted and the program left unlinked.
+	bool OpenGLRenderer::loadProgramBinary(unsigned int program, uint64_t cacheKey) {
+		if (!m_glProgramCacheEnabled) {
+			return false;
+		}
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(cacheKey));
+		const std::filesystem::path path = m_glProgramCacheDirectory / fileName;
 
-		int success;
-		char infoLog[512];
-		glGetProgramiv(m_glShaderProgram, GL_LINK_STATUS, &success);
-		if (!success) {
-			glGetProgramInfoLog(m_glShaderProgram, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADERPROGRAM::CREATION_FAILED\n" <<
-				infoLog << std::endl;
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::vector<char> contents(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(contents.data(), contents.size());
+		file.close();
+
+		GLProgramBinaryHeader header{};
+		if (contents.size() > sizeof(header)) {
+			memcpy(&header, contents.data(), sizeof(header));
+		}
+		if (header.magic == GL_PROGRAM_BINARY_MAGIC && header.cacheKey == cacheKey) {
+			glProgramBinary(program, header.format, contents.data() + sizeof(header),
+				static_cast<GLsizei>(contents.size() - sizeof(header)));
+			int success;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			if (success) {
+				return true;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return false;
+	}
+
+	// Written to a temporary name first so a concurrent launch never reads
+	// half a binary.
+	void OpenGLRenderer::saveProgramBinary(unsigned int program, uint64_t cacheKey) {
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!m_glProgramCacheEnabled || length <= 0) {
+			return;
+		}
+
+		std::vector<char> contents(sizeof(GLProgramBinaryHeader) + length);
+		GLProgramBinaryHeader header{ GL_PROGRAM_BINARY_MAGIC, 0, cacheKey };
+		GLenum format = 0;
+		glGetProgramBinary(program, length, nullptr, &format, contents.data() + sizeof(header));
+		header.format = format;
+		memcpy(contents.data(), &header, sizeof(header));
+
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(cacheKey));
+		const std::filesystem::path path = m_glProgramCacheDirectory / fileName;
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(contents.data(), contents.size());
+		file.close();
+		std::error_code error;
+		if (file) {
+			std::filesystem::rename(temporaryPath, path, error);
+		}
+		else {
+			std::filesystem::remove(temporaryPath, error);
 		}
 	}
 
-	void OpenGLRenderer::deleteShaders() {
-		glDeleteShader(m_glVertexShader);
-		glDeleteShader(m_glFragmentShader);
+	// Loads the program from the binary cache, or starts compiling and
+	// linking it without waiting for either.
+	GLProgramBuild OpenGLRenderer::beginBasicProgram(uint32_t variantKey) {
+		GLProgramBuild build;
+		build.variantKey = variantKey;
+		build.spirv = m_glSpirvEnabled;
+
+		const std::string extension = build.spirv ? ".spv" : ".glsl";
+		std::vector<char> vertexFile;
+		std::vector<char> fragmentFile;
+		ShaderBlob vertexSource = loadShaderBlob(m_shaderLibrary, "basic.vert" + extension, vertexFile);
+		ShaderBlob fragmentSource = loadShaderBlob(m_shaderLibrary, shaderVariantName("basic.frag", variantKey, extension), fragmentFile);
+
+		const GLSpecializationConstants vertexConstants;
+		GLSpecializationConstants fragmentConstants;
+		fragmentConstants.set(0, m_colorIntensity);
+
+		build.cacheKey = hashBytes(hashBytes(m_glDriverHash, vertexSource.data, vertexSource.size),
+			fragmentSource.data, fragmentSource.size);
+		build.cacheKey = hashBytes(build.cacheKey, fragmentConstants.values.data(), fragmentConstants.values.size() * sizeof(GLuint));
+		build.program = glCreateProgram();
+		if (loadProgramBinary(build.program, build.cacheKey)) {
+			return build;
+		}
+
+		if (build.spirv) {
+			build.vertexShader = createSpirvShader(GL_VERTEX_SHADER, vertexSource, vertexConstants);
+			build.fragmentShader = createSpirvShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentConstants);
+		}
+		else {
+			build.vertexShader = createShader(GL_VERTEX_SHADER, vertexSource, vertexConstants);
+			build.fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentConstants);
+		}
+		glAttachShader(build.program, build.vertexShader);
+		glAttachShader(build.program, build.fragmentShader);
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(build.program);
+		return build;
 	}
 
-	void OpenGLRenderer::createVertexInputState() {
-		glGenVertexArrays(1, &m_glVAO);
-		glBindVertexArray(m_glVAO);
+	// Without KHR_parallel_shader_compile every build counts as done, and
+	// finishing it blocks until the driver has linked it.
+	bool OpenGLRenderer::isProgramBuildDone(const GLProgramBuild& build) {
+		if (!build.vertexShader || !m_glMaxShaderCompilerThreads) {
+			return true;
+		}
+		int done;
+		glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+		return done != 0;
 	}
 
-	void OpenGLRenderer::createBuffers() {
-		createVertexBuffer();
-		createIndexBuffer();
+	// Returns the linked program, or 0 after logging why it failed; a failed
+	// SPIR-V program is rebuilt from GLSL first. Newly linked programs go to
+	// the binary cache.
+	unsigned int OpenGLRenderer::finishProgram(const GLProgramBuild& build) {
+		if (!build.vertexShader) {
+			return build.program;
+		}
+
+		int success;
+		glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			for (unsigned int shader : { build.vertexShader, build.fragmentShader }) {
+				glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+				if (!success) {
+					glGetShaderInfoLog(shader, 512, NULL, infoLog);
+					std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" <<
+						infoLog << std::endl;
+				}
+			}
+			glGetProgramInfoLog(build.program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADERPROGRAM::CREATION_FAILED\n" <<
+				infoLog << std::endl;
+		}
+
+		glDeleteShader(build.vertexShader);
+		glDeleteShader(build.fragmentShader);
+		if (!success) {
+			glDeleteProgram(build.program);
+			if (build.spirv) {
+				std::cout << "SPIR-V program failed, falling back to GLSL" << std::endl;
+				m_glSpirvEnabled = false;
+				return finishProgram(beginBasicProgram(build.variantKey));
+			}
+			return 0;
+		}
+		saveProgramBinary(build.program, build.cacheKey);
+		return build.program;
 	}
-	
-	void OpenGLRenderer::createVertexBuffer() {
-		glGenBuffers(1, &m_glVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_glVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), m_vertices.data(), GL_STATIC_DRAW);
+
+	// Moves prewarmed programs into the pipeline pool; with wait, all of
+	// them, otherwise only those the driver has finished.
+	void OpenGLRenderer::collectProgramBuilds(bool wait) {
+		for (auto it = m_glProgramBuilds.begin(); it != m_glProgramBuilds.end();) {
+			if (!wait && !isProgramBuildDone(it->second)) {
+				++it;
+				continue;
+			}
+			if (unsigned int program = finishProgram(it->second)) {
+				addBasicPipeline(it->first, program);
+			}
+			it = m_glProgramBuilds.erase(it);
+		}
 	}
 
-	void OpenGLRenderer::createIndexBuffer() {
-		glGenBuffers(1, &m_glEBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_glEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+	// Vertices and indices share one immutable buffer, which the scene VAO
+	// uses for both its vertex and its element buffer.
+	void OpenGLRenderer::createSceneGeometry() {
+		const GLsizeiptr vertexSize = static_cast<GLsizeiptr>(m_vertices.size() * sizeof(float));
+		const GLsizeiptr indexSize = static_cast<GLsizeiptr>(m_indices.size() * sizeof(unsigned int));
+		m_glSceneIndexOffset = vertexSize;
+
+		std::vector<uint8_t> geometry(vertexSize + indexSize);
+		memcpy(geometry.data(), m_vertices.data(), vertexSize);
+		memcpy(geometry.data() + m_glSceneIndexOffset, m_indices.data(), indexSize);
+
+		glCreateBuffers(1, &m_glSceneBuffer);
+		glNamedBufferStorage(m_glSceneBuffer, vertexSize + indexSize, geometry.data(), 0);
+		m_glFrameStats.allocations++;
+		m_glFrameStats.bytesUploaded += vertexSize + indexSize;
+
+		glCreateVertexArrays(1, &m_glVAO);
+		setVertexFormat(m_glVAO);
+		glVertexArrayVertexBuffer(m_glVAO, GL_VERTEX_BUFFER_BINDING, m_glSceneBuffer, 0, m_glVertexStride);
+		glVertexArrayElementBuffer(m_glVAO, m_glSceneBuffer);
 	}
 
-	void OpenGLRenderer::createUniformBuffer() {
-		glGenBuffers(1, &m_glUBO);
-		glBindBuffer(GL_UNIFORM_BUFFER, m_glUBO);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 3, nullptr, GL_STATIC_DRAW);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	void OpenGLRenderer::createStreamBuffer() {
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_glUniformAlignment);
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_glStorageAlignment);
 
-		glBindBufferBase(GL_UNIFORM_BUFFER, m_glUBOBindingPoint, m_glUBO);	
+		BufferDesc desc{};
+		desc.size = GL_STREAM_REGION_SIZE * MAX_FRAME_QUEUE_DEPTH;
+		desc.usage = BUFFER_USAGE_VERTEX | BUFFER_USAGE_INDEX | BUFFER_USAGE_UNIFORM | BUFFER_USAGE_STORAGE | BUFFER_USAGE_INDIRECT;
+		desc.hostVisible = true;
+		m_glStreamBuffer = createBuffer(desc);
 	}
 
-	void OpenGLRenderer::createVertexAttributes() {
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3*sizeof(float)));
-		glEnableVertexAttribArray(1);
+	// The format is fixed per VAO; binding a vertex buffer afterwards only
+	// swaps the buffer and offset of GL_VERTEX_BUFFER_BINDING.
+	void OpenGLRenderer::setVertexFormat(unsigned int vao) {
+		std::vector<uint32_t> offsets;
+		m_glVertexStride = static_cast<GLsizei>(m_basicReflection.vertexLayout(offsets));
+
+		for (size_t i = 0; i < m_basicReflection.vertexInputs.size(); i++) {
+			const auto& input = m_basicReflection.vertexInputs[i];
+			GLint components = static_cast<GLint>(reflectedFormatComponents(input.format));
+
+			if (input.format >= ReflectedFormat::Int1 && input.format <= ReflectedFormat::Int4) {
+				glVertexArrayAttribIFormat(vao, input.location, components, GL_INT, offsets[i]);
+			}
+			else if (input.format >= ReflectedFormat::UInt1) {
+				glVertexArrayAttribIFormat(vao, input.location, components, GL_UNSIGNED_INT, offsets[i]);
+			}
+			else {
+				glVertexArrayAttribFormat(vao, input.location, components, GL_FLOAT, GL_FALSE, offsets[i]);
+			}
+			glVertexArrayAttribBinding(vao, input.location, GL_VERTEX_BUFFER_BINDING);
+			glEnableVertexArrayAttrib(vao, input.location);
+		}
 	}
 
-	void OpenGLRenderer::init() {
+	void OpenGLRenderer::createContext() {
 		m_glContext = SDL_GL_CreateContext(m_window);
 		if (!m_glContext) {
 			std::cout << "Failed to create GL context: " << SDL_GetError() << std::endl;
 			return;
 		}
+		// Creating it made it current here; init() takes it to its own thread.
+		SDL_GL_MakeCurrent(m_window, nullptr);
+		m_glContextExternal = true;
+	}
+
+	void OpenGLRenderer::destroyContext() {
+		if (m_glContext) {
+			SDL_GL_DestroyContext(m_glContext);
+			m_glContext = nullptr;
+		}
+	}
+
+	void OpenGLRenderer::init() {
+		if (!m_glContextExternal) {
+			m_glContext = SDL_GL_CreateContext(m_window);
+			if (!m_glContext) {
+				std::cout << "Failed to create GL context: " << SDL_GetError() << std::endl;
+				return;
+			}
+		}
+		else if (!m_glContext || !SDL_GL_MakeCurrent(m_window, m_glContext)) {
+			std::cout << "Failed to make GL context current: " << SDL_GetError() << std::endl;
+			return;
+		}
 
 		if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
 			std::cout << "Failed to initialize GLAD" << std::endl;
@@ -106,45 +373,514 @@ namespace Nashi {
 
 		}
 		resizeWindow();
+		applySwapInterval();
 
-		glEnable(GL_DEPTH_TEST);
-	
-		std::filesystem::path vertShaderPath = std::filesystem::current_path() / "shaders" / "basic.vert.glsl";
-		std::filesystem::path fragShaderPath = std::filesystem::current_path() / "shaders" / "basic.frag.glsl";
-		m_glVertexShader = createShader(GL_VERTEX_SHADER, vertShaderPath.string());
-		m_glFragmentShader = createShader(GL_FRAGMENT_SHADER, fragShaderPath.string());
+		m_glState.setEnabled(GL_DEPTH_TEST, true);
 
-		createShaderProgram();
-		deleteShaders();
+		m_shaderLibrary.open(std::filesystem::current_path() / "shaders" / SHADER_LIBRARY_FILE_NAME);
+		m_basicReflection = loadShaderReflection(m_shaderLibrary, "basic.vert");
+		m_basicReflection.merge(loadShaderReflection(m_shaderLibrary, "basic.frag"));
+		// Reflected from the push constant build; the GL build reads the
+		// same block from storage.
+		for (const auto& pushConstant : m_basicReflection.pushConstants) {
+			m_glDrawConstantsSize = std::max<GLsizeiptr>(m_glDrawConstantsSize, pushConstant.offset + pushConstant.size);
+		}
+		m_glDrawConstantsSize = std::min<GLsizeiptr>(m_glDrawConstantsSize, MAX_COMMAND_CONSTANTS_SIZE);
+
+		initShaderCompiler();
+		// Every program init knows about is in flight before it waits on
+		// the first one, the scene's.
+		GLProgramBuild sceneBuild = beginBasicProgram(m_shaderVariant);
+		for (uint32_t variantKey : GL_PREWARM_VARIANTS) {
+			m_glProgramBuilds.emplace(variantKey, beginBasicProgram(variantKey));
+		}
+		m_glShaderProgram = finishProgram(sceneBuild);
+		m_glShaderProgramVariant = m_shaderVariant;
 
-		createVertexInputState();
-		createBuffers();
-		createVertexAttributes();
+		createSceneGeometry();
+		createStreamBuffer();
 
-		createUniformBuffer();
+		glCreateVertexArrays(1, &m_glStreamVAO);
+		setVertexFormat(m_glStreamVAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		// Core since 4.6; the loader does not list ARB_pipeline_statistics_query.
+		m_glPipelineStatisticsSupported = GLAD_GL_VERSION_4_6;
+		if (m_glPipelineStatisticsSupported) {
+			for (size_t i = 0; i < GL_STATISTICS_TARGET_COUNT; i++) {
+				glCreateQueries(GL_STATISTICS_TARGETS[i], MAX_FRAME_QUEUE_DEPTH, m_glStatisticsQueries[i]);
+			}
+		}
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+		m_shaderWatcher = std::make_unique<ShaderWatcher>(NASHI_SHADER_SOURCE_DIR,
+			std::filesystem::current_path() / "shaders", ShaderTarget::GLSL);
+		m_shaderWatcher->start();
+#endif
 	}
-	
+
+	// Returns 0 if the program failed to link.
+	unsigned int OpenGLRenderer::linkBasicProgram(uint32_t variantKey) {
+		return finishProgram(beginBasicProgram(variantKey));
+	}
+
+	// GL orders the delete after every command that still uses the old
+	// program, so the swap is safe without waiting on the GPU.
+	bool OpenGLRenderer::rebuildShaderProgram(uint32_t variantKey) {
+		unsigned int program = linkBasicProgram(variantKey);
+		if (!program) {
+			return false;
+		}
+
+		m_glState.forgetProgram(m_glShaderProgram);
+		glDeleteProgram(m_glShaderProgram);
+		m_glShaderProgram = program;
+		m_glShaderProgramVariant = variantKey;
+		return true;
+	}
+
+	PipelineHandle OpenGLRenderer::basicPipeline(uint32_t variantKey) {
+		auto cached = m_glBasicPrograms.find(variantKey);
+		if (cached != m_glBasicPrograms.end()) {
+			return cached->second;
+		}
+
+		unsigned int program = 0;
+		auto pending = m_glProgramBuilds.find(variantKey);
+		if (pending != m_glProgramBuilds.end()) {
+			program = finishProgram(pending->second);
+			m_glProgramBuilds.erase(pending);
+		}
+		else {
+			program = linkBasicProgram(variantKey);
+		}
+		if (!program) {
+			return {};
+		}
+		return addBasicPipeline(variantKey, program);
+	}
+
+	PipelineHandle OpenGLRenderer::addBasicPipeline(uint32_t variantKey, unsigned int program) {
+		PipelineHandle handle = m_glPrograms.create(program);
+		m_glBasicPrograms.emplace(variantKey, handle);
+		return handle;
+	}
+
+	BufferHandle OpenGLRenderer::createBuffer(const BufferDesc& desc) {
+		OpenGLBuffer buffer;
+		buffer.size = static_cast<GLsizeiptr>(desc.size);
+
+		GLbitfield flags = desc.hostVisible ? GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT : 0;
+		glCreateBuffers(1, &buffer.buffer);
+		glNamedBufferStorage(buffer.buffer, buffer.size, desc.initialData, flags);
+		m_glFrameStats.allocations++;
+		if (desc.initialData) {
+			m_glFrameStats.bytesUploaded += desc.size;
+		}
+		if (desc.hostVisible) {
+			buffer.mapped = glMapNamedBufferRange(buffer.buffer, 0, buffer.size, flags);
+		}
+
+		return m_glBuffers.create(buffer);
+	}
+
+	// Like programs, GL keeps the storage alive until queued commands are done with it.
+	void OpenGLRenderer::destroyBuffer(BufferHandle handle) {
+		if (std::optional<OpenGLBuffer> buffer = m_glBuffers.remove(handle)) {
+			m_glState.forgetBuffer(buffer->buffer);
+			glDeleteBuffers(1, &buffer->buffer);
+		}
+	}
+
+	void* OpenGLRenderer::getMappedData(BufferHandle buffer) {
+		OpenGLBuffer* glBuffer = m_glBuffers.get(buffer);
+		return glBuffer ? glBuffer->mapped : nullptr;
+	}
+
+	void OpenGLRenderer::submit(const CommandStream& stream) {
+		m_glSubmittedStreams.push_back(stream);
+	}
+
+	// Copies drawCount blocks of m_glDrawConstantsSize bytes to the stream
+	// region and binds them at GL_CONSTANTS_BINDING, where draw i of the
+	// next draw call finds block i at gl_DrawID.
+	bool OpenGLRenderer::bindDrawConstants(const uint8_t* constants, size_t drawCount) {
+		if (m_glDrawConstantsSize == 0) {
+			return true;
+		}
+		const GLsizeiptr size = m_glDrawConstantsSize * static_cast<GLsizeiptr>(drawCount);
+		GLTransientAllocation block = streamAllocate(size, m_glStorageAlignment);
+		if (!block.data) {
+			return false;
+		}
+		memcpy(block.data, constants, size);
+		m_glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, GL_CONSTANTS_BINDING, m_glBuffers.get(block.buffer)->buffer,
+			block.offset, size);
+		m_glFrameStats.bytesUploaded += size;
+		m_glFrameStats.descriptorBinds++;
+		return true;
+	}
+
+	// Issues the pending draws as one multi-draw. Their indirect commands and
+	// constants go to the stream region.
+	void OpenGLRenderer::flushDraws(GLenum indexType) {
+		const bool indexed = !m_glPendingIndexedDraws.empty();
+		const GLsizei drawCount = static_cast<GLsizei>(indexed ? m_glPendingIndexedDraws.size() : m_glPendingDraws.size());
+		if (drawCount == 0) {
+			return;
+		}
+
+		const GLsizeiptr commandSize = indexed
+			? drawCount * sizeof(GLDrawElementsIndirectCommand)
+			: drawCount * sizeof(GLDrawArraysIndirectCommand);
+		GLTransientAllocation commands = streamAllocate(commandSize, sizeof(uint32_t));
+		if (commands.data && bindDrawConstants(m_glPendingConstants.data(), drawCount)) {
+			if (indexed) {
+				memcpy(commands.data, m_glPendingIndexedDraws.data(), commandSize);
+			}
+			else {
+				memcpy(commands.data, m_glPendingDraws.data(), commandSize);
+			}
+			m_glFrameStats.bytesUploaded += commandSize;
+
+			// GL_DRAW_INDIRECT_BUFFER is the stream buffer for the whole pass.
+			const void* indirect = reinterpret_cast<const void*>(static_cast<uintptr_t>(commands.offset));
+			if (indexed) {
+				glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, indirect, drawCount, 0);
+				for (const GLDrawElementsIndirectCommand& draw : m_glPendingIndexedDraws) {
+					m_glFrameStats.addDraw(draw.count, draw.instanceCount);
+				}
+			}
+			else {
+				glMultiDrawArraysIndirect(GL_TRIANGLES, indirect, drawCount, 0);
+				for (const GLDrawArraysIndirectCommand& draw : m_glPendingDraws) {
+					m_glFrameStats.addDraw(draw.count, draw.instanceCount);
+				}
+			}
+		}
+
+		m_glPendingIndexedDraws.clear();
+		m_glPendingDraws.clear();
+		m_glPendingConstants.clear();
+	}
+
+	// Every pooled pipeline is a basic program, so the stream VAO's vertex
+	// format follows m_basicReflection and binds only swap buffers. Draws are
+	// batched until the program or a buffer binding changes, or a dispatch or
+	// copy needs the ones before it done; SetConstants does not split a batch.
+	// Constants go back to zero on every BindPipeline, as on the other
+	// backends.
+	void OpenGLRenderer::executeCommandStreams() {
+		m_glState.bindVertexArray(m_glStreamVAO);
+		m_glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_glBuffers.get(m_glStreamBuffer)->buffer);
+
+		unsigned int boundProgram = 0;
+		unsigned int boundVertexBuffer = 0;
+		uint32_t boundVertexOffset = 0;
+		unsigned int boundIndexBuffer = 0;
+		GLenum indexType = GL_UNSIGNED_INT;
+		uint32_t indexOffset = 0;
+		for (const CommandStream& stream : m_glSubmittedStreams) {
+			for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+				switch (cmd->type) {
+				case CommandType::BindPipeline: {
+					const unsigned int* program = m_glPrograms.get(commandAs<CmdBindPipeline>(cmd).pipeline);
+					if (program && *program != boundProgram) {
+						flushDraws(indexType);
+						m_glState.useProgram(*program);
+						m_glFrameStats.pipelineBinds++;
+						boundProgram = *program;
+					}
+					memset(m_glConstants, 0, sizeof(m_glConstants));
+					break;
+				}
+				case CommandType::BindVertexBuffer: {
+					const auto& bind = commandAs<CmdBindVertexBuffer>(cmd);
+					const OpenGLBuffer* buffer = m_glBuffers.get(bind.buffer);
+					if (buffer && (buffer->buffer != boundVertexBuffer || bind.offset != boundVertexOffset)) {
+						flushDraws(indexType);
+						glVertexArrayVertexBuffer(m_glStreamVAO, GL_VERTEX_BUFFER_BINDING, buffer->buffer, bind.offset, m_glVertexStride);
+						boundVertexBuffer = buffer->buffer;
+						boundVertexOffset = bind.offset;
+					}
+					break;
+				}
+				// The offset is folded into each draw's firstIndex, so it only
+				// splits a batch when the buffer or index type changes.
+				case CommandType::BindIndexBuffer: {
+					const auto& bind = commandAs<CmdBindIndexBuffer>(cmd);
+					const OpenGLBuffer* buffer = m_glBuffers.get(bind.buffer);
+					GLenum bindIndexType = bind.indexType == IndexType::UInt16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+					if (!buffer) {
+						break;
+					}
+					if (buffer->buffer != boundIndexBuffer || bindIndexType != indexType) {
+						flushDraws(indexType);
+						glVertexArrayElementBuffer(m_glStreamVAO, buffer->buffer);
+						boundIndexBuffer = buffer->buffer;
+						indexType = bindIndexType;
+					}
+					indexOffset = bind.offset;
+					break;
+				}
+				// Draws already recorded keep their own copy.
+				case CommandType::SetConstants: {
+					const auto& constants = commandAs<CmdSetConstants>(cmd);
+					if (constants.offset + constants.size <= MAX_COMMAND_CONSTANTS_SIZE) {
+						memcpy(m_glConstants + constants.offset, constants.data(), constants.size);
+					}
+					break;
+				}
+				case CommandType::Draw: {
+					const auto& draw = commandAs<CmdDraw>(cmd);
+					if (!m_glPendingIndexedDraws.empty()) {
+						flushDraws(indexType);
+					}
+					m_glPendingDraws.push_back({ draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance });
+					m_glPendingConstants.insert(m_glPendingConstants.end(), m_glConstants, m_glConstants + m_glDrawConstantsSize);
+					break;
+				}
+				case CommandType::DrawIndexed: {
+					const auto& draw = commandAs<CmdDrawIndexed>(cmd);
+					if (!m_glPendingDraws.empty()) {
+						flushDraws(indexType);
+					}
+					uint32_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+					m_glPendingIndexedDraws.push_back({ draw.indexCount, draw.instanceCount,
+						indexOffset / indexSize + draw.firstIndex, draw.vertexOffset, draw.firstInstance });
+					m_glPendingConstants.insert(m_glPendingConstants.end(), m_glConstants, m_glConstants + m_glDrawConstantsSize);
+					break;
+				}
+				case CommandType::Dispatch: {
+					const auto& dispatch = commandAs<CmdDispatch>(cmd);
+					flushDraws(indexType);
+					glDispatchCompute(dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+					glMemoryBarrier(GL_ALL_BARRIER_BITS);
+					m_glFrameStats.dispatches++;
+					break;
+				}
+				case CommandType::CopyBuffer: {
+					const auto& copy = commandAs<CmdCopyBuffer>(cmd);
+					const OpenGLBuffer* src = m_glBuffers.get(copy.src);
+					const OpenGLBuffer* dst = m_glBuffers.get(copy.dst);
+					if (src && dst) {
+						flushDraws(indexType);
+						glCopyNamedBufferSubData(src->buffer, dst->buffer, copy.srcOffset, copy.dstOffset, copy.size);
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+		flushDraws(indexType);
+		m_glSubmittedStreams.clear();
+	}
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+	void OpenGLRenderer::reloadShaders() {
+		bool programDirty = false;
+		for (const auto& stage : m_shaderWatcher->takeReloaded()) {
+			if (stage == "basic.vert" || stage == "basic.frag") {
+				programDirty = true;
+			}
+		}
+
+		if (!programDirty) {
+			return;
+		}
+		// Builds still in flight used the old sources; pool them so the
+		// loop below relinks them too.
+		collectProgramBuilds(true);
+		if (!rebuildShaderProgram(m_glShaderProgramVariant)) {
+			std::cout << "shader hot reload: keeping previous program" << std::endl;
+		}
+		for (const auto& [variantKey, handle] : m_glBasicPrograms) {
+			if (unsigned int program = linkBasicProgram(variantKey)) {
+				unsigned int* pooled = m_glPrograms.get(handle);
+				m_glState.forgetProgram(*pooled);
+				glDeleteProgram(*pooled);
+				*pooled = program;
+			}
+		}
+	}
+#endif
+
 	void OpenGLRenderer::draw() {
+		const uint64_t frameStartNs = SDL_GetTicksNS();
+
 		if (m_windowResized) {
 			resizeWindow();
 			m_windowResized = false;
 		}
-		glClearColor(129.0f / 255.0f, 186.0f / 255.0f, 219.0f / 255.0f, 1.0f);
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+		reloadShaders();
+#endif
+
+		if (m_shaderVariant != m_glShaderProgramVariant && !rebuildShaderProgram(m_shaderVariant)) {
+			std::cout << "shader variant " << m_shaderVariant << " failed to link, keeping previous program" << std::endl;
+			m_shaderVariant = m_glShaderProgramVariant;
+		}
+		collectProgramBuilds(false);
+
+		const FramePacingPolicy& pacing = m_framePacer.policy();
+		if (!pacing.lateLatchCamera) {
+			m_framePacer.limit();
+		}
+		beginFrameSlot();
+
+		m_glState.clearColor(129.0f / 255.0f, 186.0f / 255.0f, 219.0f / 255.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glUseProgram(m_glShaderProgram);
+		m_glState.useProgram(m_glShaderProgram);
+		m_glFrameStats.pipelineBinds++;
 
+		if (pacing.lateLatchCamera) {
+			m_framePacer.limit();
+		}
 		updateUniformBuffer();
 
-		glBindVertexArray(m_glVAO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_glEBO);
-
-		glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+		// The scene's draw is gl_DrawID 0 and keeps zero constants.
+		const uint8_t sceneConstants[MAX_COMMAND_CONSTANTS_SIZE] = {};
+		bindDrawConstants(sceneConstants, 1);
+		m_glState.bindVertexArray(m_glVAO);
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT,
+			reinterpret_cast<void*>(m_glSceneIndexOffset));
+		m_glFrameStats.addDraw(m_indices.size(), 1);
+
+		executeCommandStreams();
+
+		if (m_glPipelineStatisticsSupported) {
+			for (GLenum target : GL_STATISTICS_TARGETS) {
+				glEndQuery(target);
+			}
+			m_glStatisticsPending[m_glFrameIndex] = true;
+		}
 
 		SDL_GL_SwapWindow(m_window);
+		m_framePacer.onPresent();
+
+		m_glFrameFences[m_glFrameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_glFrameIndex = (m_glFrameIndex + 1) % pacing.frameQueueDepth;
+		m_glFrameSlotOpen = false;
+		m_frameArenas.endFrame();
+		m_glStateStats = m_glState.endFrame();
+
+		m_glFrameStats.frameTimeNs = SDL_GetTicksNS() - frameStartNs;
+		m_renderStats.push(m_glFrameStats);
+		m_glFrameStats = {};
+	}
+
+	LinearArena& OpenGLRenderer::frameArena() {
+		return m_frameArenas.current();
+	}
+
+	// The driver decides how far it queues ahead on its own; a fence per frame
+	// slot caps it at frameQueueDepth frames.
+	void OpenGLRenderer::waitForFrameSlot() {
+		GLsync& fence = m_glFrameFences[m_glFrameIndex];
+		if (fence) {
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		collectPipelineStatistics();
+	}
+
+	// Called once the slot's fence has passed, so the results are normally
+	// in; if a driver still has one outstanding, the frame goes uncounted
+	// rather than waiting.
+	void OpenGLRenderer::collectPipelineStatistics() {
+		if (!m_glStatisticsPending[m_glFrameIndex]) {
+			return;
+		}
+		m_glStatisticsPending[m_glFrameIndex] = false;
+
+		GLuint64 counters[GL_STATISTICS_TARGET_COUNT] = {};
+		for (size_t i = 0; i < GL_STATISTICS_TARGET_COUNT; i++) {
+			GLuint query = m_glStatisticsQueries[i][m_glFrameIndex];
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				return;
+			}
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &counters[i]);
+		}
+		m_glFrameStats.vertexInvocations = counters[0];
+		m_glFrameStats.fragmentInvocations = counters[1];
+		m_glFrameStats.computeInvocations = counters[2];
+		m_glFrameStats.gpuCountersValid = true;
+	}
+
+	// Called by whichever comes first, draw() or an allocateTransient() for
+	// the frame being built, so the slot's region is free before it is written.
+	void OpenGLRenderer::beginFrameSlot() {
+		if (m_glFrameSlotOpen) {
+			return;
+		}
+		waitForFrameSlot();
+		m_glStreamOffset = 0;
+		m_glFrameSlotOpen = true;
+
+		if (m_glPipelineStatisticsSupported) {
+			for (size_t i = 0; i < GL_STATISTICS_TARGET_COUNT; i++) {
+				glBeginQuery(GL_STATISTICS_TARGETS[i], m_glStatisticsQueries[i][m_glFrameIndex]);
+			}
+		}
+	}
+
+	GLTransientAllocation OpenGLRenderer::streamAllocate(GLsizeiptr size, GLint alignment) {
+		beginFrameSlot();
+
+		// Aligned within the whole buffer, which is what glBindBufferRange checks.
+		const GLintptr regionStart = static_cast<GLintptr>(m_glFrameIndex) * GL_STREAM_REGION_SIZE;
+		GLintptr offset = (regionStart + m_glStreamOffset + alignment - 1) / alignment * alignment;
+		if (offset + size > regionStart + GL_STREAM_REGION_SIZE) {
+			std::cout << "GL stream region exhausted" << std::endl;
+			return {};
+		}
+		m_glStreamOffset = offset + size - regionStart;
+
+		GLTransientAllocation allocation;
+		allocation.buffer = m_glStreamBuffer;
+		allocation.offset = static_cast<uint32_t>(offset);
+		allocation.data = static_cast<uint8_t*>(m_glBuffers.get(m_glStreamBuffer)->mapped) + offset;
+		return allocation;
+	}
+
+	GLTransientAllocation OpenGLRenderer::allocateTransient(uint32_t size, uint32_t alignment) {
+		return streamAllocate(size, static_cast<GLint>(std::max(alignment, 1u)));
+	}
+
+	// GL has no mailbox: it maps to an unsynchronized swap like immediate.
+	// Relaxed FIFO is adaptive vsync (-1) where the driver supports it.
+	void OpenGLRenderer::applySwapInterval() {
+		switch (m_framePacer.policy().presentMode) {
+		case PresentMode::Immediate:
+		case PresentMode::Mailbox:
+			SDL_GL_SetSwapInterval(0);
+			break;
+		case PresentMode::Fifo:
+			SDL_GL_SetSwapInterval(1);
+			break;
+		case PresentMode::FifoRelaxed:
+			if (!SDL_GL_SetSwapInterval(-1)) {
+				SDL_GL_SetSwapInterval(1);
+			}
+			break;
+		}
+	}
+
+	void OpenGLRenderer::setFramePacing(const FramePacingPolicy& policy) {
+		m_framePacer.setPolicy(policy);
+		if (m_glContext) {
+			applySwapInterval();
+		}
+	}
+
+	void OpenGLRenderer::markInput(uint64_t timestampNs) {
+		m_framePacer.markInput(timestampNs);
 	}
 
 	void OpenGLRenderer::updateUniformBuffer() {
@@ -161,20 +897,62 @@ namespace Nashi {
 			m_windowWidth / (float)m_windowHeight, 0.1f,
 			10.0f);
 
-		glBindBuffer(GL_UNIFORM_BUFFER, m_glUBO);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ubo), &ubo);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		GLTransientAllocation block = streamAllocate(sizeof(ubo), m_glUniformAlignment);
+		if (block.data) {
+			memcpy(block.data, &ubo, sizeof(ubo));
+			m_glFrameStats.bytesUploaded += sizeof(ubo);
+			m_glFrameStats.descriptorBinds++;
+			m_glState.bindBufferRange(GL_UNIFORM_BUFFER, m_glUBOBindingPoint, m_glBuffers.get(block.buffer)->buffer,
+				block.offset, sizeof(ubo));
+		}
 	}
 
 	void OpenGLRenderer::cleanup() {
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+		m_shaderWatcher->stop();
+#endif
+
+		for (GLsync& fence : m_glFrameFences) {
+			if (fence) {
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
 
 		glDeleteVertexArrays(1, &m_glVAO);
+		glDeleteVertexArrays(1, &m_glStreamVAO);
+		if (m_glPipelineStatisticsSupported) {
+			for (GLuint* queries : m_glStatisticsQueries) {
+				glDeleteQueries(MAX_FRAME_QUEUE_DEPTH, queries);
+			}
+		}
 
-		const unsigned int removedBuffers[] = { m_glEBO, m_glVBO };
+		for (const OpenGLBuffer& buffer : m_glBuffers) {
+			glDeleteBuffers(1, &buffer.buffer);
+		}
+		m_glBuffers.clear();
+		for (unsigned int program : m_glPrograms) {
+			glDeleteProgram(program);
+		}
+		m_glPrograms.clear();
+		m_glBasicPrograms.clear();
+		for (const auto& [variantKey, build] : m_glProgramBuilds) {
+			glDeleteShader(build.vertexShader);
+			glDeleteShader(build.fragmentShader);
+			glDeleteProgram(build.program);
+		}
+		m_glProgramBuilds.clear();
 
-		glDeleteBuffers(sizeof(removedBuffers) / sizeof(removedBuffers[0]), removedBuffers);
+		glDeleteBuffers(1, &m_glSceneBuffer);
 		glDeleteProgram(m_glShaderProgram);
-		SDL_GL_DestroyContext(m_glContext);
+		m_shaderLibrary.close();
+		if (m_glContextExternal) {
+			SDL_GL_MakeCurrent(m_window, nullptr);
+		}
+		else {
+			SDL_GL_DestroyContext(m_glContext);
+			m_glContext = nullptr;
+		}
 	}
 }
 #endif
\ No newline at end of file
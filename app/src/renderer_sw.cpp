@@ -0,0 +1,652 @@
+#ifdef NASHI_USE_SOFTWARE
+#include <renderer_sw.hpp>
+#include <simd_lanes.hpp>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace Nashi {
+    namespace {
+        constexpr uint32_t SRGB_TABLE_SIZE = 4096;
+        // The Vulkan backend's clear color after its sRGB swapchain encodes it.
+        constexpr uint32_t SOFTWARE_CLEAR_COLOR = 0xFF000000u | (129u << 16) | (186u << 8) | 219u;
+
+        // Linear [0, 1] to 8-bit sRGB, so frames match the Vulkan backend's
+        // sRGB swapchain.
+        const uint8_t* srgbEncodeTable() {
+            static const std::array<uint8_t, SRGB_TABLE_SIZE> table = [] {
+                std::array<uint8_t, SRGB_TABLE_SIZE> values{};
+                for (uint32_t i = 0; i < SRGB_TABLE_SIZE; i++) {
+                    float c = static_cast<float>(i) / static_cast<float>(SRGB_TABLE_SIZE - 1);
+                    float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                    values[i] = static_cast<uint8_t>(s * 255.0f + 0.5f);
+                }
+                return values;
+            }();
+            return table.data();
+        }
+
+        uint32_t encodeChannel(const uint8_t* table, float c) {
+            // Also maps NaN to 0.
+            c = c > 0.0f ? (c < 1.0f ? c : 1.0f) : 0.0f;
+            return table[static_cast<uint32_t>(c * static_cast<float>(SRGB_TABLE_SIZE - 1) + 0.5f)];
+        }
+
+        template<typename Index>
+        int64_t readIndex(const uint8_t* indices, uint32_t i) {
+            Index value;
+            memcpy(&value, indices + static_cast<size_t>(i) * sizeof(Index), sizeof(Index));
+            return value;
+        }
+    }
+
+    SoftwareRenderer::SoftwareRenderer(SDL_Window* window, SDL_Event event, uint32_t width, uint32_t height) {
+        this->m_window = window;
+        this->m_event = event;
+        this->m_width = width;
+        this->m_height = height;
+    }
+
+    SoftwareRenderer::~SoftwareRenderer() {
+        m_tileJobs.stop();
+    }
+
+    void SoftwareRenderer::init() {
+        if (m_window) {
+            int width, height;
+            SDL_GetWindowSizeInPixels(m_window, &width, &height);
+            m_width = static_cast<uint32_t>(std::max(width, 1));
+            m_height = static_cast<uint32_t>(std::max(height, 1));
+        }
+        resizeFramebuffer(m_width, m_height);
+
+        BufferDesc desc{};
+        desc.size = m_vertices.size() * sizeof(SoftwareVertex);
+        desc.usage = BUFFER_USAGE_VERTEX;
+        desc.initialData = m_vertices.data();
+        m_vertexBuffer = createBuffer(desc);
+
+        desc.size = m_indices.size() * sizeof(uint16_t);
+        desc.usage = BUFFER_USAGE_INDEX;
+        desc.initialData = m_indices.data();
+        m_indexBuffer = createBuffer(desc);
+
+        // The calling thread rasterizes too.
+        m_tileJobs.start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    }
+
+    void SoftwareRenderer::resizeFramebuffer(uint32_t width, uint32_t height) {
+        m_width = width;
+        m_height = height;
+        m_pitch = (width + 7) & ~7u;
+        m_tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+        m_tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+
+        m_colorBuffer.assign(static_cast<size_t>(m_pitch) * height, SOFTWARE_CLEAR_COLOR);
+        m_depthBuffer.assign(static_cast<size_t>(m_pitch) * height, 1.0f);
+        m_tileBins.clear();
+        m_tileBins.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+
+        if (m_frameSurface) {
+            SDL_DestroySurface(m_frameSurface);
+            m_frameSurface = nullptr;
+        }
+        if (m_window) {
+            m_frameSurface = SDL_CreateSurfaceFrom(static_cast<int>(width), static_cast<int>(height),
+                SDL_PIXELFORMAT_XRGB8888, m_colorBuffer.data(), static_cast<int>(m_pitch * sizeof(uint32_t)));
+            if (!m_frameSurface) {
+                std::cout << "SDL_CreateSurfaceFrom failed: " << SDL_GetError() << std::endl;
+            }
+        }
+    }
+
+    BufferHandle SoftwareRenderer::createBuffer(const BufferDesc& desc) {
+        SoftwareBuffer buffer;
+        buffer.data.resize(static_cast<size_t>(desc.size));
+        buffer.hostVisible = desc.hostVisible;
+        if (desc.initialData) {
+            memcpy(buffer.data.data(), desc.initialData, buffer.data.size());
+        }
+        return m_buffers.create(std::move(buffer));
+    }
+
+    // Frames finish inside draw(), so nothing can still be using the buffer.
+    void SoftwareRenderer::destroyBuffer(BufferHandle handle) {
+        m_buffers.remove(handle);
+    }
+
+    void* SoftwareRenderer::getMappedData(BufferHandle buffer) {
+        SoftwareBuffer* softwareBuffer = m_buffers.get(buffer);
+        return softwareBuffer && softwareBuffer->hostVisible ? softwareBuffer->data.data() : nullptr;
+    }
+
+    PipelineHandle SoftwareRenderer::basicPipeline(uint32_t variantKey) {
+        auto cached = m_basicPipelines.find(variantKey);
+        if (cached != m_basicPipelines.end()) {
+            return cached->second;
+        }
+
+        PipelineHandle handle = m_pipelines.create(variantKey);
+        m_basicPipelines.emplace(variantKey, handle);
+        return handle;
+    }
+
+    void SoftwareRenderer::submit(const CommandStream& stream) {
+        m_submittedStreams.push_back(stream);
+    }
+
+    LinearArena& SoftwareRenderer::frameArena() {
+        return m_frameArenas.current();
+    }
+
+    // SDL_UpdateWindowSurface has no present modes, so only the limiter and
+    // the latency log of the policy apply.
+    void SoftwareRenderer::setFramePacing(const FramePacingPolicy& policy) {
+        m_framePacer.setPolicy(policy);
+    }
+
+    void SoftwareRenderer::markInput(uint64_t timestampNs) {
+        m_framePacer.markInput(timestampNs);
+    }
+
+    void SoftwareRenderer::updateUniformBuffer() {
+        static auto startTime = std::chrono::high_resolution_clock::now();
+
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+        m_ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        m_ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f,
+            0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        m_ubo.proj = glm::perspective(glm::radians(45.0f),
+            m_width / (float)m_height, 0.1f,
+            10.0f);
+        m_ubo.proj[1][1] *= -1;
+    }
+
+    // index(i) yields the vertex of the draw's i-th corner. The range of
+    // referenced vertices is transformed once up front, so vertices shared
+    // between triangles are not transformed again. offset is basic.vert's
+    // per-draw model-space translation. With occlusionTest, the box around
+    // that range goes to the occlusion culler first.
+    template<typename IndexFn>
+    void SoftwareRenderer::drawTriangles(const SoftwareBuffer& vertexBuffer, uint32_t vertexOffset, uint32_t vertexCount,
+        IndexFn index, const glm::vec3& offset, uint32_t features, bool occlusionTest) {
+        if (vertexCount < 3) {
+            return;
+        }
+
+        int64_t first = INT64_MAX;
+        int64_t last = -1;
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            int64_t vertex = index(i);
+            first = std::min(first, vertex);
+            last = std::max(last, vertex);
+        }
+        // Out-of-bounds draws are dropped whole, the way robust buffer access
+        // would keep them from reading other memory.
+        const size_t stride = sizeof(SoftwareVertex);
+        if (first < 0 || vertexOffset + static_cast<size_t>(last + 1) * stride > vertexBuffer.data.size()) {
+            return;
+        }
+
+        const glm::mat4 modelViewProjection = m_ubo.proj * m_ubo.view * m_ubo.model;
+        const uint8_t* data = vertexBuffer.data.data() + vertexOffset;
+        if (occlusionTest && m_occlusionCulling) {
+            glm::vec3 boundsMin(FLT_MAX);
+            glm::vec3 boundsMax(-FLT_MAX);
+            for (int64_t i = first; i <= last; i++) {
+                glm::vec3 pos;
+                memcpy(&pos, data + static_cast<size_t>(i) * stride, sizeof(pos));
+                boundsMin = glm::min(boundsMin, pos);
+                boundsMax = glm::max(boundsMax, pos);
+            }
+            boundsMin += offset;
+            boundsMax += offset;
+            if (!m_occlusionCuller.isVisible(glm::value_ptr(boundsMin), glm::value_ptr(boundsMax),
+                glm::value_ptr(modelViewProjection))) {
+                m_occludedDraws++;
+                return;
+            }
+        }
+
+        m_clipVertices.resize(static_cast<size_t>(last - first + 1));
+        for (size_t i = 0; i < m_clipVertices.size(); i++) {
+            SoftwareVertex vertex;
+            memcpy(&vertex, data + (static_cast<size_t>(first) + i) * stride, stride);
+            m_clipVertices[i].position = modelViewProjection * glm::vec4(vertex.pos + offset, 1.0f);
+            m_clipVertices[i].color = vertex.color;
+        }
+
+        for (uint32_t i = 0; i + 2 < vertexCount; i += 3) {
+            const ClipVertex* triangle[3] = {
+                &m_clipVertices[static_cast<size_t>(index(i) - first)],
+                &m_clipVertices[static_cast<size_t>(index(i + 1) - first)],
+                &m_clipVertices[static_cast<size_t>(index(i + 2) - first)],
+            };
+            clipTriangle(triangle, features);
+        }
+    }
+
+    // Only the near plane is clipped, everything else is left to the tile
+    // bounds and the depth test; triangles wholly outside a side plane are
+    // rejected first.
+    void SoftwareRenderer::clipTriangle(const ClipVertex* vertices[3], uint32_t features) {
+        const glm::vec4& a = vertices[0]->position;
+        const glm::vec4& b = vertices[1]->position;
+        const glm::vec4& c = vertices[2]->position;
+        for (int axis = 0; axis < 3; axis++) {
+            if (a[axis] > a.w && b[axis] > b.w && c[axis] > c.w) {
+                return;
+            }
+        }
+        if (a.x < -a.w && b.x < -b.w && c.x < -c.w) {
+            return;
+        }
+        if (a.y < -a.w && b.y < -b.w && c.y < -c.w) {
+            return;
+        }
+        if (a.z >= 0.0f && b.z >= 0.0f && c.z >= 0.0f) {
+            setupTriangle(*vertices[0], *vertices[1], *vertices[2], features);
+            return;
+        }
+
+        ClipVertex polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++) {
+            const ClipVertex& current = *vertices[i];
+            const ClipVertex& next = *vertices[(i + 1) % 3];
+            if (current.position.z >= 0.0f) {
+                polygon[count++] = current;
+            }
+            if ((current.position.z >= 0.0f) != (next.position.z >= 0.0f)) {
+                float t = current.position.z / (current.position.z - next.position.z);
+                polygon[count].position = glm::mix(current.position, next.position, t);
+                polygon[count].color = glm::mix(current.color, next.color, t);
+                count++;
+            }
+        }
+        for (int i = 1; i + 1 < count; i++) {
+            setupTriangle(polygon[0], polygon[i], polygon[i + 1], features);
+        }
+    }
+
+    void SoftwareRenderer::setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t features) {
+        const ClipVertex* vertices[3] = { &a, &b, &c };
+        float x[3];
+        float y[3];
+        float z[3];
+        float invW[3];
+        for (int i = 0; i < 3; i++) {
+            const glm::vec4& position = vertices[i]->position;
+            if (!(position.w > 0.0f)) {
+                return;
+            }
+            invW[i] = 1.0f / position.w;
+            x[i] = (position.x * invW[i] * 0.5f + 0.5f) * static_cast<float>(m_width);
+            y[i] = (position.y * invW[i] * 0.5f + 0.5f) * static_cast<float>(m_height);
+            z[i] = position.z * invW[i];
+        }
+
+        // Framebuffer y points down, so counter-clockwise front faces have a
+        // negative area here. Back faces and degenerate triangles stop here.
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (!(area < 0.0f)) {
+            return;
+        }
+        std::swap(vertices[1], vertices[2]);
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        std::swap(invW[1], invW[2]);
+        area = -area;
+
+        // Pixels whose centers can be inside, clamped before converting.
+        const float firstX = std::ceil(std::max(std::min({ x[0], x[1], x[2] }) - 0.5f, 0.0f));
+        const float firstY = std::ceil(std::max(std::min({ y[0], y[1], y[2] }) - 0.5f, 0.0f));
+        const float lastX = std::floor(std::min(std::max({ x[0], x[1], x[2] }) - 0.5f, static_cast<float>(m_width - 1)));
+        const float lastY = std::floor(std::min(std::max({ y[0], y[1], y[2] }) - 0.5f, static_cast<float>(m_height - 1)));
+        if (firstX > lastX || firstY > lastY) {
+            return;
+        }
+
+        SoftwareTriangle triangle;
+        for (int i = 0; i < 3; i++) {
+            // Edge opposite vertex i, scaled so it evaluates to vertex i's weight.
+            const int from = (i + 1) % 3;
+            const int to = (i + 2) % 3;
+            triangle.edges[i][0] = (y[from] - y[to]) / area;
+            triangle.edges[i][1] = (x[to] - x[from]) / area;
+            triangle.edges[i][2] = ((y[to] - y[from]) * x[from] - (x[to] - x[from]) * y[from]) / area;
+            // Pixels centered exactly on a shared edge belong to one triangle.
+            triangle.topLeft[i] = (y[from] == y[to] && x[to] > x[from]) || y[to] < y[from];
+        }
+
+        for (int k = 0; k < 3; k++) {
+            triangle.depth[k] = 0.0f;
+            triangle.invW[k] = 0.0f;
+            triangle.color[0][k] = 0.0f;
+            triangle.color[1][k] = 0.0f;
+            triangle.color[2][k] = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                const float weight = triangle.edges[i][k];
+                triangle.depth[k] += weight * z[i];
+                triangle.invW[k] += weight * invW[i];
+                for (int channel = 0; channel < 3; channel++) {
+                    triangle.color[channel][k] += weight * vertices[i]->color[channel] * invW[i];
+                }
+            }
+        }
+
+        triangle.minX = static_cast<int32_t>(firstX);
+        triangle.minY = static_cast<int32_t>(firstY);
+        triangle.maxX = static_cast<int32_t>(lastX);
+        triangle.maxY = static_cast<int32_t>(lastY);
+        triangle.features = features;
+
+        constexpr int32_t tileSize = static_cast<int32_t>(SOFTWARE_TILE_SIZE);
+        const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        for (int32_t tileY = triangle.minY / tileSize; tileY <= triangle.maxY / tileSize; tileY++) {
+            for (int32_t tileX = triangle.minX / tileSize; tileX <= triangle.maxX / tileSize; tileX++) {
+                m_tileBins[static_cast<size_t>(tileY) * m_tilesX + tileX].push_back(index);
+            }
+        }
+    }
+
+    // Every pooled pipeline is a basic.vert/basic.frag permutation: vertices
+    // are SoftwareVertex and transformed by the camera uniforms.
+    void SoftwareRenderer::executeCommandStreams() {
+        const uint32_t* features = nullptr;
+        // basic.vert's DrawConstants: a float4 offset, of which xyz is used.
+        float constants[MAX_COMMAND_CONSTANTS_SIZE / sizeof(float)] = {};
+        const SoftwareBuffer* vertexBuffer = nullptr;
+        uint32_t vertexOffset = 0;
+        const SoftwareBuffer* indexBuffer = nullptr;
+        uint32_t indexOffset = 0;
+        IndexType indexType = IndexType::UInt32;
+
+        for (const CommandStream& stream : m_submittedStreams) {
+            for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+                switch (cmd->type) {
+                case CommandType::BindPipeline:
+                    features = m_pipelines.get(commandAs<CmdBindPipeline>(cmd).pipeline);
+                    std::fill_n(constants, std::size(constants), 0.0f);
+                    break;
+                case CommandType::BindVertexBuffer: {
+                    const auto& bind = commandAs<CmdBindVertexBuffer>(cmd);
+                    vertexBuffer = m_buffers.get(bind.buffer);
+                    vertexOffset = bind.offset;
+                    break;
+                }
+                case CommandType::BindIndexBuffer: {
+                    const auto& bind = commandAs<CmdBindIndexBuffer>(cmd);
+                    indexBuffer = m_buffers.get(bind.buffer);
+                    indexOffset = bind.offset;
+                    indexType = bind.indexType;
+                    break;
+                }
+                case CommandType::SetConstants: {
+                    const auto& set = commandAs<CmdSetConstants>(cmd);
+                    if (set.offset + set.size <= MAX_COMMAND_CONSTANTS_SIZE) {
+                        memcpy(reinterpret_cast<uint8_t*>(constants) + set.offset, set.data(), set.size);
+                    }
+                    break;
+                }
+                // basic.vert ignores the instance index, so every instance
+                // covers the same pixels and one is enough.
+                case CommandType::Draw: {
+                    const auto& draw = commandAs<CmdDraw>(cmd);
+                    if (!features || !vertexBuffer || draw.instanceCount == 0) {
+                        break;
+                    }
+                    drawTriangles(*vertexBuffer, vertexOffset, draw.vertexCount,
+                        [&draw](uint32_t i) { return static_cast<int64_t>(draw.firstVertex) + i; },
+                        glm::vec3(constants[0], constants[1], constants[2]), *features, true);
+                    break;
+                }
+                case CommandType::DrawIndexed: {
+                    const auto& draw = commandAs<CmdDrawIndexed>(cmd);
+                    if (!features || !vertexBuffer || !indexBuffer || draw.instanceCount == 0) {
+                        break;
+                    }
+                    const size_t indexSize = indexType == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+                    const size_t start = indexOffset + static_cast<size_t>(draw.firstIndex) * indexSize;
+                    if (start + static_cast<size_t>(draw.indexCount) * indexSize > indexBuffer->data.size()) {
+                        break;
+                    }
+                    const uint8_t* indices = indexBuffer->data.data() + start;
+                    const glm::vec3 offset(constants[0], constants[1], constants[2]);
+                    if (indexType == IndexType::UInt16) {
+                        drawTriangles(*vertexBuffer, vertexOffset, draw.indexCount,
+                            [&](uint32_t i) { return readIndex<uint16_t>(indices, i) + draw.vertexOffset; }, offset, *features, true);
+                    }
+                    else {
+                        drawTriangles(*vertexBuffer, vertexOffset, draw.indexCount,
+                            [&](uint32_t i) { return readIndex<uint32_t>(indices, i) + draw.vertexOffset; }, offset, *features, true);
+                    }
+                    break;
+                }
+                // No compute shaders run on this backend.
+                case CommandType::Dispatch:
+                    break;
+                case CommandType::CopyBuffer: {
+                    const auto& copy = commandAs<CmdCopyBuffer>(cmd);
+                    SoftwareBuffer* src = m_buffers.get(copy.src);
+                    SoftwareBuffer* dst = m_buffers.get(copy.dst);
+                    if (src && dst && static_cast<size_t>(copy.srcOffset) + copy.size <= src->data.size()
+                        && static_cast<size_t>(copy.dstOffset) + copy.size <= dst->data.size()) {
+                        memmove(dst->data.data() + copy.dstOffset, src->data.data() + copy.srcOffset, copy.size);
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+        }
+        m_submittedStreams.clear();
+    }
+
+    void SoftwareRenderer::rasterize() {
+        m_tileJobs.run(m_tilesX * m_tilesY, [this](uint32_t tile) { rasterizeTile(tile); });
+    }
+
+    void SoftwareRenderer::rasterizeTile(uint32_t tile) {
+        using Lanes = NativeLanes;
+        using Float = Lanes::Float;
+        using Mask = Lanes::Mask;
+        constexpr int32_t laneCount = Lanes::WIDTH;
+
+        const int32_t originX = static_cast<int32_t>((tile % m_tilesX) * SOFTWARE_TILE_SIZE);
+        const int32_t originY = static_cast<int32_t>((tile / m_tilesX) * SOFTWARE_TILE_SIZE);
+        const int32_t endX = std::min(originX + static_cast<int32_t>(SOFTWARE_TILE_SIZE), static_cast<int32_t>(m_width)) - 1;
+        const int32_t endY = std::min(originY + static_cast<int32_t>(SOFTWARE_TILE_SIZE), static_cast<int32_t>(m_height)) - 1;
+
+        for (int32_t row = originY; row <= endY; row++) {
+            const size_t offset = static_cast<size_t>(row) * m_pitch + originX;
+            std::fill_n(m_colorBuffer.data() + offset, endX - originX + 1, SOFTWARE_CLEAR_COLOR);
+            std::fill_n(m_depthBuffer.data() + offset, endX - originX + 1, 1.0f);
+        }
+
+        const uint8_t* srgb = srgbEncodeTable();
+        const Float zero = Lanes::set1(0.0f);
+        const Float one = Lanes::set1(1.0f);
+        const Float screenWidth = Lanes::set1(static_cast<float>(m_width));
+
+        for (uint32_t index : m_tileBins[tile]) {
+            const SoftwareTriangle& triangle = m_triangles[index];
+            const int32_t firstRow = std::max(triangle.minY, originY);
+            const int32_t lastRow = std::min(triangle.maxY, endY);
+            int32_t firstColumn = std::max(triangle.minX, originX);
+            firstColumn -= (firstColumn - originX) % laneCount;
+            const int32_t lastColumn = std::min(triangle.maxX, endX);
+            const bool desaturate = (triangle.features & BASIC_FEATURE_DESATURATE) != 0;
+
+            const Float edgeX[3] = {
+                Lanes::set1(triangle.edges[0][0]), Lanes::set1(triangle.edges[1][0]), Lanes::set1(triangle.edges[2][0]) };
+            const Float depthX = Lanes::set1(triangle.depth[0]);
+            const Float invWX = Lanes::set1(triangle.invW[0]);
+            const Float colorX[3] = {
+                Lanes::set1(triangle.color[0][0]), Lanes::set1(triangle.color[1][0]), Lanes::set1(triangle.color[2][0]) };
+
+            for (int32_t row = firstRow; row <= lastRow; row++) {
+                const float py = static_cast<float>(row) + 0.5f;
+                Float edgeRow[3];
+                Float colorRow[3];
+                for (int i = 0; i < 3; i++) {
+                    edgeRow[i] = Lanes::set1(triangle.edges[i][1] * py + triangle.edges[i][2]);
+                    colorRow[i] = Lanes::set1(triangle.color[i][1] * py + triangle.color[i][2]);
+                }
+                const Float depthRow = Lanes::set1(triangle.depth[1] * py + triangle.depth[2]);
+                const Float invWRow = Lanes::set1(triangle.invW[1] * py + triangle.invW[2]);
+
+                uint32_t* colorPixels = m_colorBuffer.data() + static_cast<size_t>(row) * m_pitch;
+                float* depthPixels = m_depthBuffer.data() + static_cast<size_t>(row) * m_pitch;
+
+                for (int32_t x = firstColumn; x <= lastColumn; x += laneCount) {
+                    const Float px = Lanes::add(Lanes::set1(static_cast<float>(x) + 0.5f), Lanes::ramp());
+                    Mask inside = Lanes::greaterThan(screenWidth, px);
+                    for (int i = 0; i < 3; i++) {
+                        const Float edge = Lanes::add(Lanes::mul(edgeX[i], px), edgeRow[i]);
+                        inside = Lanes::bitAnd(inside,
+                            triangle.topLeft[i] ? Lanes::greaterEqual(edge, zero) : Lanes::greaterThan(edge, zero));
+                    }
+                    if (!Lanes::any(inside)) {
+                        continue;
+                    }
+
+                    const Float depth = Lanes::add(Lanes::mul(depthX, px), depthRow);
+                    const Float current = Lanes::load(depthPixels + x);
+                    const Mask pass = Lanes::bitAnd(inside, Lanes::greaterThan(current, depth));
+                    if (!Lanes::any(pass)) {
+                        continue;
+                    }
+                    Lanes::store(depthPixels + x, Lanes::select(pass, depth, current));
+
+                    const Float w = Lanes::div(one, Lanes::add(Lanes::mul(invWX, px), invWRow));
+                    Float red = Lanes::mul(Lanes::add(Lanes::mul(colorX[0], px), colorRow[0]), w);
+                    Float green = Lanes::mul(Lanes::add(Lanes::mul(colorX[1], px), colorRow[1]), w);
+                    Float blue = Lanes::mul(Lanes::add(Lanes::mul(colorX[2], px), colorRow[2]), w);
+                    if (desaturate) {
+                        red = Lanes::add(Lanes::add(Lanes::mul(red, Lanes::set1(0.2126f)),
+                            Lanes::mul(green, Lanes::set1(0.7152f))), Lanes::mul(blue, Lanes::set1(0.0722f)));
+                        green = red;
+                        blue = red;
+                    }
+
+                    alignas(16) float reds[laneCount];
+                    alignas(16) float greens[laneCount];
+                    alignas(16) float blues[laneCount];
+                    Lanes::store(reds, red);
+                    Lanes::store(greens, green);
+                    Lanes::store(blues, blue);
+                    const uint32_t lanes = Lanes::bits(pass);
+                    for (int32_t lane = 0; lane < laneCount; lane++) {
+                        if (lanes & (1u << lane)) {
+                            colorPixels[x + lane] = 0xFF000000u | (encodeChannel(srgb, reds[lane]) << 16)
+                                | (encodeChannel(srgb, greens[lane]) << 8) | encodeChannel(srgb, blues[lane]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void SoftwareRenderer::present() {
+        if (!m_window || !m_frameSurface) {
+            return;
+        }
+        SDL_Surface* windowSurface = SDL_GetWindowSurface(m_window);
+        if (!windowSurface) {
+            return;
+        }
+        SDL_BlitSurface(m_frameSurface, nullptr, windowSurface, nullptr);
+        SDL_UpdateWindowSurface(m_window);
+    }
+
+    void SoftwareRenderer::draw() {
+        if (m_windowResized) {
+            int width, height;
+            SDL_GetWindowSizeInPixels(m_window, &width, &height);
+            if (width > 0 && height > 0) {
+                resizeFramebuffer(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+            }
+            m_windowResized = false;
+        }
+
+        // No queue to run ahead of: the camera is always latched right
+        // before the frame is built, whatever lateLatchCamera says.
+        m_framePacer.limit();
+        updateUniformBuffer();
+
+        // The camera is forward Z already, as the culler wants it.
+        m_occludedDraws = 0;
+        if (m_occlusionCulling) {
+            const glm::mat4 modelViewProjection = m_ubo.proj * m_ubo.view * m_ubo.model;
+            m_occlusionCuller.beginFrame();
+            m_occlusionCuller.addOccluder(glm::value_ptr(m_vertices[0].pos), sizeof(SoftwareVertex),
+                m_indices.data(), m_indices.size(), glm::value_ptr(modelViewProjection));
+            m_occlusionCuller.rasterize();
+        }
+
+        m_triangles.clear();
+        for (std::vector<uint32_t>& bin : m_tileBins) {
+            bin.clear();
+        }
+
+        const SoftwareBuffer* vertexBuffer = m_buffers.get(m_vertexBuffer);
+        const SoftwareBuffer* indexBuffer = m_buffers.get(m_indexBuffer);
+        const uint8_t* indices = indexBuffer->data.data();
+        drawTriangles(*vertexBuffer, 0, static_cast<uint32_t>(m_indices.size()),
+            [indices](uint32_t i) { return readIndex<uint16_t>(indices, i); }, glm::vec3(0.0f), m_shaderVariant, false);
+
+        executeCommandStreams();
+        rasterize();
+
+        present();
+        m_framePacer.onPresent();
+        m_frameArenas.endFrame();
+    }
+
+    bool SoftwareRenderer::saveFrame(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        file << "P6\n" << m_width << " " << m_height << "\n255\n";
+        std::vector<char> row(static_cast<size_t>(m_width) * 3);
+        for (uint32_t y = 0; y < m_height; y++) {
+            const uint32_t* pixels = m_colorBuffer.data() + static_cast<size_t>(y) * m_pitch;
+            for (uint32_t x = 0; x < m_width; x++) {
+                row[x * 3 + 0] = static_cast<char>((pixels[x] >> 16) & 0xFF);
+                row[x * 3 + 1] = static_cast<char>((pixels[x] >> 8) & 0xFF);
+                row[x * 3 + 2] = static_cast<char>(pixels[x] & 0xFF);
+            }
+            file.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+        return static_cast<bool>(file);
+    }
+
+    void SoftwareRenderer::cleanup() {
+        m_tileJobs.stop();
+
+        if (m_frameSurface) {
+            SDL_DestroySurface(m_frameSurface);
+            m_frameSurface = nullptr;
+        }
+        m_submittedStreams.clear();
+        m_buffers.clear();
+        m_pipelines.clear();
+        m_basicPipelines.clear();
+    }
+}
+#endif
@@ -2,6 +2,45 @@
 #include <renderer_vk.hpp>
 
 namespace Nashi {
+    static VkDescriptorType toVkDescriptorType(ReflectedDescriptorType type) {
+        switch (type) {
+        case ReflectedDescriptorType::UniformBuffer: return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        case ReflectedDescriptorType::StorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case ReflectedDescriptorType::ReadOnlyStorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case ReflectedDescriptorType::SampledImage: return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        case ReflectedDescriptorType::StorageImage: return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        case ReflectedDescriptorType::Sampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case ReflectedDescriptorType::CombinedImageSampler: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        throw std::runtime_error("unknown reflected descriptor type");
+    }
+
+    static VkShaderStageFlags toVkShaderStages(uint32_t stageMask) {
+        VkShaderStageFlags flags = 0;
+        if (stageMask & SHADER_STAGE_VERTEX) flags |= VK_SHADER_STAGE_VERTEX_BIT;
+        if (stageMask & SHADER_STAGE_FRAGMENT) flags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+        if (stageMask & SHADER_STAGE_COMPUTE) flags |= VK_SHADER_STAGE_COMPUTE_BIT;
+        return flags;
+    }
+
+    static VkFormat toVkFormat(ReflectedFormat format) {
+        switch (format) {
+        case ReflectedFormat::Float1: return VK_FORMAT_R32_SFLOAT;
+        case ReflectedFormat::Float2: return VK_FORMAT_R32G32_SFLOAT;
+        case ReflectedFormat::Float3: return VK_FORMAT_R32G32B32_SFLOAT;
+        case ReflectedFormat::Float4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+        case ReflectedFormat::Int1: return VK_FORMAT_R32_SINT;
+        case ReflectedFormat::Int2: return VK_FORMAT_R32G32_SINT;
+        case ReflectedFormat::Int3: return VK_FORMAT_R32G32B32_SINT;
+        case ReflectedFormat::Int4: return VK_FORMAT_R32G32B32A32_SINT;
+        case ReflectedFormat::UInt1: return VK_FORMAT_R32_UINT;
+        case ReflectedFormat::UInt2: return VK_FORMAT_R32G32_UINT;
+        case ReflectedFormat::UInt3: return VK_FORMAT_R32G32B32_UINT;
+        case ReflectedFormat::UInt4: return VK_FORMAT_R32G32B32A32_UINT;
+        default: throw std::runtime_error("unsupported vertex input format");
+        }
+    }
+
     VulkanRenderer::VulkanRenderer(const char** m_extraExtensions, int m_extraExtensionsCount, SDL_Window* window, SDL_Event event) {
         this->m_extraExtensions = m_extraExtensions;
         this->m_extraExtensionsCount = m_extraExtensionsCount;
@@ -19,7 +58,7 @@ namespace Nashi {
         appInfo.pApplicationName = "nashi";
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 1, 0);
         appInfo.engineVersion = VK_MAKE_VERSION(1, 1, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_1;
+        appInfo.apiVersion = VK_API_VERSION_1_3;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -119,6 +158,17 @@ namespace Nashi {
             return 0;
         }
 
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 deviceFeatures2{};
+        deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        deviceFeatures2.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_2 || !vulkan12Features.timelineSemaphore) {
+            return 0;
+        }
+
         if (!findQueueFamilies(device).isComplete()) {
             return 0;
         }
@@ -213,6 +263,23 @@ namespace Nashi {
             }
             i++;
         }
+
+        // A compute-only family usually maps to dedicated async compute
+        // hardware. Without one, a second queue of the graphics family still
+        // lets the scheduler interleave work, and sharing the graphics queue
+        // is the last resort.
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = family;
+                indices.computeQueueIndex = 0;
+                break;
+            }
+        }
+        if (!indices.computeFamily.has_value() && indices.graphicsFamily.has_value()) {
+            indices.computeFamily = indices.graphicsFamily;
+            indices.computeQueueIndex = queueFamilies[indices.graphicsFamily.value()].queueCount > 1 ? 1 : 0;
+        }
         return indices;
     }
 
@@ -220,15 +287,18 @@ namespace Nashi {
         QueueFamilyIndices indices = findQueueFamilies(m_vkPhysicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        std::map<uint32_t, uint32_t> queueCounts = { { indices.graphicsFamily.value(), 1 }, { indices.presentFamily.value(), 1 } };
+        uint32_t& computeCount = queueCounts[indices.computeFamily.value()];
+        computeCount = std::max(computeCount, indices.computeQueueIndex + 1);
 
         float queuePriority = 1.0f;
-        for (uint32_t queueFamily : uniqueQueueFamilies) {
+        float queuePriorities[] = { 1.0f, 1.0f };
+        for (const auto& [queueFamily, queueCount] : queueCounts) {
             VkDeviceQueueCreateInfo queueCreateInfo{};
             queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             queueCreateInfo.queueFamilyIndex = queueFamily;
-            queueCreateInfo.queueCount = 1;
-            queueCreateInfo.pQueuePriorities = &queuePriority;
+            queueCreateInfo.queueCount = queueCount;
+            queueCreateInfo.pQueuePriorities = queuePriorities;
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
@@ -238,16 +308,74 @@ namespace Nashi {
         queueCreateInfo.queueCount = 1;
         queueCreateInfo.pQueuePriorities = &queuePriority;
 
+        // Occlusion culling needs GPU-written draw counts and per-draw
+        // firstInstance, and indexes the pyramid's level views dynamically.
+        VkPhysicalDeviceVulkan12Features supported12Features{};
+        supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &supported12Features;
+
+        // 1.2 devices keep the render passes.
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &deviceProperties);
+        VkPhysicalDeviceVulkan13Features supported13Features{};
+        supported13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (deviceProperties.apiVersion >= VK_API_VERSION_1_3) {
+            supported12Features.pNext = &supported13Features;
+        }
+        vkGetPhysicalDeviceFeatures2(m_vkPhysicalDevice, &supportedFeatures);
+        m_vkDynamicRendering = m_dynamicRendering && supported13Features.dynamicRendering;
+
+        m_vkOcclusionCullingSupported = supported12Features.drawIndirectCount &&
+            supportedFeatures.features.multiDrawIndirect &&
+            supportedFeatures.features.drawIndirectFirstInstance &&
+            supportedFeatures.features.shaderStorageImageArrayDynamicIndexing;
+
         VkPhysicalDeviceFeatures deviceFeatures{};
+        deviceFeatures.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance;
+        deviceFeatures.shaderStorageImageArrayDynamicIndexing = supportedFeatures.features.shaderStorageImageArrayDynamicIndexing;
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.features.pipelineStatisticsQuery;
+        m_vkPipelineStatisticsSupported = supportedFeatures.features.pipelineStatisticsQuery;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+        vulkan12Features.drawIndirectCount = supported12Features.drawIndirectCount;
+
+        VkPhysicalDeviceVulkan13Features vulkan13Features{};
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        vulkan13Features.dynamicRendering = VK_TRUE;
+        if (m_vkDynamicRendering) {
+            vulkan12Features.pNext = &vulkan13Features;
+        }
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &vulkan12Features;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // Calibrated timestamps put GPU trace scopes on the CPU trace clock.
+        std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+        bool calibratedTimestamps = false;
+        if (TRACE_ENABLED) {
+            uint32_t extensionCount = 0;
+            vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+            for (const auto& extension : availableExtensions) {
+                if (strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0) {
+                    calibratedTimestamps = true;
+                    extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+                }
+            }
+        }
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -260,6 +388,45 @@ namespace Nashi {
         CHECK_VK(vkCreateDevice(m_vkPhysicalDevice, &createInfo, nullptr, &m_vkDevice));
         vkGetDeviceQueue(m_vkDevice, indices.graphicsFamily.value(), 0, &m_vkGraphicsQueue);
         vkGetDeviceQueue(m_vkDevice, indices.presentFamily.value(), 0, &m_vkPresentQueue);
+        vkGetDeviceQueue(m_vkDevice, indices.computeFamily.value(), indices.computeQueueIndex, &m_vkComputeQueue);
+
+        m_vkGraphicsFamily = indices.graphicsFamily.value();
+        m_vkComputeFamily = indices.computeFamily.value();
+
+        // The trace clock is steady_clock, which is CLOCK_MONOTONIC on Linux.
+        // Other platforms fall back to lining GPU scopes up at submit.
+        if (calibratedTimestamps) {
+            auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                vkGetInstanceProcAddr(m_vkInstance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+            uint32_t domainCount = 0;
+            std::vector<VkTimeDomainEXT> domains;
+            if (getTimeDomains) {
+                getTimeDomains(m_vkPhysicalDevice, &domainCount, nullptr);
+                domains.resize(domainCount);
+                getTimeDomains(m_vkPhysicalDevice, &domainCount, domains.data());
+            }
+            auto hasDomain = [&](VkTimeDomainEXT domain) {
+                return std::find(domains.begin(), domains.end(), domain) != domains.end();
+            };
+            if (hasDomain(VK_TIME_DOMAIN_DEVICE_EXT) && hasDomain(VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT)) {
+                m_vkGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+                    vkGetDeviceProcAddr(m_vkDevice, "vkGetCalibratedTimestampsEXT"));
+            }
+        }
+
+        if (m_vkComputeFamily != m_vkGraphicsFamily) {
+            std::cout << "async compute: dedicated queue family " << m_vkComputeFamily << std::endl;
+        }
+        else if (m_vkComputeQueue != m_vkGraphicsQueue) {
+            std::cout << "async compute: second graphics queue" << std::endl;
+        }
+        else {
+            std::cout << "async compute: sharing the graphics queue" << std::endl;
+        }
+
+        if (!m_vkOcclusionCullingSupported) {
+            std::cout << "occlusion culling: unsupported by the device" << std::endl;
+        }
     }
 
     VkSurfaceFormatKHR VulkanRenderer::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -273,12 +440,23 @@ namespace Nashi {
         return availableFormats[0];
     }
     VkPresentModeKHR VulkanRenderer::chooseSwapPresentMode(std::vector<VkPresentModeKHR>& availablePresentModes) {
+        VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+        switch (m_framePacer.policy().presentMode) {
+        case PresentMode::Immediate: requested = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+        case PresentMode::Mailbox: requested = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case PresentMode::Fifo: requested = VK_PRESENT_MODE_FIFO_KHR; break;
+        case PresentMode::FifoRelaxed: requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR; break;
+        }
+
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            if (availablePresentMode == requested) {
                 return availablePresentMode;
             }
         }
 
+        // FIFO is the only mode every implementation has to support.
+        std::cout << "present mode " << presentModeName(m_framePacer.policy().presentMode)
+            << " unsupported, using fifo" << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -346,7 +524,8 @@ namespace Nashi {
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        // Lets the driver hand over resources while the old images are still presented.
+        createInfo.oldSwapchain = m_vkSwapChain;
 
         CHECK_VK(vkCreateSwapchainKHR(m_vkDevice, &createInfo, nullptr, &m_vkSwapChain));
         vkGetSwapchainImagesKHR(m_vkDevice, m_vkSwapChain, &imageCount, nullptr);
@@ -381,6 +560,10 @@ namespace Nashi {
     }
 
     void VulkanRenderer::createRenderPass() {
+        if (m_vkDynamicRendering) {
+            return;
+        }
+
         VkAttachmentDescription colorAttachment{ };
         colorAttachment.format = m_vkSwapChainImageFormat;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -391,62 +574,191 @@ namespace Nashi {
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+        // Stored and left in the attachment layout: the depth pyramid is
+        // built from it and later passes of the frame load it again.
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = m_vkDepthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+        // The depth buffer is shared by all frames in flight: the clear
+        // waits for the previous frame's depth writes and pyramid build.
         VkSubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
         dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
 
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
         CHECK_VK(vkCreateRenderPass(m_vkDevice, &renderPassInfo, nullptr, &m_vkRenderPass));
+
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        CHECK_VK(vkCreateRenderPass(m_vkDevice, &renderPassInfo, nullptr, &m_vkLoadRenderPass));
+    }
+
+    VkDescriptorSetLayout VulkanRenderer::getDescriptorSetLayout(const ShaderReflection& reflection, uint32_t set) {
+        std::vector<uint32_t> key;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        for (const auto& binding : reflection.bindings) {
+            if (binding.set != set) {
+                continue;
+            }
+            key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.type), binding.count, binding.stageMask });
+
+            VkDescriptorSetLayoutBinding layoutBinding{};
+            layoutBinding.binding = binding.binding;
+            layoutBinding.descriptorType = toVkDescriptorType(binding.type);
+            layoutBinding.descriptorCount = binding.count;
+            layoutBinding.stageFlags = toVkShaderStages(binding.stageMask);
+            layoutBinding.pImmutableSamplers = nullptr;
+            bindings.push_back(layoutBinding);
+        }
+
+        auto cached = m_vkDescriptorSetLayoutCache.find(key);
+        if (cached != m_vkDescriptorSetLayoutCache.end()) {
+            return cached->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+        CHECK_VK(vkCreateDescriptorSetLayout(m_vkDevice, &layoutInfo, nullptr, &layout));
+        m_vkDescriptorSetLayoutCache.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    VkPipelineLayout VulkanRenderer::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+        const std::vector<ReflectedPushConstant>& pushConstants) {
+        std::vector<uint32_t> key;
+        for (VkDescriptorSetLayout setLayout : setLayouts) {
+            uint64_t handle = reinterpret_cast<uint64_t>(setLayout);
+            key.insert(key.end(), { static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32) });
+        }
+        std::vector<VkPushConstantRange> ranges;
+        for (const auto& pushConstant : pushConstants) {
+            key.insert(key.end(), { pushConstant.offset, pushConstant.size, pushConstant.stageMask });
+            ranges.push_back({ toVkShaderStages(pushConstant.stageMask), pushConstant.offset, pushConstant.size });
+        }
+
+        auto cached = m_vkPipelineLayoutCache.find(key);
+        if (cached != m_vkPipelineLayoutCache.end()) {
+            return cached->second;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(ranges.size());
+        pipelineLayoutInfo.pPushConstantRanges = ranges.data();
+
+        VkPipelineLayout layout;
+        CHECK_VK(vkCreatePipelineLayout(m_vkDevice, &pipelineLayoutInfo, nullptr, &layout));
+        m_vkPipelineLayoutCache.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    void VulkanRenderer::destroyLayoutCache() {
+        for (const auto& [key, layout] : m_vkPipelineLayoutCache) {
+            vkDestroyPipelineLayout(m_vkDevice, layout, nullptr);
+        }
+        m_vkPipelineLayoutCache.clear();
+
+        for (const auto& [key, layout] : m_vkDescriptorSetLayoutCache) {
+            vkDestroyDescriptorSetLayout(m_vkDevice, layout, nullptr);
+        }
+        m_vkDescriptorSetLayoutCache.clear();
+    }
+
+    void VulkanRenderer::createPipelineLayout() {
+        m_vkPipelineLayout = getPipelineLayout({ m_vkDescriptorSetLayout }, m_basicReflection.pushConstants);
     }
 
-    void VulkanRenderer::createGraphicsPipeline() {
-        std::filesystem::path vertShaderPath = std::filesystem::current_path() / "shaders" / "basic.vert.spv";
-        std::filesystem::path fragShaderPath = std::filesystem::current_path() / "shaders" / "basic.frag.spv";
-        auto vertShaderCode = readFile(vertShaderPath.string());
-        auto fragShaderCode = readFile(fragShaderPath.string());
+    // Every graphics pipeline pairs some vertex stage with basic.frag; the
+    // vertex layout comes from the given (merged) reflection.
+    VkPipeline VulkanRenderer::createGraphicsPipeline(uint32_t variantKey, const char* vertexStage,
+        const ShaderReflection& reflection, VkPipelineLayout layout, DepthPass pass) {
+        std::vector<char> vertShaderFile, fragShaderFile;
+        ShaderBlob vertShaderCode = loadShaderBlob(m_shaderLibrary, std::string(vertexStage) + ".spv", vertShaderFile);
 
         // TODO: Draw the rest of the owl .)
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        if (pass != DepthPass::Prepass) {
+            ShaderBlob fragShaderCode = loadShaderBlob(m_shaderLibrary, shaderVariantName("basic.frag", variantKey, ".spv"), fragShaderFile);
+            fragShaderModule = createShaderModule(fragShaderCode);
+        }
 
         VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
         vertShaderStageInfo.module = vertShaderModule;
         vertShaderStageInfo.pName = SHADER_ENTRY_POINT;
-        //vertShaderStageInfo.pSpecializationInfo = /**/; this is very useful for defining constants
+
+        SpecializationConstants fragConstants;
+        fragConstants.set(0, m_colorIntensity);
+        VkSpecializationInfo fragSpecialization = fragConstants.info();
 
         VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
         fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragShaderStageInfo.module = fragShaderModule;
         fragShaderStageInfo.pName = SHADER_ENTRY_POINT;
+        fragShaderStageInfo.pSpecializationInfo = &fragSpecialization;
 
         VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescription = Vertex::getAttributeDescriptions();
+        std::vector<uint32_t> attributeOffsets;
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = reflection.vertexLayout(attributeOffsets);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        std::vector<VkVertexInputAttributeDescription> attributeDescription;
+        for (size_t i = 0; i < reflection.vertexInputs.size(); i++) {
+            const auto& input = reflection.vertexInputs[i];
+            attributeDescription.push_back({ input.location, 0, toVkFormat(input.format), attributeOffsets[i] });
+        }
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -489,7 +801,7 @@ namespace Nashi {
         multisampling.alphaToOneEnable = VK_FALSE;
 
         VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        colorBlendAttachment.colorWriteMask = pass == DepthPass::Prepass ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
             VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
         colorBlendAttachment.blendEnable = VK_FALSE;
         colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
@@ -510,6 +822,18 @@ namespace Nashi {
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
 
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = pass == DepthPass::Shade ? VK_FALSE : VK_TRUE;
+        if (pass == DepthPass::Shade) {
+            depthStencil.depthCompareOp = m_reverseZ ? VK_COMPARE_OP_GREATER_OR_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
+        }
+        else {
+            depthStencil.depthCompareOp = m_reverseZ ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS;
+        }
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.stencilTestEnable = VK_FALSE;
 
         std::vector<VkDynamicState> dynamicStates = {
             VK_DYNAMIC_STATE_VIEWPORT,
@@ -521,77 +845,277 @@ namespace Nashi {
         dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
         dynamicState.pDynamicStates = dynamicStates.data();
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &m_vkDescriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-        CHECK_VK(vkCreatePipelineLayout(m_vkDevice, &pipelineLayoutInfo, nullptr, &m_vkPipelineLayout));
-
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
+        pipelineInfo.stageCount = pass == DepthPass::Prepass ? 1 : 2;
         pipelineInfo.pStages = shaderStages;
         pipelineInfo.pVertexInputState = &vertexInputInfo;
         pipelineInfo.pInputAssemblyState = &inputAssembly;
         pipelineInfo.pViewportState = &viewportState;
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = nullptr;
+        pipelineInfo.pDepthStencilState = &depthStencil;
         pipelineInfo.pColorBlendState = &colorBlending;
         pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = m_vkPipelineLayout;
+        pipelineInfo.layout = layout;
         pipelineInfo.renderPass = m_vkRenderPass;
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.basePipelineIndex = -1;
 
-        CHECK_VK(vkCreateGraphicsPipelines(m_vkDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_vkGraphicsPipeline));
+        VkPipelineRenderingCreateInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &m_vkSwapChainImageFormat;
+        renderingInfo.depthAttachmentFormat = m_vkDepthFormat;
+        if (m_vkDynamicRendering) {
+            pipelineInfo.pNext = &renderingInfo;
+        }
+
+        VkPipeline pipeline;
+        CHECK_VK(vkCreateGraphicsPipelines(m_vkDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
 
         vkDestroyShaderModule(m_vkDevice, fragShaderModule, nullptr);
         vkDestroyShaderModule(m_vkDevice, vertShaderModule, nullptr);
+        return pipeline;
     }
 
-    void VulkanRenderer::createDescriptorSetLayout() {
-        VkDescriptorSetLayoutBinding uboLayoutBinding{};
-        uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboLayoutBinding.pImmutableSamplers = nullptr;
+    PipelineHandle VulkanRenderer::basicPipeline(uint32_t variantKey) {
+        return basicPipeline(variantKey, DepthPass::Single);
+    }
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = 1;
-        layoutInfo.pBindings = &uboLayoutBinding;
+    // Variants are built on first use and kept, so switching keys is a lookup.
+    PipelineHandle VulkanRenderer::basicPipeline(uint32_t variantKey, DepthPass pass) {
+        const uint32_t key = depthPipelineKey(variantKey, pass);
+        auto cached = m_vkBasicPipelines.find(key);
+        if (cached != m_vkBasicPipelines.end()) {
+            return cached->second;
+        }
 
-        CHECK_VK(vkCreateDescriptorSetLayout(m_vkDevice, &layoutInfo, nullptr, &m_vkDescriptorSetLayout));
+        VulkanPipeline pipeline{};
+        pipeline.pipeline = createGraphicsPipeline(variantKey, "basic.vert", m_basicReflection, m_vkPipelineLayout, pass);
+        pipeline.layout = m_vkPipelineLayout;
+        pipeline.bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        for (const auto& pushConstant : m_basicReflection.pushConstants) {
+            pipeline.pushConstantStages |= toVkShaderStages(pushConstant.stageMask);
+            pipeline.pushConstantSize = std::max(pipeline.pushConstantSize, pushConstant.offset + pushConstant.size);
+        }
+        pipeline.frameDescriptorSets = &m_vkDescriptorSets;
+
+        PipelineHandle handle = m_vkPipelines.create(pipeline);
+        m_vkBasicPipelines.emplace(key, handle);
+        return handle;
+    }
+
+    VkPipeline VulkanRenderer::getBasicPipeline(uint32_t variantKey, DepthPass pass) {
+        return m_vkPipelines.get(basicPipeline(variantKey, pass))->pipeline;
+    }
+
+    // Push constants are undefined until pushed, and basic.vert reads its
+    // per-draw constants on every draw.
+    void VulkanRenderer::zeroPushConstants(VkCommandBuffer commandBuffer, const VulkanPipeline& pipeline) {
+        if (pipeline.pushConstantSize == 0) {
+            return;
+        }
+        const uint8_t zeros[MAX_COMMAND_CONSTANTS_SIZE] = {};
+        vkCmdPushConstants(commandBuffer, pipeline.layout, pipeline.pushConstantStages, 0,
+            std::min(pipeline.pushConstantSize, MAX_COMMAND_CONSTANTS_SIZE), zeros);
+    }
+
+    // hiz.comp and cull.comp read the depth direction from constant 0.
+    SpecializationConstants VulkanRenderer::depthConstants() const {
+        SpecializationConstants constants;
+        constants.set(0, static_cast<VkBool32>(m_reverseZ));
+        return constants;
+    }
+
+    VkPipeline VulkanRenderer::createComputePipeline(const char* stage, VkPipelineLayout layout,
+        const SpecializationConstants& constants) {
+        std::vector<char> shaderFile;
+        ShaderBlob shaderCode = loadShaderBlob(m_shaderLibrary, std::string(stage) + ".spv", shaderFile);
+        VkShaderModule shaderModule = createShaderModule(shaderCode);
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = SHADER_ENTRY_POINT;
+        VkSpecializationInfo specialization = constants.info();
+        pipelineInfo.stage.pSpecializationInfo = &specialization;
+        pipelineInfo.layout = layout;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        VkPipeline pipeline;
+        CHECK_VK(vkCreateComputePipelines(m_vkDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+
+        vkDestroyShaderModule(m_vkDevice, shaderModule, nullptr);
+        return pipeline;
     }
 
-    VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code) {
+    PipelineHandle VulkanRenderer::scenePipeline(uint32_t variantKey, DepthPass pass) {
+        const uint32_t key = depthPipelineKey(variantKey, pass);
+        auto cached = m_vkScenePipelines.find(key);
+        if (cached != m_vkScenePipelines.end()) {
+            return cached->second;
+        }
+
+        VulkanPipeline pipeline{};
+        pipeline.pipeline = createGraphicsPipeline(variantKey, "scene.vert", m_sceneReflection, m_vkScenePipelineLayout, pass);
+        pipeline.layout = m_vkScenePipelineLayout;
+        pipeline.bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        pipeline.frameDescriptorSets = &m_vkSceneDescriptorSets;
+
+        PipelineHandle handle = m_vkPipelines.create(pipeline);
+        m_vkScenePipelines.emplace(key, handle);
+        return handle;
+    }
+
+    void VulkanRenderer::createCullingPipelines() {
+        m_sceneReflection = loadShaderReflection(m_shaderLibrary, "scene.vert");
+        m_sceneReflection.merge(loadShaderReflection(m_shaderLibrary, "basic.frag"));
+        m_cullReflection = loadShaderReflection(m_shaderLibrary, "cull.comp");
+        m_hizReflection = loadShaderReflection(m_shaderLibrary, "hiz.comp");
+
+        m_vkScenePipelineLayout = getPipelineLayout({ getDescriptorSetLayout(m_sceneReflection, 0) }, m_sceneReflection.pushConstants);
+        m_vkCullPipelineLayout = getPipelineLayout({ getDescriptorSetLayout(m_cullReflection, 0) }, m_cullReflection.pushConstants);
+        m_vkHiZPipelineLayout = getPipelineLayout({ getDescriptorSetLayout(m_hizReflection, 0) }, m_hizReflection.pushConstants);
+
+        VulkanPipeline cull{};
+        cull.pipeline = createComputePipeline("cull.comp", m_vkCullPipelineLayout, depthConstants());
+        cull.layout = m_vkCullPipelineLayout;
+        cull.bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+        cull.pushConstantStages = VK_SHADER_STAGE_COMPUTE_BIT;
+        cull.frameDescriptorSets = &m_vkCullDescriptorSets;
+        m_vkCullPipeline = m_vkPipelines.create(cull);
+
+        VulkanPipeline hiz{};
+        hiz.pipeline = createComputePipeline("hiz.comp", m_vkHiZPipelineLayout, depthConstants());
+        hiz.layout = m_vkHiZPipelineLayout;
+        hiz.bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+        hiz.pushConstantStages = VK_SHADER_STAGE_COMPUTE_BIT;
+        m_vkHiZPipeline = m_vkPipelines.create(hiz);
+    }
+
+    void VulkanRenderer::createDescriptorSetLayout() {
+        m_basicReflection = loadShaderReflection(m_shaderLibrary, "basic.vert");
+        m_basicReflection.merge(loadShaderReflection(m_shaderLibrary, "basic.frag"));
+
+        m_vkDescriptorSetLayout = getDescriptorSetLayout(m_basicReflection, 0);
+    }
+
+    VkShaderModule VulkanRenderer::createShaderModule(const ShaderBlob& code) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = code.size;
+        createInfo.pCode = static_cast<const uint32_t*>(code.data);
 
         VkShaderModule shaderModule;
         CHECK_VK(vkCreateShaderModule(m_vkDevice, &createInfo, nullptr, &shaderModule));
         return shaderModule;
     }
 
+    // Both candidates are required to support sampling; the pyramid build
+    // reads the depth buffer directly.
+    VkFormat VulkanRenderer::findDepthFormat() {
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }) {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(m_vkPhysicalDevice, format, &properties);
+            if ((properties.optimalTilingFeatures & required) == required) {
+                return format;
+            }
+        }
+        throw std::runtime_error("failed to find a sampleable depth format!");
+    }
+
+    static uint32_t previousPowerOfTwo(uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    // Depth buffer and its max-depth pyramid, both sized to the swapchain.
+    // The pyramid's first level is the largest power of two that fits, so
+    // every level halves exactly.
+    void VulkanRenderer::createDepthResources() {
+        m_vkDepthFormat = findDepthFormat();
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = m_vkDepthFormat;
+        imageInfo.extent = { m_vkSwapChainExtent.width, m_vkSwapChainExtent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_vkDepthImage = createImage(imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+        m_vkDepthPyramidExtent = { previousPowerOfTwo(m_vkSwapChainExtent.width), previousPowerOfTwo(m_vkSwapChainExtent.height) };
+        m_vkDepthPyramidLevels = 1;
+        while (m_vkDepthPyramidLevels < HIZ_MAX_LEVELS &&
+            std::max(m_vkDepthPyramidExtent.width, m_vkDepthPyramidExtent.height) >> m_vkDepthPyramidLevels) {
+            m_vkDepthPyramidLevels++;
+        }
+
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.extent = { m_vkDepthPyramidExtent.width, m_vkDepthPyramidExtent.height, 1 };
+        imageInfo.mipLevels = m_vkDepthPyramidLevels;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        m_vkDepthPyramid = createImage(imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_vkDepthPyramidInitialized = false;
+
+        m_vkDepthPyramidLevelViews.resize(m_vkDepthPyramidLevels);
+        for (uint32_t level = 0; level < m_vkDepthPyramidLevels; level++) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = m_vkImages.get(m_vkDepthPyramid)->image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = VK_FORMAT_R32_SFLOAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+            CHECK_VK(vkCreateImageView(m_vkDevice, &viewInfo, nullptr, &m_vkDepthPyramidLevelViews[level]));
+        }
+    }
+
+    void VulkanRenderer::destroyDepthResources() {
+        destroyImage(m_vkDepthImage);
+        destroyImage(m_vkDepthPyramid);
+        deferDestroy([views = std::move(m_vkDepthPyramidLevelViews)](VkDevice device) {
+            for (VkImageView view : views) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+        });
+        m_vkDepthPyramidLevelViews.clear();
+    }
+
     void VulkanRenderer::createFramebuffers() {
+        if (m_vkDynamicRendering) {
+            return;
+        }
+
         m_vkSwapChainFramebuffers.resize(m_vkSwapChainImageViews.size());
 
         for (size_t i = 0; i < m_vkSwapChainImageViews.size(); i++) {
             VkImageView attachments[] = {
-                m_vkSwapChainImageViews[i]
+                m_vkSwapChainImageViews[i],
+                m_vkImages.get(m_vkDepthImage)->view
             };
 
             VkFramebufferCreateInfo framebufferInfo{};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             framebufferInfo.renderPass = m_vkRenderPass;
-            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.attachmentCount = 2;
             framebufferInfo.pAttachments = attachments;
             framebufferInfo.width = m_vkSwapChainExtent.width;
             framebufferInfo.height = m_vkSwapChainExtent.height;
@@ -621,11 +1145,120 @@ namespace Nashi {
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
         CHECK_VK(vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &bufferMemory));
+        m_vkFrameStats.allocations++;
 
         vkBindBufferMemory(m_vkDevice, buffer, bufferMemory, 0);
 
     }
 
+    BufferHandle VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+        VulkanBuffer buffer{};
+        buffer.size = size;
+        createBuffer(size, usage, properties, buffer.buffer, buffer.memory);
+
+        if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            CHECK_VK(vkMapMemory(m_vkDevice, buffer.memory, 0, size, 0, &buffer.mapped));
+        }
+        return m_vkBuffers.create(buffer);
+    }
+
+    void VulkanRenderer::destroyBuffer(BufferHandle handle) {
+        if (std::optional<VulkanBuffer> buffer = m_vkBuffers.remove(handle)) {
+            deferDestroy([buffer = *buffer](VkDevice device) {
+                vkDestroyBuffer(device, buffer.buffer, nullptr);
+                vkFreeMemory(device, buffer.memory, nullptr);
+            });
+        }
+    }
+
+    ImageHandle VulkanRenderer::createImage(const VkImageCreateInfo& imageInfo, VkImageAspectFlags aspect) {
+        VulkanImage image{};
+        image.format = imageInfo.format;
+        image.extent = imageInfo.extent;
+        CHECK_VK(vkCreateImage(m_vkDevice, &imageInfo, nullptr, &image.image));
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_vkDevice, image.image, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        CHECK_VK(vkAllocateMemory(m_vkDevice, &allocInfo, nullptr, &image.memory));
+        m_vkFrameStats.allocations++;
+        CHECK_VK(vkBindImageMemory(m_vkDevice, image.image, image.memory, 0));
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image.image;
+        viewInfo.viewType = imageInfo.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange.aspectMask = aspect;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = imageInfo.arrayLayers;
+
+        CHECK_VK(vkCreateImageView(m_vkDevice, &viewInfo, nullptr, &image.view));
+        return m_vkImages.create(image);
+    }
+
+    void VulkanRenderer::destroyImage(ImageHandle handle) {
+        if (std::optional<VulkanImage> image = m_vkImages.remove(handle)) {
+            deferDestroy([image = *image](VkDevice device) {
+                vkDestroyImageView(device, image.view, nullptr);
+                vkDestroyImage(device, image.image, nullptr);
+                vkFreeMemory(device, image.memory, nullptr);
+            });
+        }
+    }
+
+    SamplerHandle VulkanRenderer::createSampler(const VkSamplerCreateInfo& samplerInfo) {
+        VkSampler sampler;
+        CHECK_VK(vkCreateSampler(m_vkDevice, &samplerInfo, nullptr, &sampler));
+        return m_vkSamplers.create(sampler);
+    }
+
+    void VulkanRenderer::destroySampler(SamplerHandle handle) {
+        if (std::optional<VkSampler> sampler = m_vkSamplers.remove(handle)) {
+            deferDestroy([sampler = *sampler](VkDevice device) {
+                vkDestroySampler(device, sampler, nullptr);
+            });
+        }
+    }
+
+    void VulkanRenderer::destroyPipeline(PipelineHandle handle) {
+        if (std::optional<VulkanPipeline> pipeline = m_vkPipelines.remove(handle)) {
+            deferDestroy([pipeline = pipeline->pipeline](VkDevice device) {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            });
+        }
+    }
+
+    // Only valid once the device is idle; ignores handles still held elsewhere.
+    void VulkanRenderer::destroyResourcePools() {
+        for (const VulkanBuffer& buffer : m_vkBuffers) {
+            vkDestroyBuffer(m_vkDevice, buffer.buffer, nullptr);
+            vkFreeMemory(m_vkDevice, buffer.memory, nullptr);
+        }
+        for (const VulkanImage& image : m_vkImages) {
+            vkDestroyImageView(m_vkDevice, image.view, nullptr);
+            vkDestroyImage(m_vkDevice, image.image, nullptr);
+            vkFreeMemory(m_vkDevice, image.memory, nullptr);
+        }
+        for (VkSampler sampler : m_vkSamplers) {
+            vkDestroySampler(m_vkDevice, sampler, nullptr);
+        }
+        for (const VulkanPipeline& pipeline : m_vkPipelines) {
+            vkDestroyPipeline(m_vkDevice, pipeline.pipeline, nullptr);
+        }
+        m_vkBuffers.clear();
+        m_vkImages.clear();
+        m_vkSamplers.clear();
+        m_vkPipelines.clear();
+    }
+
     void VulkanRenderer::createCombinedBuffer() {
         m_vkVertexBufferSize = sizeof(m_vertices[0]) * m_vertices.size();
         VkDeviceSize indexBufferSize = sizeof(m_indices[0]) * m_indices.size();
@@ -644,16 +1277,15 @@ namespace Nashi {
         memcpy(data, m_vertices.data(), static_cast<size_t>(m_vkVertexBufferSize));
         memcpy(static_cast<char*>(data) + m_vkVertexBufferSize, m_indices.data(), static_cast<size_t>(indexBufferSize));
         vkUnmapMemory(m_vkDevice, stagingBufferMemory);
+        m_vkFrameStats.bytesUploaded += bufferSize;
 
         // Create device local combined buffer
-        createBuffer(bufferSize,
+        m_vkCombinedBuffer = createBuffer(bufferSize,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            m_vkCombinedBuffer,
-            m_vkCombinedBufferMemory);
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         // Copy staging buffer data to device local buffer
-        copyBuffer(stagingBuffer, m_vkCombinedBuffer, bufferSize);
+        copyBuffer(stagingBuffer, m_vkBuffers.get(m_vkCombinedBuffer)->buffer, bufferSize);
 
         // Clean up staging resources
         vkDestroyBuffer(m_vkDevice, stagingBuffer, nullptr);
@@ -665,28 +1297,26 @@ namespace Nashi {
         VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
         m_vkUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        m_vkUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        m_vkUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_vkUniformBuffers[i], m_vkUniformBuffersMemory[i]);
-            
-            vkMapMemory(m_vkDevice, m_vkUniformBuffersMemory[i], 0, bufferSize, 0, &m_vkUniformBuffersMapped[i]);
-
+            m_vkUniformBuffers[i] = createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
         }
     }
 
     void VulkanRenderer::createDescriptorPool() {
-        VkDescriptorPoolSize poolSize{};
-        poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto& binding : m_basicReflection.bindings) {
+            VkDescriptorPoolSize poolSize{};
+            poolSize.type = toVkDescriptorType(binding.type);
+            poolSize.descriptorCount = binding.count * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+            poolSizes.push_back(poolSize);
+        }
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = 1;
-        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
         poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
         CHECK_VK(vkCreateDescriptorPool(m_vkDevice, &poolInfo, nullptr, &m_vkDescriptorPool));
@@ -707,7 +1337,7 @@ namespace Nashi {
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = m_vkUniformBuffers[i];
+            bufferInfo.buffer = m_vkBuffers.get(m_vkUniformBuffers[i])->buffer;
             bufferInfo.offset = 0;
             bufferInfo.range = sizeof(UniformBufferObject);
 
@@ -722,24 +1352,152 @@ namespace Nashi {
             descriptorWrite.pImageInfo = nullptr;
             descriptorWrite.pTexelBufferView = nullptr;
             vkUpdateDescriptorSets(m_vkDevice, 1, &descriptorWrite, 0, nullptr);
+            m_vkFrameStats.descriptorUpdates++;
         }
     }
 
-    void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = m_vkCommandPool;
-        allocInfo.commandBufferCount = 1;
+    // A dense grid of small cubes, so most of it hides behind its outer layers.
+    void VulkanRenderer::createScene() {
+        const int gridSize = 16;
+        const float cubeSize = 0.1f;
+        const float spacing = 0.12f;
+        const float cubeRadius = 0.5f * std::sqrt(3.0f) * cubeSize;
+
+        m_sceneObjects.clear();
+        m_sceneObjects.reserve(gridSize * gridSize * gridSize);
+        for (int z = 0; z < gridSize; z++) {
+            for (int y = 0; y < gridSize; y++) {
+                for (int x = 0; x < gridSize; x++) {
+                    glm::vec3 center = (glm::vec3(x, y, z) - 0.5f * (gridSize - 1)) * spacing;
+                    SceneObject object{};
+                    object.transform = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(cubeSize));
+                    object.boundingSphere = glm::vec4(center, cubeRadius);
+                    m_sceneObjects.push_back(object);
+                }
+            }
+        }
 
-        VkCommandBuffer commandBuffer;
-        CHECK_VK(vkAllocateCommandBuffers(m_vkDevice, &allocInfo, &commandBuffer));
+        uint32_t objectCount = static_cast<uint32_t>(m_sceneObjects.size());
+        std::vector<uint32_t> zeros(std::max<size_t>(objectCount, 2), 0);
 
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        BufferDesc desc{};
+        desc.size = sizeof(SceneObject) * objectCount;
+        desc.usage = BUFFER_USAGE_STORAGE;
+        desc.initialData = m_sceneObjects.data();
+        m_vkSceneObjectBuffer = createBuffer(desc);
 
-        CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        // Nothing counts as visible at first; the first frame draws
+        // everything in the second phase.
+        desc.size = sizeof(uint32_t) * objectCount;
+        desc.initialData = zeros.data();
+        m_vkVisibilityBuffer = createBuffer(desc);
+
+        desc.size = sizeof(uint32_t);
+        m_vkHiZCounterBuffer = createBuffer(desc);
+
+        desc.size = 2 * sizeof(VkDrawIndexedIndirectCommand) * objectCount;
+        desc.usage = BUFFER_USAGE_STORAGE | BUFFER_USAGE_INDIRECT;
+        desc.initialData = nullptr;
+        m_vkDrawCommandBuffer = createBuffer(desc);
+
+        desc.size = 2 * sizeof(uint32_t);
+        desc.usage = BUFFER_USAGE_STORAGE | BUFFER_USAGE_INDIRECT | BUFFER_USAGE_COPY_DST;
+        m_vkDrawCountBuffer = createBuffer(desc);
+    }
+
+    void VulkanRenderer::createCullingDescriptorSets() {
+        const uint32_t frameCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        auto addPoolSizes = [&poolSizes](const ShaderReflection& reflection, uint32_t setCount) {
+            for (const auto& binding : reflection.bindings) {
+                poolSizes.push_back({ toVkDescriptorType(binding.type), binding.count * setCount });
+            }
+        };
+        addPoolSizes(m_sceneReflection, frameCount);
+        addPoolSizes(m_cullReflection, frameCount);
+        addPoolSizes(m_hizReflection, 1);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = 2 * frameCount + 1;
+        CHECK_VK(vkCreateDescriptorPool(m_vkDevice, &poolInfo, nullptr, &m_vkCullingDescriptorPool));
+
+        std::vector<VkDescriptorSetLayout> layouts(frameCount, getDescriptorSetLayout(m_sceneReflection, 0));
+        layouts.insert(layouts.end(), frameCount, getDescriptorSetLayout(m_cullReflection, 0));
+        layouts.push_back(getDescriptorSetLayout(m_hizReflection, 0));
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_vkCullingDescriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        std::vector<VkDescriptorSet> sets(layouts.size());
+        CHECK_VK(vkAllocateDescriptorSets(m_vkDevice, &allocInfo, sets.data()));
+        m_vkSceneDescriptorSets.assign(sets.begin(), sets.begin() + frameCount);
+        m_vkCullDescriptorSets.assign(sets.begin() + frameCount, sets.begin() + 2 * frameCount);
+        m_vkHiZDescriptorSet = sets.back();
+
+        auto bufferInfo = [this](BufferHandle handle) {
+            return VkDescriptorBufferInfo{ m_vkBuffers.get(handle)->buffer, 0, VK_WHOLE_SIZE };
+        };
+        VkDescriptorBufferInfo objects = bufferInfo(m_vkSceneObjectBuffer);
+        VkDescriptorBufferInfo visibility = bufferInfo(m_vkVisibilityBuffer);
+        VkDescriptorBufferInfo drawCommands = bufferInfo(m_vkDrawCommandBuffer);
+        VkDescriptorBufferInfo drawCounts = bufferInfo(m_vkDrawCountBuffer);
+        VkDescriptorBufferInfo counter = bufferInfo(m_vkHiZCounterBuffer);
+
+        VkDescriptorImageInfo depth{ VK_NULL_HANDLE, m_vkImages.get(m_vkDepthImage)->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo pyramid{ VK_NULL_HANDLE, m_vkImages.get(m_vkDepthPyramid)->view, VK_IMAGE_LAYOUT_GENERAL };
+        // Slots past the last level are never written, but must hold a valid view.
+        VkDescriptorImageInfo pyramidLevels[HIZ_MAX_LEVELS];
+        for (uint32_t level = 0; level < HIZ_MAX_LEVELS; level++) {
+            VkImageView view = m_vkDepthPyramidLevelViews[std::min(level, m_vkDepthPyramidLevels - 1)];
+            pyramidLevels[level] = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+        }
+
+        std::vector<VkWriteDescriptorSet> writes;
+        auto write = [&writes](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, uint32_t count,
+            const VkDescriptorBufferInfo* buffer, const VkDescriptorImageInfo* image) {
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = set;
+            descriptorWrite.dstBinding = binding;
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = type;
+            descriptorWrite.descriptorCount = count;
+            descriptorWrite.pBufferInfo = buffer;
+            descriptorWrite.pImageInfo = image;
+            writes.push_back(descriptorWrite);
+        };
+
+        std::vector<VkDescriptorBufferInfo> uniforms(frameCount);
+        for (uint32_t i = 0; i < frameCount; i++) {
+            uniforms[i] = { m_vkBuffers.get(m_vkUniformBuffers[i])->buffer, 0, sizeof(UniformBufferObject) };
+
+            write(m_vkSceneDescriptorSets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniforms[i], nullptr);
+            write(m_vkSceneDescriptorSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &objects, nullptr);
+
+            write(m_vkCullDescriptorSets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniforms[i], nullptr);
+            write(m_vkCullDescriptorSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &objects, nullptr);
+            write(m_vkCullDescriptorSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &visibility, nullptr);
+            write(m_vkCullDescriptorSets[i], 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &drawCommands, nullptr);
+            write(m_vkCullDescriptorSets[i], 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &drawCounts, nullptr);
+            write(m_vkCullDescriptorSets[i], 5, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, nullptr, &pyramid);
+        }
+        write(m_vkHiZDescriptorSet, 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, nullptr, &depth);
+        write(m_vkHiZDescriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &counter, nullptr);
+        write(m_vkHiZDescriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, HIZ_MAX_LEVELS, nullptr, pyramidLevels);
+
+        vkUpdateDescriptorSets(m_vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        m_vkFrameStats.descriptorUpdates += writes.size();
+    }
+
+    void VulkanRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+        VkCommandBuffer commandBuffer = beginOneTimeCommands(m_vkCommandPool);
 
         VkBufferCopy copyRegion{};
         copyRegion.size = size;
@@ -747,13 +1505,8 @@ namespace Nashi {
 
         vkEndCommandBuffer(commandBuffer);
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(m_vkGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(m_vkGraphicsQueue);
+        uint64_t copyDone = submitToQueue(m_vkGraphicsTimeline, { &commandBuffer, 1 }, {}, {});
+        waitForTimeline(m_vkGraphicsTimeline, copyDone);
 
         vkFreeCommandBuffers(m_vkDevice, m_vkCommandPool, 1, &commandBuffer);
     }
@@ -783,6 +1536,11 @@ namespace Nashi {
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
         CHECK_VK(vkCreateCommandPool(m_vkDevice, &poolInfo, nullptr, &m_vkCommandPool));
+
+        // Compute command buffers are recorded once per job and freed on completion.
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+        CHECK_VK(vkCreateCommandPool(m_vkDevice, &poolInfo, nullptr, &m_vkComputeCommandPool));
     }
 
     void VulkanRenderer::createCommandBuffers() {
@@ -798,6 +1556,8 @@ namespace Nashi {
     }
 
     void VulkanRenderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        NASHI_TRACE_SCOPE("VulkanRenderer::recordCommandBuffer");
+
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = 0;
@@ -805,25 +1565,29 @@ namespace Nashi {
 
         CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_vkRenderPass;
-        renderPassInfo.framebuffer = m_vkSwapChainFramebuffers[imageIndex];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = m_vkSwapChainExtent;
+        recordPendingGraphicsAcquires(commandBuffer);
 
-        VkClearValue clearColor = { {
-                srgbToLinear(129.0f / 255.0f),
-                srgbToLinear(186.0f / 255.0f), 
-                srgbToLinear(219.0f / 255.0f), 1.0f 
-        } };
+        if (m_vkTimestampPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, m_vkTimestampPool, currentFrame * 2 * GPU_TRACE_MAX_SCOPES, 2 * GPU_TRACE_MAX_SCOPES);
+        }
+        const uint32_t frameScope = beginGpuScope(commandBuffer, "Frame");
+        if (m_vkStatisticsPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, m_vkStatisticsPool, currentFrame, 1);
+            vkCmdBeginQuery(commandBuffer, m_vkStatisticsPool, currentFrame, 0);
+        }
 
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+        const bool occlusionCulling = m_occlusionCulling && m_vkOcclusionCullingSupported;
+        if (occlusionCulling) {
+            uint32_t scope = beginGpuScope(commandBuffer, "Culling");
+            recordCulling(commandBuffer, 0);
+            endGpuScope(commandBuffer, scope);
+        }
 
-        vkCmdBeginRenderPass(m_vkCommandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        beginFramePass(commandBuffer, imageIndex, true);
+        uint32_t passScope = beginGpuScope(commandBuffer, "Scene");
 
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
+        m_vkFrameStats.pipelineBinds++;
 
         VkViewport viewport{};
         viewport.x = 0.0f;
@@ -843,37 +1607,631 @@ namespace Nashi {
         VkDeviceSize indexOffset = m_vkVertexBufferSize;
 
 
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vkCombinedBuffer, &vertexOffset);
+        VkBuffer combinedBuffer = m_vkBuffers.get(m_vkCombinedBuffer)->buffer;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &combinedBuffer, &vertexOffset);
 
-        vkCmdBindIndexBuffer(commandBuffer, m_vkCombinedBuffer, indexOffset, VK_INDEX_TYPE_UINT16);
+        vkCmdBindIndexBuffer(commandBuffer, combinedBuffer, indexOffset, VK_INDEX_TYPE_UINT16);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
-            0, 1, &m_vkDescriptorSets[currentFrame], 0, nullptr);
+        if (occlusionCulling) {
+            recordSceneDraws(commandBuffer, 0);
+            endGpuScope(commandBuffer, passScope);
+            endFramePass(commandBuffer);
 
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+            uint32_t scope = beginGpuScope(commandBuffer, "Depth pyramid");
+            recordDepthPyramid(commandBuffer);
+            endGpuScope(commandBuffer, scope);
+            scope = beginGpuScope(commandBuffer, "Culling (late)");
+            recordCulling(commandBuffer, 1);
+            endGpuScope(commandBuffer, scope);
 
-        vkCmdEndRenderPass(commandBuffer);
+            beginFramePass(commandBuffer, imageIndex, false);
+            passScope = beginGpuScope(commandBuffer, "Scene (late)");
+            recordSceneDraws(commandBuffer, 1);
+        }
+        else {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkPipelineLayout,
+                0, 1, &m_vkDescriptorSets[currentFrame], 0, nullptr);
+            m_vkFrameStats.descriptorBinds++;
+            // Every basic pipeline shares m_vkPipelineLayout.
+            zeroPushConstants(commandBuffer, *m_vkPipelines.get(basicPipeline(0, DepthPass::Single)));
+
+            if (m_depthPrepass) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getBasicPipeline(0, DepthPass::Prepass));
+                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_vkGraphicsPipeline);
+                m_vkFrameStats.pipelineBinds += 2;
+                m_vkFrameStats.addDraw(m_indices.size(), 1);
+            }
+            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+            m_vkFrameStats.addDraw(m_indices.size(), 1);
+        }
+        endGpuScope(commandBuffer, passScope);
+
+        const uint32_t streamScope = beginGpuScope(commandBuffer, "Command streams");
+        executeCommandStreams(commandBuffer, imageIndex);
+        endGpuScope(commandBuffer, streamScope);
+        endGpuScope(commandBuffer, frameScope);
+        if (m_vkStatisticsPool != VK_NULL_HANDLE) {
+            vkCmdEndQuery(commandBuffer, m_vkStatisticsPool, currentFrame);
+            m_vkStatisticsPending[currentFrame] = true;
+        }
 
         CHECK_VK(vkEndCommandBuffer(commandBuffer));
     }
 
+    void VulkanRenderer::createTimestampQueries() {
+        if (!TRACE_ENABLED) {
+            return;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &properties);
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &familyCount, families.data());
+
+        const uint32_t validBits = families[m_vkGraphicsFamily].timestampValidBits;
+        if (validBits == 0) {
+            return;
+        }
+        m_vkTimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        m_vkTimestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2 * GPU_TRACE_MAX_SCOPES;
+        CHECK_VK(vkCreateQueryPool(m_vkDevice, &poolInfo, nullptr, &m_vkTimestampPool));
+
+        for (auto& scopes : m_vkGpuScopes) {
+            scopes.reserve(GPU_TRACE_MAX_SCOPES);
+        }
+        m_gpuTraceTrack = &createTraceTrack("GPU graphics queue");
+    }
+
+    void VulkanRenderer::createStatisticsQueries() {
+        if (!m_vkPipelineStatisticsSupported) {
+            return;
+        }
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+        poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+        CHECK_VK(vkCreateQueryPool(m_vkDevice, &poolInfo, nullptr, &m_vkStatisticsPool));
+    }
+
+    // Same timing as collectGpuScopes(). The counters arrive in bit order.
+    void VulkanRenderer::collectPipelineStatistics() {
+        if (!m_vkStatisticsPending[currentFrame]) {
+            return;
+        }
+        m_vkStatisticsPending[currentFrame] = false;
+
+        uint64_t counters[3];
+        if (vkGetQueryPoolResults(m_vkDevice, m_vkStatisticsPool, currentFrame, 1, sizeof(counters), counters,
+            sizeof(counters), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            m_vkFrameStats.vertexInvocations = counters[0];
+            m_vkFrameStats.fragmentInvocations = counters[1];
+            m_vkFrameStats.computeInvocations = counters[2];
+            m_vkFrameStats.gpuCountersValid = true;
+        }
+    }
+
+    uint32_t VulkanRenderer::beginGpuScope(VkCommandBuffer commandBuffer, const char* name) {
+        std::vector<const char*>& scopes = m_vkGpuScopes[currentFrame];
+        if (m_vkTimestampPool == VK_NULL_HANDLE || scopes.size() == GPU_TRACE_MAX_SCOPES) {
+            return UINT32_MAX;
+        }
+        const uint32_t scope = static_cast<uint32_t>(scopes.size());
+        scopes.push_back(name);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vkTimestampPool,
+            (currentFrame * GPU_TRACE_MAX_SCOPES + scope) * 2);
+        return scope;
+    }
+
+    void VulkanRenderer::endGpuScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+        if (scope == UINT32_MAX) {
+            return;
+        }
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_vkTimestampPool,
+            (currentFrame * GPU_TRACE_MAX_SCOPES + scope) * 2 + 1);
+    }
+
+    // Runs once the slot's previous frame has completed, so every query it
+    // wrote is available.
+    void VulkanRenderer::collectGpuScopes() {
+        std::vector<const char*>& scopes = m_vkGpuScopes[currentFrame];
+        if (scopes.empty()) {
+            return;
+        }
+
+        uint64_t ticks[2 * GPU_TRACE_MAX_SCOPES];
+        VkResult result = vkGetQueryPoolResults(m_vkDevice, m_vkTimestampPool, currentFrame * 2 * GPU_TRACE_MAX_SCOPES,
+            static_cast<uint32_t>(2 * scopes.size()), sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            auto deviceNs = [this](uint64_t tick) {
+                return static_cast<int64_t>(static_cast<double>(tick & m_vkTimestampMask) * m_vkTimestampPeriod);
+            };
+
+            // Without calibration the frame's first GPU timestamp is taken
+            // to be its submit time. The GPU cannot start earlier, so scopes
+            // may show up early, but never before the submit that issued them.
+            int64_t offsetNs = static_cast<int64_t>(m_vkFrameSubmitNs[currentFrame]) - deviceNs(ticks[0]);
+            if (m_vkGetCalibratedTimestamps) {
+                VkCalibratedTimestampInfoEXT infos[2]{};
+                infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+                infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+                infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+                infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+                uint64_t timestamps[2];
+                uint64_t maxDeviation;
+                if (m_vkGetCalibratedTimestamps(m_vkDevice, 2, infos, timestamps, &maxDeviation) == VK_SUCCESS) {
+                    offsetNs = static_cast<int64_t>(timestamps[1]) - deviceNs(timestamps[0]);
+                }
+            }
+
+            for (size_t i = 0; i < scopes.size(); i++) {
+                m_gpuTraceTrack->push({ scopes[i],
+                    static_cast<uint64_t>(deviceNs(ticks[2 * i]) + offsetNs),
+                    static_cast<uint64_t>(deviceNs(ticks[2 * i + 1]) + offsetNs) });
+            }
+        }
+        scopes.clear();
+    }
+
+    // Begins a pass over the swapchain image and depth buffer. The frame's
+    // first pass clears both, later ones load them.
+    void VulkanRenderer::beginFramePass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool clear) {
+        VkClearValue clearValues[2]{};
+        clearValues[0].color = { {
+                srgbToLinear(129.0f / 255.0f),
+                srgbToLinear(186.0f / 255.0f), 
+                srgbToLinear(219.0f / 255.0f), 1.0f 
+        } };
+        clearValues[1].depthStencil = { m_reverseZ ? 0.0f : 1.0f, 0 };
+
+        if (!m_vkDynamicRendering) {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = clear ? m_vkRenderPass : m_vkLoadRenderPass;
+            renderPassInfo.framebuffer = m_vkSwapChainFramebuffers[imageIndex];
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = m_vkSwapChainExtent;
+            renderPassInfo.clearValueCount = clear ? 2 : 0;
+            renderPassInfo.pClearValues = clear ? clearValues : nullptr;
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            return;
+        }
+
+        // What the render passes' external dependency and initial layouts
+        // did. The color image stays in the attachment layout between the
+        // frame's passes; executeCommandStreams() hands it to present.
+        VkImageMemoryBarrier barriers[2]{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = clear ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = m_vkSwapChainImages[imageIndex];
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        // The depth buffer is shared by all frames in flight: the clear
+        // waits for the previous frame's depth writes and pyramid build.
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[1].oldLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = m_vkImages.get(m_vkDepthImage)->image;
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+            0, nullptr, 0, nullptr, 2, barriers);
+
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = m_vkSwapChainImageViews[imageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearValues[0];
+
+        VkRenderingAttachmentInfo depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = m_vkImages.get(m_vkDepthImage)->view;
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.clearValue = clearValues[1];
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = m_vkSwapChainExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void VulkanRenderer::endFramePass(VkCommandBuffer commandBuffer) {
+        if (m_vkDynamicRendering) {
+            vkCmdEndRendering(commandBuffer);
+        }
+        else {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+
+    // Phase 0 runs before the frame's render pass and emits last frame's
+    // visible set; phase 1 runs once the depth pyramid is built and emits
+    // the objects that became visible.
+    void VulkanRenderer::recordCulling(VkCommandBuffer commandBuffer, uint32_t phase) {
+        const VulkanPipeline* pipeline = m_vkPipelines.get(m_vkCullPipeline);
+        VkBuffer drawCounts = m_vkBuffers.get(m_vkDrawCountBuffer)->buffer;
+
+        if (phase == 0) {
+            // The buffers are shared by all frames in flight; wait for the
+            // previous frame's culling and indirect draws before resetting.
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            // A new pyramid enters GENERAL before anything binds it.
+            VkImageMemoryBarrier pyramidBarrier{};
+            pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            pyramidBarrier.srcAccessMask = 0;
+            pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            pyramidBarrier.image = m_vkImages.get(m_vkDepthPyramid)->image;
+            pyramidBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_vkDepthPyramidLevels, 0, 1 };
+            uint32_t imageBarrierCount = m_vkDepthPyramidInitialized ? 0 : 1;
+            m_vkDepthPyramidInitialized = true;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                1, &barrier, 0, nullptr, imageBarrierCount, &pyramidBarrier);
+
+            vkCmdFillBuffer(commandBuffer, drawCounts, 0, 2 * sizeof(uint32_t), 0);
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        CullConstants constants{};
+        constants.objectCount = static_cast<uint32_t>(m_sceneObjects.size());
+        constants.phase = phase;
+        constants.pyramidWidth = m_vkDepthPyramidExtent.width;
+        constants.pyramidHeight = m_vkDepthPyramidExtent.height;
+        constants.pyramidLevels = m_vkDepthPyramidLevels;
+        constants.indexCount = static_cast<uint32_t>(m_indices.size());
+        constants.znear = CAMERA_Z_NEAR;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->layout,
+            0, 1, &m_vkCullDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (constants.objectCount + 63) / 64, 1, 1);
+        m_vkFrameStats.pipelineBinds++;
+        m_vkFrameStats.descriptorBinds++;
+        m_vkFrameStats.dispatches++;
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Runs between the two render passes: the depth buffer is read by
+    // hiz.comp and handed back to the load pass afterwards.
+    void VulkanRenderer::recordDepthPyramid(VkCommandBuffer commandBuffer) {
+        const VulkanPipeline* pipeline = m_vkPipelines.get(m_vkHiZPipeline);
+
+        VkImageMemoryBarrier barriers[2]{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = m_vkImages.get(m_vkDepthImage)->image;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        // Earlier frames' culling read the pyramid this dispatch overwrites.
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = m_vkImages.get(m_vkDepthPyramid)->image;
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_vkDepthPyramidLevels, 0, 1 };
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 2, barriers);
+
+        uint32_t groupsX = (m_vkDepthPyramidExtent.width + 31) / 32;
+        uint32_t groupsY = (m_vkDepthPyramidExtent.height + 31) / 32;
+
+        HiZConstants constants{};
+        constants.depthWidth = m_vkSwapChainExtent.width;
+        constants.depthHeight = m_vkSwapChainExtent.height;
+        constants.pyramidWidth = m_vkDepthPyramidExtent.width;
+        constants.pyramidHeight = m_vkDepthPyramidExtent.height;
+        constants.levelCount = m_vkDepthPyramidLevels;
+        constants.groupCount = groupsX * groupsY;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->layout,
+            0, 1, &m_vkHiZDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+        m_vkFrameStats.pipelineBinds++;
+        m_vkFrameStats.descriptorBinds++;
+        m_vkFrameStats.dispatches++;
+
+        barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 2, barriers);
+    }
+
+    // Expects the frame's viewport, scissor and combined buffer to be bound.
+    // With the depth prepass, the phase's draws go through twice.
+    void VulkanRenderer::recordSceneDraws(VkCommandBuffer commandBuffer, uint32_t phase) {
+        uint32_t objectCount = static_cast<uint32_t>(m_sceneObjects.size());
+        auto drawPass = [&](PipelineHandle handle) {
+            const VulkanPipeline* pipeline = m_vkPipelines.get(handle);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout,
+                0, 1, &m_vkSceneDescriptorSets[currentFrame], 0, nullptr);
+            vkCmdDrawIndexedIndirectCount(commandBuffer,
+                m_vkBuffers.get(m_vkDrawCommandBuffer)->buffer, phase * objectCount * sizeof(VkDrawIndexedIndirectCommand),
+                m_vkBuffers.get(m_vkDrawCountBuffer)->buffer, phase * sizeof(uint32_t),
+                objectCount, sizeof(VkDrawIndexedIndirectCommand));
+            m_vkFrameStats.pipelineBinds++;
+            m_vkFrameStats.descriptorBinds++;
+            m_vkFrameStats.draws++;
+        };
+
+        if (m_depthPrepass) {
+            drawPass(scenePipeline(0, DepthPass::Prepass));
+            drawPass(scenePipeline(m_shaderVariant, DepthPass::Shade));
+        }
+        else {
+            drawPass(scenePipeline(m_shaderVariant));
+        }
+    }
+
+    static VkBufferUsageFlags toVkBufferUsage(uint32_t usage) {
+        VkBufferUsageFlags flags = 0;
+        if (usage & BUFFER_USAGE_VERTEX) flags |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        if (usage & BUFFER_USAGE_INDEX) flags |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        if (usage & BUFFER_USAGE_UNIFORM) flags |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        if (usage & BUFFER_USAGE_STORAGE) flags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        if (usage & BUFFER_USAGE_INDIRECT) flags |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        if (usage & BUFFER_USAGE_COPY_SRC) flags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        if (usage & BUFFER_USAGE_COPY_DST) flags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        return flags;
+    }
+
+    BufferHandle VulkanRenderer::createBuffer(const BufferDesc& desc) {
+        VkBufferUsageFlags usage = toVkBufferUsage(desc.usage);
+        if (desc.hostVisible) {
+            BufferHandle handle = createBuffer(desc.size, usage,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            if (desc.initialData) {
+                memcpy(m_vkBuffers.get(handle)->mapped, desc.initialData, desc.size);
+                m_vkFrameStats.bytesUploaded += desc.size;
+            }
+            return handle;
+        }
+
+        if (desc.initialData) {
+            usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        }
+        BufferHandle handle = createBuffer(desc.size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (desc.initialData) {
+            BufferHandle staging = createBuffer(desc.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            memcpy(m_vkBuffers.get(staging)->mapped, desc.initialData, desc.size);
+            m_vkFrameStats.bytesUploaded += desc.size;
+            copyBuffer(m_vkBuffers.get(staging)->buffer, m_vkBuffers.get(handle)->buffer, desc.size);
+            destroyBuffer(staging);
+        }
+        return handle;
+    }
+
+    void* VulkanRenderer::getMappedData(BufferHandle buffer) {
+        VulkanBuffer* vulkanBuffer = m_vkBuffers.get(buffer);
+        return vulkanBuffer ? vulkanBuffer->mapped : nullptr;
+    }
+
+    void VulkanRenderer::submit(const CommandStream& stream) {
+        m_vkSubmittedStreams.push_back(stream);
+    }
+
+    // Called inside the frame's pass; ends it before returning. Copies and
+    // dispatches end the pass, and the next draw resumes it with a loading
+    // beginFramePass(). A full memory barrier sits at each switch, since
+    // the packets carry no hazard information.
+    void VulkanRenderer::executeCommandStreams(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        bool insideRenderPass = true;
+        const VulkanPipeline* pipeline = nullptr;
+
+        auto memoryBarrier = [commandBuffer]() {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                1, &barrier, 0, nullptr, 0, nullptr);
+        };
+        auto endRenderPass = [&]() {
+            if (insideRenderPass) {
+                endFramePass(commandBuffer);
+                memoryBarrier();
+                insideRenderPass = false;
+            }
+        };
+        auto resumeRenderPass = [&]() {
+            if (!insideRenderPass) {
+                memoryBarrier();
+                beginFramePass(commandBuffer, imageIndex, false);
+                insideRenderPass = true;
+            }
+        };
+
+        for (const CommandStream& stream : m_vkSubmittedStreams) {
+            for (const CommandHeader* cmd = stream.first(); cmd; cmd = CommandStream::next(cmd)) {
+                switch (cmd->type) {
+                case CommandType::BindPipeline: {
+                    pipeline = m_vkPipelines.get(commandAs<CmdBindPipeline>(cmd).pipeline);
+                    if (!pipeline) {
+                        break;
+                    }
+                    vkCmdBindPipeline(commandBuffer, pipeline->bindPoint, pipeline->pipeline);
+                    m_vkFrameStats.pipelineBinds++;
+                    zeroPushConstants(commandBuffer, *pipeline);
+                    if (pipeline->frameDescriptorSets && !pipeline->frameDescriptorSets->empty()) {
+                        vkCmdBindDescriptorSets(commandBuffer, pipeline->bindPoint, pipeline->layout,
+                            0, 1, &(*pipeline->frameDescriptorSets)[currentFrame], 0, nullptr);
+                        m_vkFrameStats.descriptorBinds++;
+                    }
+                    break;
+                }
+                case CommandType::BindVertexBuffer: {
+                    const auto& bind = commandAs<CmdBindVertexBuffer>(cmd);
+                    if (const VulkanBuffer* buffer = m_vkBuffers.get(bind.buffer)) {
+                        VkDeviceSize offset = bind.offset;
+                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer->buffer, &offset);
+                    }
+                    break;
+                }
+                case CommandType::BindIndexBuffer: {
+                    const auto& bind = commandAs<CmdBindIndexBuffer>(cmd);
+                    if (const VulkanBuffer* buffer = m_vkBuffers.get(bind.buffer)) {
+                        vkCmdBindIndexBuffer(commandBuffer, buffer->buffer, bind.offset,
+                            bind.indexType == IndexType::UInt16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+                    }
+                    break;
+                }
+                case CommandType::SetConstants: {
+                    const auto& constants = commandAs<CmdSetConstants>(cmd);
+                    if (pipeline && pipeline->pushConstantStages) {
+                        vkCmdPushConstants(commandBuffer, pipeline->layout, pipeline->pushConstantStages,
+                            constants.offset, constants.size, constants.data());
+                    }
+                    break;
+                }
+                case CommandType::Draw: {
+                    const auto& draw = commandAs<CmdDraw>(cmd);
+                    resumeRenderPass();
+                    vkCmdDraw(commandBuffer, draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+                    m_vkFrameStats.addDraw(draw.vertexCount, draw.instanceCount);
+                    break;
+                }
+                case CommandType::DrawIndexed: {
+                    const auto& draw = commandAs<CmdDrawIndexed>(cmd);
+                    resumeRenderPass();
+                    vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex,
+                        draw.vertexOffset, draw.firstInstance);
+                    m_vkFrameStats.addDraw(draw.indexCount, draw.instanceCount);
+                    break;
+                }
+                case CommandType::Dispatch: {
+                    const auto& dispatch = commandAs<CmdDispatch>(cmd);
+                    endRenderPass();
+                    vkCmdDispatch(commandBuffer, dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+                    m_vkFrameStats.dispatches++;
+                    break;
+                }
+                case CommandType::CopyBuffer: {
+                    const auto& copy = commandAs<CmdCopyBuffer>(cmd);
+                    const VulkanBuffer* src = m_vkBuffers.get(copy.src);
+                    const VulkanBuffer* dst = m_vkBuffers.get(copy.dst);
+                    if (src && dst) {
+                        endRenderPass();
+                        VkBufferCopy region{ copy.srcOffset, copy.dstOffset, copy.size };
+                        vkCmdCopyBuffer(commandBuffer, src->buffer, dst->buffer, 1, &region);
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+        }
+        m_vkSubmittedStreams.clear();
+
+        // The swapchain image has to leave in PRESENT_SRC, which the end of
+        // a render pass does here; dynamic rendering needs the barrier.
+        resumeRenderPass();
+        endFramePass(commandBuffer);
+
+        if (m_vkDynamicRendering) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_vkSwapChainImages[imageIndex];
+            barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+        }
+    }
+
+    // Acquire and present only accept binary semaphores, so those stay
+    // per frame slot; CPU/GPU frame pacing runs on the graphics timeline.
     void VulkanRenderer::createSyncObjects() {
         m_vkImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         m_vkRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        m_vkInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             CHECK_VK(vkCreateSemaphore(m_vkDevice, &semaphoreInfo, nullptr, &m_vkImageAvailableSemaphores[i]));
             CHECK_VK(vkCreateSemaphore(m_vkDevice, &semaphoreInfo, nullptr, &m_vkRenderFinishedSemaphores[i]));
-            CHECK_VK(vkCreateFence(m_vkDevice, &fenceInfo, nullptr, &m_vkInFlightFences[i]));
-
         }
     }
 
@@ -881,11 +2239,258 @@ namespace Nashi {
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(m_vkDevice, m_vkRenderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(m_vkDevice, m_vkImageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(m_vkDevice, m_vkInFlightFences[i], nullptr);
         }
         m_vkRenderFinishedSemaphores.clear();
         m_vkImageAvailableSemaphores.clear();
-        m_vkInFlightFences.clear();
+    }
+
+    void VulkanRenderer::createTimeline(QueueTimeline& timeline, VkQueue queue) {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        timeline.queue = queue;
+        timeline.lastSubmitted = 0;
+        timeline.lastCompleted = 0;
+        CHECK_VK(vkCreateSemaphore(m_vkDevice, &semaphoreInfo, nullptr, &timeline.semaphore));
+    }
+
+    void VulkanRenderer::destroyTimeline(QueueTimeline& timeline) {
+        vkDestroySemaphore(m_vkDevice, timeline.semaphore, nullptr);
+        timeline.semaphore = VK_NULL_HANDLE;
+    }
+
+    // Submits and signals the timeline's next value, which is returned.
+    // Binary semaphores can be mixed into waits/signals; their values are ignored.
+    uint64_t VulkanRenderer::submitToQueue(QueueTimeline& timeline, std::span<const VkCommandBuffer> commandBuffers,
+        std::span<const SemaphoreWait> waits, std::span<const VkSemaphore> binarySignals) {
+        ScratchScope scratch;
+        ArenaVector<VkSemaphore> waitSemaphores(scratch.allocator<VkSemaphore>());
+        ArenaVector<uint64_t> waitValues(scratch.allocator<uint64_t>());
+        ArenaVector<VkPipelineStageFlags> waitStages(scratch.allocator<VkPipelineStageFlags>());
+        waitSemaphores.reserve(waits.size());
+        waitValues.reserve(waits.size());
+        waitStages.reserve(waits.size());
+        for (const auto& wait : waits) {
+            waitSemaphores.push_back(wait.semaphore);
+            waitValues.push_back(wait.value);
+            waitStages.push_back(wait.stage);
+        }
+
+        uint64_t signalValue = timeline.lastSubmitted + 1;
+        ArenaVector<VkSemaphore> signalSemaphores(scratch.allocator<VkSemaphore>());
+        signalSemaphores.reserve(binarySignals.size() + 1);
+        signalSemaphores.assign(binarySignals.begin(), binarySignals.end());
+        ArenaVector<uint64_t> signalValues(signalSemaphores.size(), 0, scratch.allocator<uint64_t>());
+        signalValues.reserve(signalSemaphores.size() + 1);
+        signalSemaphores.push_back(timeline.semaphore);
+        signalValues.push_back(signalValue);
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+        submitInfo.pCommandBuffers = commandBuffers.data();
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+        CHECK_VK(vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE));
+        timeline.lastSubmitted = signalValue;
+        return signalValue;
+    }
+
+    // Non-blocking; only queries the driver when the cached value is behind.
+    bool VulkanRenderer::hasCompleted(QueueTimeline& timeline, uint64_t value) {
+        if (value <= timeline.lastCompleted) {
+            return true;
+        }
+        CHECK_VK(vkGetSemaphoreCounterValue(m_vkDevice, timeline.semaphore, &timeline.lastCompleted));
+        return value <= timeline.lastCompleted;
+    }
+
+    void VulkanRenderer::waitForTimeline(QueueTimeline& timeline, uint64_t value) {
+        if (hasCompleted(timeline, value)) {
+            return;
+        }
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline.semaphore;
+        waitInfo.pValues = &value;
+        CHECK_VK(vkWaitSemaphores(m_vkDevice, &waitInfo, UINT64_MAX));
+        timeline.lastCompleted = std::max(timeline.lastCompleted, value);
+    }
+
+    static VkBufferMemoryBarrier queueOwnershipBarrier(VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+        VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = srcFamily;
+        barrier.dstQueueFamilyIndex = dstFamily;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    }
+
+    VkCommandBuffer VulkanRenderer::beginOneTimeCommands(VkCommandPool pool) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = pool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        CHECK_VK(vkAllocateCommandBuffers(m_vkDevice, &allocInfo, &commandBuffer));
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        return commandBuffer;
+    }
+
+    void VulkanRenderer::deferDestroy(std::function<void(VkDevice)> destroy) {
+        m_vkDeletionQueue.push_back({ m_vkGraphicsTimeline.lastSubmitted, m_vkComputeTimeline.lastSubmitted, std::move(destroy) });
+    }
+
+    void VulkanRenderer::processDeletionQueue() {
+        while (!m_vkDeletionQueue.empty()) {
+            const DeferredDeletion& deletion = m_vkDeletionQueue.front();
+            if (!hasCompleted(m_vkGraphicsTimeline, deletion.graphicsValue) ||
+                !hasCompleted(m_vkComputeTimeline, deletion.computeValue)) {
+                break;
+            }
+            deletion.destroy(m_vkDevice);
+            m_vkDeletionQueue.pop_front();
+        }
+    }
+
+    // Only valid once the device is idle.
+    void VulkanRenderer::flushDeletionQueue() {
+        for (const auto& deletion : m_vkDeletionQueue) {
+            deletion.destroy(m_vkDevice);
+        }
+        m_vkDeletionQueue.clear();
+    }
+
+    // Acquire half of the compute -> graphics transfers released by earlier jobs.
+    void VulkanRenderer::recordPendingGraphicsAcquires(VkCommandBuffer commandBuffer) {
+        if (m_vkPendingGraphicsAcquires.empty()) {
+            return;
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vkPendingGraphicsAcquireStages, 0,
+            0, nullptr, static_cast<uint32_t>(m_vkPendingGraphicsAcquires.size()), m_vkPendingGraphicsAcquires.data(), 0, nullptr);
+        m_vkPendingGraphicsAcquires.clear();
+        m_vkPendingGraphicsAcquireStages = 0;
+    }
+
+    uint64_t VulkanRenderer::submitCompute(const ComputeJob& job) {
+        processDeletionQueue();
+
+        const bool transferOwnership = m_vkComputeFamily != m_vkGraphicsFamily;
+        std::vector<SemaphoreWait> waits = job.waits;
+
+        std::vector<VkBufferMemoryBarrier> computeAcquires;
+        for (VkBuffer buffer : job.buffers) {
+            auto owner = m_vkBufferOwners.find(buffer);
+            if (transferOwnership && owner == m_vkBufferOwners.end()) {
+                computeAcquires.push_back(queueOwnershipBarrier(buffer, m_vkGraphicsFamily, m_vkComputeFamily,
+                    0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+            }
+        }
+
+        if (!computeAcquires.empty()) {
+            // The release half has to run on the graphics queue. Acquires still
+            // pending from earlier jobs are recorded first so a buffer is never
+            // released before graphics took it back.
+            VkCommandBuffer release = beginOneTimeCommands(m_vkCommandPool);
+            recordPendingGraphicsAcquires(release);
+
+            std::vector<VkBufferMemoryBarrier> releases;
+            for (const auto& acquire : computeAcquires) {
+                releases.push_back(queueOwnershipBarrier(acquire.buffer, m_vkGraphicsFamily, m_vkComputeFamily,
+                    VK_ACCESS_MEMORY_WRITE_BIT, 0));
+            }
+            vkCmdPipelineBarrier(release, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+            CHECK_VK(vkEndCommandBuffer(release));
+
+            // Pending waits stay queued for the next frame as well; waiting on
+            // a reached timeline value again costs nothing.
+            uint64_t released = submitToQueue(m_vkGraphicsTimeline, { &release, 1 }, m_vkPendingGraphicsWaits, {});
+            deferDestroy([pool = m_vkCommandPool, release](VkDevice device) {
+                vkFreeCommandBuffers(device, pool, 1, &release);
+            });
+            waits.push_back({ m_vkGraphicsTimeline.semaphore, released, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+        }
+        else if (!job.buffers.empty() && !transferOwnership) {
+            // Same family, no ownership to move, but the job must still not
+            // overwrite data that submitted frames are reading.
+            waits.push_back({ m_vkGraphicsTimeline.semaphore, m_vkGraphicsTimeline.lastSubmitted, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+        }
+        if (!job.buffers.empty() && m_vkComputeTimeline.lastSubmitted > 0) {
+            // Orders the job after earlier jobs that may have touched the same buffers.
+            waits.push_back({ m_vkComputeTimeline.semaphore, m_vkComputeTimeline.lastSubmitted, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+        }
+
+        VkCommandBuffer commandBuffer = beginOneTimeCommands(m_vkComputeCommandPool);
+        if (!computeAcquires.empty()) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                0, nullptr, static_cast<uint32_t>(computeAcquires.size()), computeAcquires.data(), 0, nullptr);
+        }
+
+        job.record(commandBuffer);
+
+        if (transferOwnership) {
+            std::vector<VkBufferMemoryBarrier> releases;
+            for (VkBuffer buffer : job.buffers) {
+                if (job.graphicsStage == 0) {
+                    m_vkBufferOwners[buffer] = m_vkComputeFamily;
+                    continue;
+                }
+                releases.push_back(queueOwnershipBarrier(buffer, m_vkComputeFamily, m_vkGraphicsFamily,
+                    VK_ACCESS_SHADER_WRITE_BIT, 0));
+                m_vkPendingGraphicsAcquires.push_back(queueOwnershipBarrier(buffer, m_vkComputeFamily, m_vkGraphicsFamily,
+                    0, job.graphicsAccess));
+                m_vkBufferOwners.erase(buffer);
+            }
+            if (!releases.empty()) {
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+                m_vkPendingGraphicsAcquireStages |= job.graphicsStage;
+            }
+        }
+        CHECK_VK(vkEndCommandBuffer(commandBuffer));
+
+        uint64_t done = submitToQueue(m_vkComputeTimeline, { &commandBuffer, 1 }, waits, {});
+        deferDestroy([pool = m_vkComputeCommandPool, commandBuffer](VkDevice device) {
+            vkFreeCommandBuffers(device, pool, 1, &commandBuffer);
+        });
+
+        if (job.graphicsStage != 0) {
+            m_vkPendingGraphicsWaits.push_back({ m_vkComputeTimeline.semaphore, done, job.graphicsStage });
+        }
+        return done;
     }
 
     void VulkanRenderer::init() {
@@ -893,12 +2498,19 @@ namespace Nashi {
         createSurface();
         pickPhysicalDevice();
         createLogicalDeivce();
+        createTimeline(m_vkGraphicsTimeline, m_vkGraphicsQueue);
+        createTimeline(m_vkComputeTimeline, m_vkComputeQueue);
         createSwapChain();
         createImageViews();
+        createDepthResources();
         createRenderPass();
 
+        m_shaderLibrary.open(std::filesystem::current_path() / "shaders" / SHADER_LIBRARY_FILE_NAME);
+
         createDescriptorSetLayout();
-        createGraphicsPipeline();
+        createPipelineLayout();
+        m_vkGraphicsPipeline = getBasicPipeline(m_shaderVariant);
+        createCullingPipelines();
 
         createFramebuffers();
         createCommandPool();
@@ -909,18 +2521,124 @@ namespace Nashi {
         createDescriptorPool();
         createDescriptorSets();
 
+        createScene();
+        createCullingDescriptorSets();
+
         createCommandBuffers();
         createSyncObjects();
+        createTimestampQueries();
+        createStatisticsQueries();
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+        m_shaderWatcher = std::make_unique<ShaderWatcher>(NASHI_SHADER_SOURCE_DIR,
+            std::filesystem::current_path() / "shaders", ShaderTarget::SPIRV);
+        m_shaderWatcher->start();
+#endif
     }
 
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+    void VulkanRenderer::reloadShaders() {
+        bool basicDirty = false;
+        bool sceneDirty = false;
+        bool cullDirty = false;
+        bool hizDirty = false;
+        for (const auto& stage : m_shaderWatcher->takeReloaded()) {
+            basicDirty |= stage == "basic.vert" || stage == "basic.frag";
+            sceneDirty |= stage == "scene.vert" || stage == "basic.frag";
+            cullDirty |= stage == "cull.comp";
+            hizDirty |= stage == "hiz.comp";
+        }
+
+        std::vector<std::pair<PipelineHandle, std::function<VkPipeline()>>> dirty;
+        if (basicDirty) {
+            for (const auto& [key, handle] : m_vkBasicPipelines) {
+                dirty.emplace_back(handle, [this, key]() {
+                    return createGraphicsPipeline(key & 0xFFFF, "basic.vert", m_basicReflection, m_vkPipelineLayout,
+                        static_cast<DepthPass>(key >> 16));
+                });
+            }
+        }
+        if (sceneDirty) {
+            for (const auto& [key, handle] : m_vkScenePipelines) {
+                dirty.emplace_back(handle, [this, key]() {
+                    return createGraphicsPipeline(key & 0xFFFF, "scene.vert", m_sceneReflection, m_vkScenePipelineLayout,
+                        static_cast<DepthPass>(key >> 16));
+                });
+            }
+        }
+        if (cullDirty) {
+            dirty.emplace_back(m_vkCullPipeline, [this]() { return createComputePipeline("cull.comp", m_vkCullPipelineLayout, depthConstants()); });
+        }
+        if (hizDirty) {
+            dirty.emplace_back(m_vkHiZPipeline, [this]() { return createComputePipeline("hiz.comp", m_vkHiZPipelineLayout, depthConstants()); });
+        }
+
+        if (dirty.empty()) {
+            return;
+        }
+
+        // Frames already submitted keep referencing the old pipelines, so they
+        // go through the deletion queue. The handles stay valid, only the
+        // objects behind them are swapped.
+        std::vector<VkPipeline> rebuilt;
+        try {
+            for (const auto& [handle, create] : dirty) {
+                rebuilt.push_back(create());
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << "shader hot reload: keeping previous pipeline (" << e.what() << ")" << std::endl;
+            for (VkPipeline pipeline : rebuilt) {
+                vkDestroyPipeline(m_vkDevice, pipeline, nullptr);
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < dirty.size(); i++) {
+            VulkanPipeline* pipeline = m_vkPipelines.get(dirty[i].first);
+            deferDestroy([old = pipeline->pipeline](VkDevice device) {
+                vkDestroyPipeline(device, old, nullptr);
+            });
+            pipeline->pipeline = rebuilt[i];
+        }
+    }
+#endif
+
     void VulkanRenderer::draw() {
+        NASHI_TRACE_SCOPE("VulkanRenderer::draw");
+        const uint64_t frameStartNs = SDL_GetTicksNS();
+
+        const FramePacingPolicy& pacing = m_framePacer.policy();
+        if (!pacing.lateLatchCamera) {
+            m_framePacer.limit();
+        }
 
-        CHECK_VK(vkWaitForFences(m_vkDevice, 1, &m_vkInFlightFences[currentFrame], VK_TRUE, UINT64_MAX));
+        {
+            NASHI_TRACE_SCOPE("Wait for frame slot");
+            waitForTimeline(m_vkGraphicsTimeline, m_vkFrameTimelineValues[currentFrame]);
+        }
+        collectGpuScopes();
+        collectPipelineStatistics();
+        processDeletionQueue();
+
+        if (!pacing.lateLatchCamera) {
+            updateUniformBuffer(currentFrame);
+        }
+
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+        reloadShaders();
+#endif
+        m_vkGraphicsPipeline = getBasicPipeline(m_shaderVariant, m_depthPrepass ? DepthPass::Shade : DepthPass::Single);
 
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(m_vkDevice, m_vkSwapChain, UINT64_MAX, m_vkImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || m_windowResized) {
-            m_windowResized = false;
+        VkResult result;
+        {
+            NASHI_TRACE_SCOPE("vkAcquireNextImageKHR");
+            result = vkAcquireNextImageKHR(m_vkDevice, m_vkSwapChain, UINT64_MAX, m_vkImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
+        // A pending resize is handled after present: bailing out here with an
+        // acquired image would leave the acquire semaphore signalled.
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
             return;
         }
@@ -929,29 +2647,26 @@ namespace Nashi {
         }
 
 
-        CHECK_VK(vkResetFences(m_vkDevice, 1, &m_vkInFlightFences[currentFrame]));
         CHECK_VK(vkResetCommandBuffer(m_vkCommandBuffers[currentFrame], 0));
         recordCommandBuffer(m_vkCommandBuffers[currentFrame], imageIndex);
 
-        updateUniformBuffer(currentFrame);
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-        VkSemaphore waitSemaphores[] = { m_vkImageAvailableSemaphores[currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_vkCommandBuffers[currentFrame];
+        // Late latch: the camera is sampled after recording and after the
+        // limiter wait, as close to submit as the mapped UBO allows.
+        if (pacing.lateLatchCamera) {
+            m_framePacer.limit();
+            updateUniformBuffer(currentFrame);
+        }
 
+        ArenaVector<SemaphoreWait> waits(ArenaAllocator<SemaphoreWait>(m_frameArenas.current()));
+        waits.reserve(m_vkPendingGraphicsWaits.size() + 1);
+        waits.assign(m_vkPendingGraphicsWaits.begin(), m_vkPendingGraphicsWaits.end());
+        m_vkPendingGraphicsWaits.clear();
+        waits.push_back({ m_vkImageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT });
         VkSemaphore signalSemaphores[] = { m_vkRenderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
 
-        CHECK_VK(vkQueueSubmit(m_vkGraphicsQueue, 1, &submitInfo, m_vkInFlightFences[currentFrame]));
+        m_vkFrameSubmitNs[currentFrame] = traceNow();
+        m_vkFrameTimelineValues[currentFrame] = submitToQueue(m_vkGraphicsTimeline,
+            { &m_vkCommandBuffers[currentFrame], 1 }, waits, signalSemaphores);
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -965,17 +2680,46 @@ namespace Nashi {
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr;
 
-        VkResult resultPresent = vkQueuePresentKHR(m_vkPresentQueue, &presentInfo);
+        VkResult resultPresent;
+        {
+            NASHI_TRACE_SCOPE("vkQueuePresentKHR");
+            resultPresent = vkQueuePresentKHR(m_vkPresentQueue, &presentInfo);
+        }
+        m_framePacer.onPresent();
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_windowResized) {
+        if (resultPresent == VK_ERROR_OUT_OF_DATE_KHR || resultPresent == VK_SUBOPTIMAL_KHR || m_windowResized) {
             m_windowResized = false;
             recreateSwapChain();
         }
-        else if (result != VK_SUCCESS) {
+        else if (resultPresent != VK_SUCCESS) {
             throw std::runtime_error("failed to present swap chain image!");
         }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_vkFrameStats.frameTimeNs = SDL_GetTicksNS() - frameStartNs;
+        m_renderStats.push(m_vkFrameStats);
+        m_vkFrameStats = {};
+
+        currentFrame = (currentFrame + 1) % pacing.frameQueueDepth;
+        m_frameArenas.endFrame();
+    }
+
+    LinearArena& VulkanRenderer::frameArena() {
+        return m_frameArenas.current();
+    }
+
+    void VulkanRenderer::setFramePacing(const FramePacingPolicy& policy) {
+        PresentMode previousMode = m_framePacer.policy().presentMode;
+        m_framePacer.setPolicy(policy);
+
+        // The present mode is baked into the swapchain; the queue depth only
+        // changes which per-frame slots draw() cycles through.
+        if (m_vkSwapChain != VK_NULL_HANDLE && previousMode != m_framePacer.policy().presentMode) {
+            m_windowResized = true;
+        }
+    }
+
+    void VulkanRenderer::markInput(uint64_t timestampNs) {
+        m_framePacer.markInput(timestampNs);
     }
 
     void VulkanRenderer::updateUniformBuffer(uint32_t currentImage) {
@@ -989,11 +2733,21 @@ namespace Nashi {
         ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f,
             0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.proj = glm::perspective(glm::radians(45.0f),
-            m_vkSwapChainExtent.width / (float)m_vkSwapChainExtent.height, 0.1f,
-            10.0f);
+            m_vkSwapChainExtent.width / (float)m_vkSwapChainExtent.height, CAMERA_Z_NEAR,
+            CAMERA_Z_FAR);
         ubo.proj[1][1] *= -1;
+        if (m_reverseZ) {
+            // Clip z becomes w - z, so depth d turns into 1 - d. Done in the
+            // matrix rather than the viewport, which would flip it only after
+            // the precision was already lost.
+            glm::mat4 reverse(1.0f);
+            reverse[2][2] = -1.0f;
+            reverse[3][2] = 1.0f;
+            ubo.proj = reverse * ubo.proj;
+        }
 
-        memcpy(m_vkUniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+        memcpy(m_vkBuffers.get(m_vkUniformBuffers[currentImage])->mapped, &ubo, sizeof(ubo));
+        m_vkFrameStats.bytesUploaded += sizeof(ubo);
 
     }
 
@@ -1009,73 +2763,85 @@ namespace Nashi {
         vkDestroySwapchainKHR(m_vkDevice, m_vkSwapChain, nullptr);
     }
 
+    // Never waits on SDL events itself: draw() may run on a render thread,
+    // and the app stops drawing while the window is minimized. A window
+    // with no area yet just keeps the resize pending.
     void VulkanRenderer::recreateSwapChain() {
         int width = 0, height = 0;
         SDL_GetWindowSizeInPixels(m_window, &width, &height);
-        while (SDL_GetWindowFlags(m_window) & SDL_WINDOW_MINIMIZED) {
-            SDL_WaitEvent(&m_event);
+        if (width == 0 || height == 0) {
+            m_windowResized = true;
+            return;
         }
 
-        vkDeviceWaitIdle(m_vkDevice);
-
-        cleanupSwapChain();
-        cleanupSyncObjects();
+        // No device idle: frames in flight keep rendering to and presenting
+        // the old images. The old swapchain is passed as oldSwapchain and,
+        // together with its views and framebuffers, destroyed once those
+        // frames have completed.
+        VkSwapchainKHR oldSwapChain = m_vkSwapChain;
+        std::vector<VkImageView> oldImageViews = std::move(m_vkSwapChainImageViews);
+        std::vector<VkFramebuffer> oldFramebuffers = std::move(m_vkSwapChainFramebuffers);
+        m_vkSwapChainImageViews.clear();
+        m_vkSwapChainFramebuffers.clear();
+
+        destroyDepthResources();
+        deferDestroy([pool = m_vkCullingDescriptorPool](VkDevice device) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        });
 
         createSwapChain();
         createImageViews();
+        createDepthResources();
         createFramebuffers();
-        createSyncObjects();
-    }
+        createCullingDescriptorSets();
 
-    VkVertexInputBindingDescription Vertex::getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescription;
-    }
-    std::array<VkVertexInputAttributeDescription, 2> Vertex::getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        return attributeDescriptions;
+        deferDestroy([oldSwapChain, oldImageViews, oldFramebuffers](VkDevice device) {
+            for (VkFramebuffer framebuffer : oldFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (VkImageView imageView : oldImageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        });
     }
 
     void VulkanRenderer::cleanup() {
         vkDeviceWaitIdle(m_vkDevice);
 
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+        m_shaderWatcher->stop();
+#endif
+
+        flushDeletionQueue();
         cleanupSyncObjects();
 
         vkDestroyCommandPool(m_vkDevice, m_vkCommandPool, nullptr);
+        vkDestroyCommandPool(m_vkDevice, m_vkComputeCommandPool, nullptr);
+        vkDestroyQueryPool(m_vkDevice, m_vkTimestampPool, nullptr);
+        vkDestroyQueryPool(m_vkDevice, m_vkStatisticsPool, nullptr);
 
         cleanupSwapChain();
 
-        vkDestroyBuffer(m_vkDevice, m_vkCombinedBuffer, nullptr);
-        vkFreeMemory(m_vkDevice, m_vkCombinedBufferMemory, nullptr);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroyBuffer(m_vkDevice, m_vkUniformBuffers[i], nullptr);
-            vkFreeMemory(m_vkDevice, m_vkUniformBuffersMemory[i], nullptr);
-        }
-
         vkDestroyDescriptorPool(m_vkDevice, m_vkDescriptorPool, nullptr);
+        vkDestroyDescriptorPool(m_vkDevice, m_vkCullingDescriptorPool, nullptr);
+        for (VkImageView view : m_vkDepthPyramidLevelViews) {
+            vkDestroyImageView(m_vkDevice, view, nullptr);
+        }
+        m_vkDepthPyramidLevelViews.clear();
 
-        vkDestroyDescriptorSetLayout(m_vkDevice, m_vkDescriptorSetLayout,
-            nullptr);
-
-        vkDestroyPipeline(m_vkDevice, m_vkGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(m_vkDevice, m_vkPipelineLayout, nullptr);
+        m_vkBasicPipelines.clear();
+        m_vkScenePipelines.clear();
+        m_vkUniformBuffers.clear();
+        destroyResourcePools();
+        destroyLayoutCache();
         vkDestroyRenderPass(m_vkDevice, m_vkRenderPass, nullptr);
+        vkDestroyRenderPass(m_vkDevice, m_vkLoadRenderPass, nullptr);
+
+        m_shaderLibrary.close();
 
+        destroyTimeline(m_vkComputeTimeline);
+        destroyTimeline(m_vkGraphicsTimeline);
         vkDestroyDevice(m_vkDevice, nullptr);
         vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
         vkDestroyInstance(m_vkInstance, nullptr);
@@ -0,0 +1,126 @@
+#include <shader_library.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace Nashi {
+    ShaderLibrary::~ShaderLibrary() {
+        close();
+    }
+
+    bool ShaderLibrary::open(const std::filesystem::path& path) {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize{};
+        GetFileSizeEx(file, &fileSize);
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        m_fileHandle = file;
+        m_mappingHandle = mapping;
+        m_data = static_cast<const uint8_t*>(view);
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        m_data = static_cast<const uint8_t*>(view);
+        m_size = static_cast<size_t>(st.st_size);
+#endif
+
+        const auto* header = reinterpret_cast<const ShaderLibraryHeader*>(m_data);
+        if (m_size < sizeof(ShaderLibraryHeader) ||
+            header->magic != SHADER_LIBRARY_MAGIC ||
+            header->version != SHADER_LIBRARY_VERSION ||
+            m_size < sizeof(ShaderLibraryHeader) + header->entryCount * sizeof(ShaderLibraryEntry)) {
+            std::cout << "invalid shader library: " << path.string() << std::endl;
+            close();
+            return false;
+        }
+
+        m_entries = reinterpret_cast<const ShaderLibraryEntry*>(m_data + sizeof(ShaderLibraryHeader));
+        m_entryCount = header->entryCount;
+        return true;
+    }
+
+    void ShaderLibrary::close() {
+        if (!m_data) {
+            return;
+        }
+
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+        CloseHandle(static_cast<HANDLE>(m_fileHandle));
+        m_mappingHandle = nullptr;
+        m_fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+        m_data = nullptr;
+        m_size = 0;
+        m_entries = nullptr;
+        m_entryCount = 0;
+    }
+
+    ShaderBlob ShaderLibrary::find(std::string_view name) const {
+        if (!m_data) {
+            return {};
+        }
+
+        const uint64_t hash = hashShaderName(name);
+        const ShaderLibraryEntry* end = m_entries + m_entryCount;
+        const ShaderLibraryEntry* entry = std::lower_bound(m_entries, end, hash,
+            [](const ShaderLibraryEntry& e, uint64_t h) { return e.hash < h; });
+
+        if (entry == end || entry->hash != hash || entry->offset + entry->size > m_size) {
+            return {};
+        }
+
+        return { m_data + entry->offset, static_cast<size_t>(entry->size) };
+    }
+}
@@ -0,0 +1,134 @@
+#include <shader_reflection.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Nashi {
+    struct ShaderReflectionHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t stageMask;
+        uint32_t bindingCount;
+        uint32_t pushConstantCount;
+        uint32_t vertexInputCount;
+    };
+
+    uint32_t reflectedFormatComponents(ReflectedFormat format) {
+        switch (format) {
+        case ReflectedFormat::Float1: case ReflectedFormat::Int1: case ReflectedFormat::UInt1: return 1;
+        case ReflectedFormat::Float2: case ReflectedFormat::Int2: case ReflectedFormat::UInt2: return 2;
+        case ReflectedFormat::Float3: case ReflectedFormat::Int3: case ReflectedFormat::UInt3: return 3;
+        case ReflectedFormat::Float4: case ReflectedFormat::Int4: case ReflectedFormat::UInt4: return 4;
+        default: return 0;
+        }
+    }
+
+    uint32_t reflectedFormatSize(ReflectedFormat format) {
+        return reflectedFormatComponents(format) * 4;
+    }
+
+    void ShaderReflection::merge(const ShaderReflection& other) {
+        stageMask |= other.stageMask;
+
+        for (const auto& binding : other.bindings) {
+            auto it = std::find_if(bindings.begin(), bindings.end(), [&](const ReflectedBinding& b) {
+                return b.set == binding.set && b.binding == binding.binding;
+            });
+            if (it != bindings.end()) {
+                it->stageMask |= binding.stageMask;
+                it->size = std::max(it->size, binding.size);
+            }
+            else {
+                bindings.push_back(binding);
+            }
+        }
+        std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+
+        for (const auto& range : other.pushConstants) {
+            auto it = std::find_if(pushConstants.begin(), pushConstants.end(), [&](const ReflectedPushConstant& p) {
+                return p.offset == range.offset && p.size == range.size;
+            });
+            if (it != pushConstants.end()) {
+                it->stageMask |= range.stageMask;
+            }
+            else {
+                pushConstants.push_back(range);
+            }
+        }
+
+        vertexInputs.insert(vertexInputs.end(), other.vertexInputs.begin(), other.vertexInputs.end());
+    }
+
+    uint32_t ShaderReflection::vertexLayout(std::vector<uint32_t>& offsets) const {
+        std::vector<const ReflectedVertexInput*> sorted;
+        for (const auto& input : vertexInputs) {
+            sorted.push_back(&input);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const ReflectedVertexInput* a, const ReflectedVertexInput* b) {
+            return a->location < b->location;
+        });
+
+        offsets.assign(vertexInputs.size(), 0);
+        uint32_t stride = 0;
+        for (const ReflectedVertexInput* input : sorted) {
+            offsets[input - vertexInputs.data()] = stride;
+            stride += reflectedFormatSize(input->format);
+        }
+        return stride;
+    }
+
+    template<typename T>
+    static void appendArray(std::vector<uint8_t>& out, const std::vector<T>& values) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(values.data());
+        out.insert(out.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    static bool readArray(const uint8_t*& cursor, const uint8_t* end, uint32_t count, std::vector<T>& values) {
+        if (static_cast<size_t>(end - cursor) < count * sizeof(T)) {
+            return false;
+        }
+        values.resize(count);
+        memcpy(values.data(), cursor, count * sizeof(T));
+        cursor += count * sizeof(T);
+        return true;
+    }
+
+    std::vector<uint8_t> ShaderReflection::serialize() const {
+        ShaderReflectionHeader header{};
+        header.magic = SHADER_REFLECTION_MAGIC;
+        header.version = SHADER_REFLECTION_VERSION;
+        header.stageMask = stageMask;
+        header.bindingCount = static_cast<uint32_t>(bindings.size());
+        header.pushConstantCount = static_cast<uint32_t>(pushConstants.size());
+        header.vertexInputCount = static_cast<uint32_t>(vertexInputs.size());
+
+        std::vector<uint8_t> out(sizeof(header));
+        memcpy(out.data(), &header, sizeof(header));
+        appendArray(out, bindings);
+        appendArray(out, pushConstants);
+        appendArray(out, vertexInputs);
+        return out;
+    }
+
+    bool ShaderReflection::deserialize(const void* data, size_t size, ShaderReflection& reflection) {
+        ShaderReflectionHeader header{};
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        if (header.magic != SHADER_REFLECTION_MAGIC || header.version != SHADER_REFLECTION_VERSION) {
+            return false;
+        }
+
+        const uint8_t* cursor = static_cast<const uint8_t*>(data) + sizeof(header);
+        const uint8_t* end = static_cast<const uint8_t*>(data) + size;
+
+        reflection.stageMask = header.stageMask;
+        return readArray(cursor, end, header.bindingCount, reflection.bindings) &&
+            readArray(cursor, end, header.pushConstantCount, reflection.pushConstants) &&
+            readArray(cursor, end, header.vertexInputCount, reflection.vertexInputs);
+    }
+}
@@ -0,0 +1,260 @@
+#if defined(NASHI_SHADER_HOT_RELOAD) && defined(__linux__)
+#include <shader_watcher.hpp>
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef NASHI_DXC_PATH
+#   define NASHI_DXC_PATH "dxc"
+#endif
+#ifndef NASHI_SPIRV_CROSS_PATH
+#   define NASHI_SPIRV_CROSS_PATH "spirv-cross"
+#endif
+
+namespace Nashi {
+    // Editors usually save through several writes/renames, so wait until the
+    // directory has been quiet for this long before compiling.
+    static constexpr int SHADER_WATCH_DEBOUNCE_MS = 30;
+    static constexpr int SHADER_WATCH_POLL_MS = 100;
+
+    static const char* shaderProfile(const std::filesystem::path& file) {
+        auto ext = file.extension();
+        if (ext == ".vert") return "vs_6_0";
+        if (ext == ".frag") return "ps_6_0";
+        if (ext == ".comp") return "cs_6_0";
+        return nullptr;
+    }
+
+    static std::string quote(const std::filesystem::path& path) {
+        return "\"" + path.string() + "\"";
+    }
+
+    // Keys shaders/variants.txt lists for the stage, after the always built
+    // key 0; the same rules as ShaderVariants.cmake.
+    static std::vector<uint32_t> variantKeys(const std::filesystem::path& variantsFile, const std::string& fileName) {
+        std::vector<uint32_t> keys = { 0 };
+        std::ifstream file(variantsFile);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string stage;
+            if (!(fields >> stage) || stage != fileName) {
+                continue;
+            }
+            uint32_t key;
+            while (fields >> key) {
+                if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+                    keys.push_back(key);
+                }
+            }
+        }
+        return keys;
+    }
+
+    // dxc switches for a key: bit N defines NASHI_FEATURE_<NAME>=1 for the
+    // Nth name on the source's "// nashi:features" line. Fails on bits no
+    // feature is declared for.
+    static bool variantDefines(const std::filesystem::path& source, uint32_t key, std::string& defines) {
+        std::ifstream file(source);
+        std::string line;
+        std::vector<std::string> features;
+        while (std::getline(file, line)) {
+            std::istringstream words(line);
+            std::string comment, tag;
+            if (words >> comment >> tag && comment == "//" && tag == "nashi:features") {
+                for (std::string feature; words >> feature; ) {
+                    features.push_back(feature);
+                }
+                break;
+            }
+        }
+
+        defines.clear();
+        for (size_t bit = 0; bit < features.size(); bit++) {
+            if (key & (1u << bit)) {
+                defines += " -DNASHI_FEATURE_" + features[bit] + "=1";
+            }
+        }
+        return features.size() >= 32 || (key >> features.size()) == 0;
+    }
+
+    ShaderWatcher::ShaderWatcher(std::filesystem::path sourceDir, std::filesystem::path outputDir, ShaderTarget target) {
+        this->m_sourceDir = std::move(sourceDir);
+        this->m_outputDir = std::move(outputDir);
+        this->m_target = target;
+    }
+
+    ShaderWatcher::~ShaderWatcher() {
+        stop();
+    }
+
+    void ShaderWatcher::start() {
+        if (m_running) {
+            return;
+        }
+
+        m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotifyFd < 0) {
+            std::cout << "shader hot reload: inotify_init1 failed" << std::endl;
+            return;
+        }
+
+        m_watchFd = inotify_add_watch(m_inotifyFd, m_sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (m_watchFd < 0) {
+            std::cout << "shader hot reload: cannot watch " << m_sourceDir << std::endl;
+            close(m_inotifyFd);
+            m_inotifyFd = -1;
+            return;
+        }
+
+        std::cout << "shader hot reload: watching " << m_sourceDir << std::endl;
+        m_running = true;
+        m_thread = std::thread(&ShaderWatcher::run, this);
+    }
+
+    void ShaderWatcher::stop() {
+        if (!m_running) {
+            return;
+        }
+
+        m_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+
+        inotify_rm_watch(m_inotifyFd, m_watchFd);
+        close(m_inotifyFd);
+        m_inotifyFd = -1;
+        m_watchFd = -1;
+    }
+
+    std::vector<std::string> ShaderWatcher::takeReloaded() {
+        std::lock_guard<std::mutex> lock(m_reloadedMutex);
+        std::vector<std::string> reloaded;
+        reloaded.swap(m_reloaded);
+        return reloaded;
+    }
+
+    bool ShaderWatcher::readEvents(std::set<std::string>& changed) {
+        alignas(inotify_event) char buffer[4096];
+        bool any = false;
+
+        for (;;) {
+            ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+
+            for (char* ptr = buffer; ptr < buffer + length; ) {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                if (event->len > 0 && shaderProfile(event->name) != nullptr) {
+                    changed.insert(event->name);
+                    any = true;
+                }
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+        return any;
+    }
+
+    void ShaderWatcher::run() {
+        pollfd pfd{};
+        pfd.fd = m_inotifyFd;
+        pfd.events = POLLIN;
+
+        while (m_running) {
+            if (poll(&pfd, 1, SHADER_WATCH_POLL_MS) <= 0) {
+                continue;
+            }
+
+            std::set<std::string> changed;
+            readEvents(changed);
+            while (m_running && poll(&pfd, 1, SHADER_WATCH_DEBOUNCE_MS) > 0) {
+                readEvents(changed);
+            }
+
+            for (const auto& fileName : changed) {
+                if (compile(fileName)) {
+                    std::lock_guard<std::mutex> lock(m_reloadedMutex);
+                    m_reloaded.push_back(fileName);
+                }
+            }
+        }
+    }
+
+    // Every variant key of the stage is rebuilt, since the renderers reload
+    // all of a stage's pipelines at once.
+    bool ShaderWatcher::compile(const std::string& fileName) {
+        std::error_code ec;
+        std::filesystem::create_directories(m_outputDir, ec);
+
+        for (uint32_t key : variantKeys(m_sourceDir / "variants.txt", fileName)) {
+            if (!compileVariant(fileName, key)) {
+                return false;
+            }
+        }
+        std::cout << "shader hot reload: recompiled " << fileName << std::endl;
+        return true;
+    }
+
+    bool ShaderWatcher::compileVariant(const std::string& fileName, uint32_t key) {
+        std::filesystem::path source = m_sourceDir / fileName;
+        const char* profile = shaderProfile(source);
+        const std::string artifact = key == 0 ? fileName : fileName + ".k" + std::to_string(key);
+
+        std::string defines;
+        if (!variantDefines(source, key, defines)) {
+            std::cout << "shader hot reload: variant key " << key << " of " << fileName << " uses undeclared feature bits" << std::endl;
+            return false;
+        }
+        // Matches the GL build's shader compile in CMakeLists.txt.
+        if (m_target == ShaderTarget::GLSL) {
+            defines += " -DNASHI_GL_DRAW_ID=1";
+        }
+
+        std::error_code ec;
+        // Compile next to the final artifact and rename over it, so a pipeline
+        // rebuild never observes a half written file.
+        std::filesystem::path spirv = m_outputDir / (artifact + ".spv");
+        std::filesystem::path spirvTmp = m_outputDir / (artifact + ".spv.tmp");
+
+        std::string dxc = std::string(NASHI_DXC_PATH) + " -T " + profile + " -E main -spirv" + defines + " -Fo " +
+            quote(spirvTmp) + " " + quote(source);
+        if (std::system(dxc.c_str()) != 0) {
+            std::cout << "shader hot reload: failed to compile " << artifact << std::endl;
+            std::filesystem::remove(spirvTmp, ec);
+            return false;
+        }
+
+        if (m_target == ShaderTarget::GLSL) {
+            std::filesystem::path glsl = m_outputDir / (artifact + ".glsl");
+            std::filesystem::path glslTmp = m_outputDir / (artifact + ".glsl.tmp");
+
+            std::string cross = std::string(NASHI_SPIRV_CROSS_PATH) + " --version 450 --output " +
+                quote(glslTmp) + " " + quote(spirvTmp);
+            if (std::system(cross.c_str()) != 0) {
+                std::cout << "shader hot reload: spirv-cross failed for " << artifact << std::endl;
+                std::filesystem::remove(glslTmp, ec);
+                std::filesystem::remove(spirvTmp, ec);
+                return false;
+            }
+            std::filesystem::rename(glslTmp, glsl, ec);
+        }
+
+        std::filesystem::rename(spirvTmp, spirv, ec);
+        if (ec) {
+            std::cout << "shader hot reload: cannot replace " << spirv << ": " << ec.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif
@@ -1,9 +1,22 @@
+// nashi:features DESATURATE
+
 struct PSInput {
     float4 pos : SV_POSITION;
     float3 col : COLOR0;
 };
 
+// A non-static global would land in a $Globals constant buffer under DXIL,
+// which the reflected D3D12 root signature does not bind.
+#ifdef __spirv__
+[[vk::constant_id(0)]] const float COLOR_INTENSITY = 1.0;
+#else
+static const float COLOR_INTENSITY = 1.0;
+#endif
 
 float4 main(PSInput input) : SV_TARGET {
-    return float4(input.col, 1.0);
-}
\ No newline at end of file
+    float3 color = input.col * COLOR_INTENSITY;
+#if NASHI_FEATURE_DESATURATE
+    color = dot(color, float3(0.2126, 0.7152, 0.0722)).xxx;
+#endif
+    return float4(color, 1.0);
+}
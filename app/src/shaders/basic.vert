@@ -17,13 +17,45 @@ cbuffer UniformBufferObject : register(b0)
     matrix proj;
 };
 
+// What CmdSetConstants writes. Zero after every pipeline bind and for the
+// backend's own draws.
+struct DrawConstants
+{
+    // Model-space translation; w is unused.
+    float4 offset;
+};
+
+#if NASHI_GL_DRAW_ID
+// The GL build: stream draws are batched into multi-draws, so every draw's
+// block sits in a storage buffer at GL_CONSTANTS_BINDING, at gl_DrawID.
+[[vk::binding(1)]] StructuredBuffer<DrawConstants> drawConstants;
+#elif defined(__spirv__)
+[[vk::push_constant]] ConstantBuffer<DrawConstants> drawConstants;
+#else
+// Root constants; the D3D12 root signature keeps them in space8.
+ConstantBuffer<DrawConstants> drawConstants : register(b0, space8);
+#endif
+
+#if NASHI_GL_DRAW_ID
+PSInput main(VSInput input, [[vk::builtin("DrawIndex")]] uint drawId : DRAW_ID)
+#else
 PSInput main(VSInput input)
+#endif
 {
     PSInput o;
 
-    float4 worldPos = mul(model, float4(input.pos, 1.0));
-    float4 viewPos = mul(view, worldPos);
-    o.pos = mul(proj, viewPos);
+#if NASHI_GL_DRAW_ID
+    float3 offset = drawConstants[drawId].offset.xyz;
+#else
+    float3 offset = drawConstants.offset.xyz;
+#endif
+
+    // precise keeps the compiler from contracting this differently in the
+    // depth prepass and shading pipelines, whose depths have to match.
+    precise float4 worldPos = mul(model, float4(input.pos + offset, 1.0));
+    precise float4 viewPos = mul(view, worldPos);
+    precise float4 clipPos = mul(proj, viewPos);
+    o.pos = clipPos;
 
     o.col = input.col;
     return o;
@@ -0,0 +1,45 @@
+// Instanced variant of basic.vert for GPU-driven draws: the culling pass
+// emits one indirect draw per visible object with firstInstance set to the
+// object index. Under Vulkan SV_InstanceID is InstanceIndex, which
+// includes firstInstance.
+
+struct VSInput
+{
+    float3 pos : POSITION;
+    float3 col : COLOR;
+};
+
+struct PSInput
+{
+    float4 pos : SV_POSITION;
+    float3 col : COLOR;
+};
+
+cbuffer UniformBufferObject : register(b0)
+{
+    matrix model;
+    matrix view;
+    matrix proj;
+};
+
+struct SceneObject
+{
+    matrix transform;
+    float4 boundingSphere;
+};
+
+StructuredBuffer<SceneObject> objects : register(t1);
+
+PSInput main(VSInput input, uint instance : SV_InstanceID)
+{
+    PSInput o;
+
+    // precise for the same reason as in basic.vert.
+    precise float4 worldPos = mul(model, mul(objects[instance].transform, float4(input.pos, 1.0)));
+    precise float4 viewPos = mul(view, worldPos);
+    precise float4 clipPos = mul(proj, viewPos);
+    o.pos = clipPos;
+
+    o.col = input.col;
+    return o;
+}
@@ -0,0 +1,288 @@
+#include <simd_lanes.hpp>
+#include <software_occlusion.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace Nashi {
+    namespace {
+        bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            // The OS must save the YMM registers on context switches.
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        }
+
+        OcclusionKernels selectOcclusionKernels() {
+            OcclusionKernels kernels = avx2OcclusionKernels();
+            if (kernels.rasterizeTile && cpuSupportsAvx2()) {
+                return kernels;
+            }
+            kernels = sseOcclusionKernels();
+            if (kernels.rasterizeTile) {
+                return kernels;
+            }
+            return scalarOcclusionKernels();
+        }
+
+        void transformPoint(const float* matrix, float x, float y, float z, float* clip) {
+            for (int row = 0; row < 4; row++) {
+                clip[row] = matrix[row] * x + matrix[4 + row] * y + matrix[8 + row] * z + matrix[12 + row];
+            }
+        }
+    }
+
+    OcclusionKernels scalarOcclusionKernels() {
+        OcclusionKernels kernels;
+        kernels.rasterizeTile = rasterizeOcclusionTile<ScalarLanes>;
+        kernels.testTile = testOcclusionTile<ScalarLanes>;
+        kernels.name = "scalar";
+        return kernels;
+    }
+
+    OcclusionKernels sseOcclusionKernels() {
+#if defined(NASHI_SIMD_SSE)
+        OcclusionKernels kernels;
+        kernels.rasterizeTile = rasterizeOcclusionTile<SseLanes>;
+        kernels.testTile = testOcclusionTile<SseLanes>;
+        kernels.name = "sse";
+        return kernels;
+#else
+        return {};
+#endif
+    }
+
+    std::vector<OcclusionKernels> supportedOcclusionKernels() {
+        std::vector<OcclusionKernels> supported = { scalarOcclusionKernels() };
+        if (OcclusionKernels sse = sseOcclusionKernels(); sse.rasterizeTile) {
+            supported.push_back(sse);
+        }
+        if (OcclusionKernels avx2 = avx2OcclusionKernels(); avx2.rasterizeTile && cpuSupportsAvx2()) {
+            supported.push_back(avx2);
+        }
+        return supported;
+    }
+
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height, uint32_t workerCount)
+        : SoftwareOcclusionCuller(width, height, selectOcclusionKernels(), workerCount) {
+    }
+
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height, const OcclusionKernels& kernels,
+        uint32_t workerCount)
+        : m_tilesX((std::max(width, 1u) + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH)
+        , m_tilesY((std::max(height, 1u) + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT)
+        , m_kernels(kernels)
+        , m_tileJobs(workerCount) {
+        m_width = m_tilesX * OCCLUSION_TILE_WIDTH;
+        m_height = m_tilesY * OCCLUSION_TILE_HEIGHT;
+
+        const size_t tileCount = static_cast<size_t>(m_tilesX) * m_tilesY;
+        m_depth.assign(tileCount * OCCLUSION_TILE_PIXELS, 1.0f);
+        m_tileMaxDepth.assign(tileCount, 1.0f);
+        m_tileBins.resize(tileCount);
+    }
+
+    void SoftwareOcclusionCuller::beginFrame() {
+        m_triangles.clear();
+        for (std::vector<uint32_t>& bin : m_tileBins) {
+            bin.clear();
+        }
+    }
+
+    void SoftwareOcclusionCuller::addOccluder(const float* positions, size_t stride, const uint16_t* indices,
+        size_t indexCount, const float* objectToClip) {
+        addTriangles(positions, stride, indices, indexCount, objectToClip);
+    }
+
+    void SoftwareOcclusionCuller::addOccluder(const float* positions, size_t stride, const uint32_t* indices,
+        size_t indexCount, const float* objectToClip) {
+        addTriangles(positions, stride, indices, indexCount, objectToClip);
+    }
+
+    template<typename Index>
+    void SoftwareOcclusionCuller::addTriangles(const float* positions, size_t stride, const Index* indices,
+        size_t indexCount, const float* objectToClip) {
+        if (indexCount < 3) {
+            return;
+        }
+
+        const size_t vertexCount = static_cast<size_t>(*std::max_element(indices, indices + indexCount)) + 1;
+        m_clipPositions.resize(vertexCount * 4);
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(positions);
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float* position = reinterpret_cast<const float*>(base + i * stride);
+            transformPoint(objectToClip, position[0], position[1], position[2], &m_clipPositions[i * 4]);
+        }
+
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            setupTriangle(&m_clipPositions[static_cast<size_t>(indices[i]) * 4],
+                &m_clipPositions[static_cast<size_t>(indices[i + 1]) * 4],
+                &m_clipPositions[static_cast<size_t>(indices[i + 2]) * 4]);
+        }
+    }
+
+    void SoftwareOcclusionCuller::setupTriangle(const float* a, const float* b, const float* c) {
+        const float* clip[3] = { a, b, c };
+        float x[3];
+        float y[3];
+        float z[3];
+        for (int i = 0; i < 3; i++) {
+            // No near-plane clipping: dropping the triangle only loses
+            // occlusion, never hides something visible.
+            if (clip[i][3] <= 0.0f || clip[i][2] < 0.0f) {
+                return;
+            }
+            const float invW = 1.0f / clip[i][3];
+            x[i] = (clip[i][0] * invW * 0.5f + 0.5f) * static_cast<float>(m_width);
+            y[i] = (clip[i][1] * invW * 0.5f + 0.5f) * static_cast<float>(m_height);
+            z[i] = clip[i][2] * invW;
+        }
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (std::fabs(area) < 1e-6f) {
+            return;
+        }
+        if (area < 0.0f) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        // Pixels whose centers can be inside, clamped before converting so
+        // vertices close to w = 0 cannot overflow.
+        const float firstX = std::ceil(std::max(std::min({ x[0], x[1], x[2] }) - 0.5f, 0.0f));
+        const float firstY = std::ceil(std::max(std::min({ y[0], y[1], y[2] }) - 0.5f, 0.0f));
+        const float lastX = std::floor(std::min(std::max({ x[0], x[1], x[2] }) - 0.5f, static_cast<float>(m_width - 1)));
+        const float lastY = std::floor(std::min(std::max({ y[0], y[1], y[2] }) - 0.5f, static_cast<float>(m_height - 1)));
+        if (firstX > lastX || firstY > lastY) {
+            return;
+        }
+
+        OcclusionTriangle triangle;
+        float* edges[3] = { triangle.edgeA, triangle.edgeB, triangle.edgeC };
+        for (int i = 0; i < 3; i++) {
+            const int next = (i + 1) % 3;
+            edges[i][0] = -(y[next] - y[i]);
+            edges[i][1] = x[next] - x[i];
+            edges[i][2] = -edges[i][0] * x[i] - edges[i][1] * y[i];
+        }
+
+        const float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (z[2] - z[0])) / area;
+        const float dzdy = ((x[1] - x[0]) * (z[2] - z[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        triangle.depthA = dzdx;
+        triangle.depthB = dzdy;
+        triangle.depthC = z[0] - dzdx * x[0] - dzdy * y[0];
+
+        triangle.minX = static_cast<int32_t>(firstX);
+        triangle.minY = static_cast<int32_t>(firstY);
+        triangle.maxX = static_cast<int32_t>(lastX);
+        triangle.maxY = static_cast<int32_t>(lastY);
+
+        const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        for (int32_t tileY = triangle.minY / OCCLUSION_TILE_HEIGHT; tileY <= triangle.maxY / OCCLUSION_TILE_HEIGHT; tileY++) {
+            for (int32_t tileX = triangle.minX / OCCLUSION_TILE_WIDTH; tileX <= triangle.maxX / OCCLUSION_TILE_WIDTH; tileX++) {
+                m_tileBins[static_cast<size_t>(tileY) * m_tilesX + tileX].push_back(index);
+            }
+        }
+    }
+
+    void SoftwareOcclusionCuller::rasterize() {
+        m_tileJobs.run(m_tilesX * m_tilesY, [this](uint32_t tile) { rasterizeTile(tile); });
+    }
+
+    void SoftwareOcclusionCuller::rasterizeTile(uint32_t tile) {
+        float* depth = m_depth.data() + static_cast<size_t>(tile) * OCCLUSION_TILE_PIXELS;
+        std::fill_n(depth, OCCLUSION_TILE_PIXELS, 1.0f);
+
+        const std::vector<uint32_t>& bin = m_tileBins[tile];
+        if (bin.empty()) {
+            m_tileMaxDepth[tile] = 1.0f;
+            return;
+        }
+        m_tileMaxDepth[tile] = m_kernels.rasterizeTile(m_triangles.data(), bin.data(), bin.size(),
+            static_cast<int32_t>(tile % m_tilesX), static_cast<int32_t>(tile / m_tilesX), depth);
+    }
+
+    bool SoftwareOcclusionCuller::isVisible(const float boundsMin[3], const float boundsMax[3],
+        const float* objectToClip) const {
+        float minX = FLT_MAX;
+        float minY = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float maxY = -FLT_MAX;
+        float nearest = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            float clip[4];
+            transformPoint(objectToClip,
+                (corner & 1) ? boundsMax[0] : boundsMin[0],
+                (corner & 2) ? boundsMax[1] : boundsMin[1],
+                (corner & 4) ? boundsMax[2] : boundsMin[2], clip);
+            // Straddling the near plane: the screen rect is unbounded.
+            if (clip[3] <= 0.0f || clip[2] < 0.0f) {
+                return true;
+            }
+            const float invW = 1.0f / clip[3];
+            const float x = (clip[0] * invW * 0.5f + 0.5f) * static_cast<float>(m_width);
+            const float y = (clip[1] * invW * 0.5f + 0.5f) * static_cast<float>(m_height);
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, clip[2] * invW);
+        }
+
+        if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<float>(m_width) || minY >= static_cast<float>(m_height)) {
+            return false;
+        }
+        const int32_t firstX = static_cast<int32_t>(std::floor(std::max(minX, 0.0f)));
+        const int32_t firstY = static_cast<int32_t>(std::floor(std::max(minY, 0.0f)));
+        const int32_t lastX = static_cast<int32_t>(std::floor(std::min(maxX, static_cast<float>(m_width - 1))));
+        const int32_t lastY = static_cast<int32_t>(std::floor(std::min(maxY, static_cast<float>(m_height - 1))));
+
+        for (int32_t tileY = firstY / OCCLUSION_TILE_HEIGHT; tileY <= lastY / OCCLUSION_TILE_HEIGHT; tileY++) {
+            for (int32_t tileX = firstX / OCCLUSION_TILE_WIDTH; tileX <= lastX / OCCLUSION_TILE_WIDTH; tileX++) {
+                const size_t tile = static_cast<size_t>(tileY) * m_tilesX + tileX;
+                // Every pixel of the tile is nearer than the box.
+                if (m_tileMaxDepth[tile] < nearest) {
+                    continue;
+                }
+                const int32_t originX = tileX * OCCLUSION_TILE_WIDTH;
+                const int32_t originY = tileY * OCCLUSION_TILE_HEIGHT;
+                if (m_kernels.testTile(m_depth.data() + tile * OCCLUSION_TILE_PIXELS,
+                    std::max(firstX - originX, 0), std::max(firstY - originY, 0),
+                    std::min(lastX - originX, OCCLUSION_TILE_WIDTH - 1), std::min(lastY - originY, OCCLUSION_TILE_HEIGHT - 1),
+                    nearest)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    float SoftwareOcclusionCuller::depthAt(uint32_t x, uint32_t y) const {
+        const size_t tile = static_cast<size_t>(y / OCCLUSION_TILE_HEIGHT) * m_tilesX + x / OCCLUSION_TILE_WIDTH;
+        return m_depth[tile * OCCLUSION_TILE_PIXELS + (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH];
+    }
+}
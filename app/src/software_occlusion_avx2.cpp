@@ -0,0 +1,50 @@
+// Built with AVX2 enabled (see CMakeLists.txt) and only called after a
+// runtime CPU check. Includes nothing but the kernel header on purpose.
+#include <occlusion_kernels.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace Nashi {
+    namespace {
+        struct Avx2 {
+            using Float = __m256;
+            using Mask = __m256;
+            static constexpr int32_t WIDTH = 8;
+
+            static Float set1(float value) { return _mm256_set1_ps(value); }
+            static Float ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+            static Float load(const float* pointer) { return _mm256_loadu_ps(pointer); }
+            static void store(float* pointer, Float value) { _mm256_storeu_ps(pointer, value); }
+            static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+            static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+            static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+            static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+            static Mask greaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+            static Mask bitAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+            static Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+            static bool any(Mask mask) { return _mm256_movemask_ps(mask) != 0; }
+            static float horizontalMax(Float value) {
+                __m128 half = _mm_max_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+                half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+                half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+                return _mm_cvtss_f32(half);
+            }
+        };
+    }
+
+    OcclusionKernels avx2OcclusionKernels() {
+        OcclusionKernels kernels;
+        kernels.rasterizeTile = rasterizeOcclusionTile<Avx2>;
+        kernels.testTile = testOcclusionTile<Avx2>;
+        kernels.name = "avx2";
+        return kernels;
+    }
+}
+#else
+namespace Nashi {
+    OcclusionKernels avx2OcclusionKernels() {
+        return {};
+    }
+}
+#endif
@@ -0,0 +1,83 @@
+#include <tile_jobs.hpp>
+
+namespace Nashi {
+    TileJobs::TileJobs(uint32_t workerCount) {
+        start(workerCount);
+    }
+
+    TileJobs::~TileJobs() {
+        stop();
+    }
+
+    void TileJobs::start(uint32_t workerCount) {
+        stop();
+        m_stop = false;
+        // New workers wait for the next generation, not the ones already run.
+        for (uint32_t i = 0; i < workerCount; i++) {
+            m_workers.emplace_back(&TileJobs::workerLoop, this, m_generation);
+        }
+    }
+
+    void TileJobs::stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+        m_workers.clear();
+    }
+
+    void TileJobs::run(uint32_t tileCount, const std::function<void(uint32_t tile)>& job) {
+        m_job = &job;
+        m_tileCount = tileCount;
+        m_nextTile.store(0, std::memory_order_relaxed);
+        if (!m_workers.empty()) {
+            // Publishing the generation under the lock also publishes the
+            // job and whatever the caller set up for it.
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_generation++;
+                m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+            }
+            m_wake.notify_all();
+        }
+
+        runTiles();
+
+        if (!m_workers.empty()) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+        }
+        m_job = nullptr;
+    }
+
+    void TileJobs::runTiles() {
+        for (uint32_t tile = m_nextTile.fetch_add(1, std::memory_order_relaxed); tile < m_tileCount;
+            tile = m_nextTile.fetch_add(1, std::memory_order_relaxed)) {
+            (*m_job)(tile);
+        }
+    }
+
+    void TileJobs::workerLoop(uint64_t generation) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+                if (m_stop) {
+                    return;
+                }
+                generation = m_generation;
+            }
+
+            runTiles();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busyWorkers == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include <trace.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace Nashi {
+    namespace {
+        std::mutex& registryMutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        // Tracks are never freed, so events of threads that have exited
+        // still make it into the dump.
+        std::vector<std::unique_ptr<TraceTrack>>& registry() {
+            static std::vector<std::unique_ptr<TraceTrack>> tracks;
+            return tracks;
+        }
+
+        TraceTrack& registerTrack(std::string name) {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            auto& tracks = registry();
+            const uint32_t id = static_cast<uint32_t>(tracks.size()) + 1;
+            if (name.empty()) {
+                name = "thread " + std::to_string(id);
+            }
+            tracks.push_back(std::make_unique<TraceTrack>(id, std::move(name)));
+            return *tracks.back();
+        }
+
+        void writeJsonString(FILE* file, const char* text) {
+            fputc('"', file);
+            for (const char* c = text; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    fputc('\\', file);
+                    fputc(*c, file);
+                }
+                else if (static_cast<unsigned char>(*c) < 0x20) {
+                    fprintf(file, "\\u%04x", *c);
+                }
+                else {
+                    fputc(*c, file);
+                }
+            }
+            fputc('"', file);
+        }
+    }
+
+    TraceTrack::TraceTrack(uint32_t id, std::string name)
+        : m_id(id), m_name(std::move(name)), m_slots(new Slot[TRACE_TRACK_CAPACITY]) {
+    }
+
+    uint64_t traceNow() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    TraceTrack& threadTraceTrack() {
+        thread_local TraceTrack* track = &registerTrack({});
+        return *track;
+    }
+
+    void setTraceThreadName(const char* name) {
+        TraceTrack& track = threadTraceTrack();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        track.setName(name);
+    }
+
+    TraceTrack& createTraceTrack(const char* name) {
+        return registerTrack(name);
+    }
+
+    bool writeChromeTrace(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+
+        // Timestamps are microseconds; "X" events carry their duration.
+        fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+        bool first = true;
+        auto separator = [&]() {
+            fputs(first ? "\n" : ",\n", file);
+            first = false;
+        };
+
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const auto& track : registry()) {
+            separator();
+            fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", track->id());
+            writeJsonString(file, track->name().c_str());
+            fputs("}}", file);
+
+            track->read([&](const TraceEvent& event) {
+                if (!event.name || event.endNs < event.startNs) {
+                    return;
+                }
+                separator();
+                fputs("{\"ph\":\"X\",\"name\":", file);
+                writeJsonString(file, event.name);
+                fprintf(file, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", track->id(),
+                    static_cast<double>(event.startNs) / 1000.0, static_cast<double>(event.endNs - event.startNs) / 1000.0);
+            });
+        }
+        fputs("\n]}\n", file);
+
+        const bool written = ferror(file) == 0;
+        return fclose(file) == 0 && written;
+    }
+}
@@ -0,0 +1,238 @@
+// Headless round trip of a frame capture: records the app scene through a
+// FrameRecorder, reads the file back and replays it the way nashi_replay's
+// full mode does, onto a renderer that only logs. No GPU or window needed.
+//
+//   nashi_capture_check
+//
+// Exits non-zero if the capture is missing records or the replay submits,
+// writes or draws anything other than what was recorded.
+#include <app_scene.hpp>
+#include <frame_capture.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t CAPTURE_FRAMES = 6;
+    // The frame that switches the basic pipeline permutation.
+    constexpr uint32_t VARIANT_SWITCH_FRAME = 3;
+
+    struct LoggedBuffer {
+        std::vector<uint8_t> data;
+        bool hostVisible = false;
+        // Creation order, which replays keep while handles change.
+        uint32_t ordinal = 0;
+    };
+
+    // Stands in for a backend: buffers are plain memory, every submitted
+    // packet goes to the log with resources named by creation order, and
+    // draw() logs the contents of every live buffer.
+    class LoggingRenderer {
+    public:
+        std::vector<std::string> log;
+
+        Nashi::BufferHandle createBuffer(const Nashi::BufferDesc& desc) {
+            LoggedBuffer buffer;
+            buffer.data.assign(static_cast<size_t>(desc.size), 0);
+            if (desc.initialData) {
+                memcpy(buffer.data.data(), desc.initialData, buffer.data.size());
+            }
+            buffer.hostVisible = desc.hostVisible;
+            buffer.ordinal = m_nextOrdinal++;
+            Nashi::BufferHandle handle = m_buffers.create(std::move(buffer));
+            m_liveBuffers[m_nextOrdinal - 1] = handle;
+            return handle;
+        }
+
+        void destroyBuffer(Nashi::BufferHandle handle) {
+            if (std::optional<LoggedBuffer> buffer = m_buffers.remove(handle)) {
+                m_liveBuffers.erase(buffer->ordinal);
+            }
+        }
+
+        void* getMappedData(Nashi::BufferHandle handle) {
+            LoggedBuffer* buffer = m_buffers.get(handle);
+            return buffer && buffer->hostVisible ? buffer->data.data() : nullptr;
+        }
+
+        Nashi::PipelineHandle basicPipeline(uint32_t variantKey) {
+            return m_pipelines.create(variantKey);
+        }
+
+        Nashi::LinearArena& frameArena() {
+            return m_frameArenas.current();
+        }
+
+        void submit(const Nashi::CommandStream& stream) {
+            for (const Nashi::CommandHeader* cmd = stream.first(); cmd; cmd = Nashi::CommandStream::next(cmd)) {
+                log.push_back(describe(cmd));
+            }
+        }
+
+        void draw() {
+            log.push_back("draw");
+            for (const auto& [ordinal, handle] : m_liveBuffers) {
+                const LoggedBuffer* buffer = m_buffers.get(handle);
+                log.push_back("buffer " + std::to_string(ordinal) + " holds " +
+                    std::string(buffer->data.begin(), buffer->data.end()));
+            }
+            m_frameArenas.endFrame();
+        }
+
+    private:
+        std::string buffer(Nashi::BufferHandle handle) {
+            const LoggedBuffer* buffer = m_buffers.get(handle);
+            return buffer ? "buffer " + std::to_string(buffer->ordinal) : "a stale buffer";
+        }
+
+        std::string describe(const Nashi::CommandHeader* cmd) {
+            switch (cmd->type) {
+            case Nashi::CommandType::BindPipeline: {
+                const uint32_t* variantKey = m_pipelines.get(Nashi::commandAs<Nashi::CmdBindPipeline>(cmd).pipeline);
+                return variantKey ? "bind pipeline " + std::to_string(*variantKey) : "bind a stale pipeline";
+            }
+            case Nashi::CommandType::BindVertexBuffer: {
+                const auto& bind = Nashi::commandAs<Nashi::CmdBindVertexBuffer>(cmd);
+                return "bind vertex " + buffer(bind.buffer) + " at " + std::to_string(bind.offset);
+            }
+            case Nashi::CommandType::BindIndexBuffer: {
+                const auto& bind = Nashi::commandAs<Nashi::CmdBindIndexBuffer>(cmd);
+                return "bind index " + buffer(bind.buffer) + " at " + std::to_string(bind.offset) +
+                    (bind.indexType == Nashi::IndexType::UInt16 ? " as uint16" : " as uint32");
+            }
+            case Nashi::CommandType::DrawIndexed: {
+                const auto& draw = Nashi::commandAs<Nashi::CmdDrawIndexed>(cmd);
+                return "draw " + std::to_string(draw.indexCount) + " indices from " + std::to_string(draw.firstIndex) +
+                    ", " + std::to_string(draw.instanceCount) + " instances";
+            }
+            default:
+                return "command " + std::to_string(static_cast<int>(cmd->type));
+            }
+        }
+
+        Nashi::HandlePool<LoggedBuffer, Nashi::BufferTag> m_buffers;
+        Nashi::HandlePool<uint32_t, Nashi::PipelineTag> m_pipelines;
+        std::map<uint32_t, Nashi::BufferHandle> m_liveBuffers;
+        uint32_t m_nextOrdinal = 0;
+        Nashi::FrameArenas m_frameArenas{ Nashi::MAX_FRAME_QUEUE_DEPTH, Nashi::FRAME_ARENA_SIZE };
+    };
+
+    bool fail(const std::string& what) {
+        std::cerr << what << std::endl;
+        return false;
+    }
+
+    bool record(LoggingRenderer& renderer, const std::filesystem::path& path) {
+        using Recorder = Nashi::FrameRecorder<LoggingRenderer>;
+        Recorder recorder(renderer, path, CAPTURE_FRAMES);
+        if (!recorder.capturing()) {
+            return fail("could not open " + path.string());
+        }
+
+        Nashi::AppScene<Recorder> scene;
+        scene.create(recorder);
+        Nashi::AppSceneFrame sceneFrame;
+        for (uint32_t frame = 0; frame < CAPTURE_FRAMES; frame++) {
+            if (scene.build(sceneFrame, frame, frame < VARIANT_SWITCH_FRAME ? 0 : Nashi::BASIC_FEATURE_DESATURATE)) {
+                scene.submit(recorder, sceneFrame);
+            }
+            recorder.draw();
+        }
+        if (recorder.capturing()) {
+            return fail("the capture did not close after its last frame");
+        }
+        scene.destroy(recorder);
+        return true;
+    }
+
+    bool checkRecords(const Nashi::FrameCaptureReader& capture) {
+        if (capture.frameCount() != CAPTURE_FRAMES) {
+            return fail("expected " + std::to_string(CAPTURE_FRAMES) + " frames, read " + std::to_string(capture.frameCount()));
+        }
+
+        std::map<Nashi::CaptureRecordType, uint32_t> counts;
+        for (const Nashi::CaptureRecord& record : capture.records()) {
+            counts[record.type]++;
+        }
+        // The scene's two buffers, a pipeline for each permutation, and a
+        // write, a stream and a draw every frame: each frame's vertex slice
+        // differs from what the slice held before.
+        const std::pair<Nashi::CaptureRecordType, uint32_t> expected[] = {
+            { Nashi::CaptureRecordType::CreateBuffer, 2 },
+            { Nashi::CaptureRecordType::DestroyBuffer, 0 },
+            { Nashi::CaptureRecordType::BasicPipeline, 2 },
+            { Nashi::CaptureRecordType::WriteBuffer, CAPTURE_FRAMES },
+            { Nashi::CaptureRecordType::Submit, CAPTURE_FRAMES },
+            { Nashi::CaptureRecordType::EndFrame, CAPTURE_FRAMES },
+        };
+        for (const auto& [type, count] : expected) {
+            if (counts[type] != count) {
+                return fail("expected " + std::to_string(count) + " records of type " + std::to_string(static_cast<int>(type)) +
+                    ", read " + std::to_string(counts[type]));
+            }
+        }
+        return true;
+    }
+
+    void replay(LoggingRenderer& renderer, const Nashi::FrameCaptureReader& capture) {
+        Nashi::CaptureReplayState state;
+        for (const Nashi::CaptureRecord& record : capture.records()) {
+            if (record.type == Nashi::CaptureRecordType::Submit) {
+                Nashi::CommandEncoder encoder(renderer.frameArena());
+                if (!Nashi::encodeCapturedStream(record, state.handles, encoder)) {
+                    renderer.log.push_back("a stream that did not replay");
+                }
+                renderer.submit(encoder.finish());
+            }
+            else if (record.type == Nashi::CaptureRecordType::EndFrame) {
+                renderer.draw();
+            }
+            else {
+                Nashi::applyCaptureResourceRecord(renderer, record, state);
+            }
+        }
+    }
+}
+
+int main() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "nashi_capture_check.ncap";
+
+    LoggingRenderer recorded;
+    if (!record(recorded, path)) {
+        return EXIT_FAILURE;
+    }
+
+    Nashi::FrameCaptureReader capture;
+    std::string error;
+    if (!capture.open(path, error)) {
+        std::cerr << path.string() << ": " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!checkRecords(capture)) {
+        return EXIT_FAILURE;
+    }
+
+    LoggingRenderer replayed;
+    replay(replayed, capture);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    for (size_t i = 0; i < std::max(recorded.log.size(), replayed.log.size()); i++) {
+        const std::string want = i < recorded.log.size() ? recorded.log[i] : "nothing";
+        const std::string got = i < replayed.log.size() ? replayed.log[i] : "nothing";
+        if (want != got) {
+            // Buffer contents are raw bytes, so only their first words.
+            std::cerr << "entry " << i << " of the replay differs: recorded \"" << want.substr(0, 24)
+                << "\", replayed \"" << got.substr(0, 24) << "\"" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << capture.frameCount() << " frames, " << capture.records().size() << " records: replay matches" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+// Headless check of SoftwareOcclusionCuller with every kernel set this CPU
+// runs, single-threaded and with workers. No GPU or window needed.
+//
+//   nashi_occlusion_check
+//
+// Exits non-zero on the first case a kernel set gets wrong.
+#include <software_occlusion.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace {
+    // Clip space straight from object space: x and y span the screen over
+    // [-1, 1], z is depth and w stays 1.
+    const float IDENTITY[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+
+    // A quad over the middle of the screen at depth 0.3, as two triangles
+    // of opposite winding.
+    const float OCCLUDER_POSITIONS[] = {
+        -0.5f, -0.5f, 0.3f,
+         0.5f, -0.5f, 0.3f,
+         0.5f,  0.5f, 0.3f,
+        -0.5f,  0.5f, 0.3f,
+    };
+    const uint16_t OCCLUDER_INDICES[] = { 0, 1, 2, 0, 3, 2 };
+
+    struct BoxCase {
+        const char* name;
+        float boundsMin[3];
+        float boundsMax[3];
+        bool visible;
+    };
+
+    const BoxCase OCCLUDED_CASES[] = {
+        { "behind the occluder", { -0.25f, -0.25f, 0.5f }, { 0.25f, 0.25f, 0.6f }, false },
+        { "in front of the occluder", { -0.25f, -0.25f, 0.1f }, { 0.25f, 0.25f, 0.2f }, true },
+        { "partly beside the occluder", { 0.25f, -0.25f, 0.5f }, { 0.75f, 0.25f, 0.6f }, true },
+        { "crossing the occluder's depth", { -0.25f, -0.25f, 0.2f }, { 0.25f, 0.25f, 0.4f }, true },
+        { "beside the occluder", { 0.6f, 0.6f, 0.5f }, { 0.9f, 0.9f, 0.6f }, true },
+        { "off screen", { 2.0f, 2.0f, 0.5f }, { 3.0f, 3.0f, 0.6f }, false },
+        { "straddling the near plane", { -0.25f, -0.25f, -0.1f }, { 0.25f, 0.25f, 0.6f }, true },
+    };
+
+    bool fail(const std::string& kernels, uint32_t workers, const std::string& what) {
+        std::cerr << kernels << ", " << workers << " workers: " << what << std::endl;
+        return false;
+    }
+
+    // A size that is not a whole number of tiles, so edge tiles are covered.
+    bool check(const Nashi::OcclusionKernels& kernels, uint32_t workers) {
+        Nashi::SoftwareOcclusionCuller culler(100, 60, kernels, workers);
+
+        culler.beginFrame();
+        culler.rasterize();
+        const BoxCase& hidden = OCCLUDED_CASES[0];
+        if (!culler.isVisible(hidden.boundsMin, hidden.boundsMax, IDENTITY)) {
+            return fail(kernels.name, workers, "box hidden without any occluder");
+        }
+
+        // Twice, so the second frame also proves beginFrame() resets.
+        for (int frame = 0; frame < 2; frame++) {
+            culler.beginFrame();
+            culler.addOccluder(OCCLUDER_POSITIONS, sizeof(float) * 3, OCCLUDER_INDICES, 6, IDENTITY);
+            culler.rasterize();
+
+            if (culler.triangleCount() != 2) {
+                return fail(kernels.name, workers, "expected 2 occluder triangles, got " + std::to_string(culler.triangleCount()));
+            }
+            if (std::fabs(culler.depthAt(culler.width() / 2, culler.height() / 2) - 0.3f) > 1e-4f) {
+                return fail(kernels.name, workers, "wrong depth under the occluder");
+            }
+            if (culler.depthAt(0, 0) != 1.0f || culler.depthAt(culler.width() - 1, culler.height() - 1) != 1.0f) {
+                return fail(kernels.name, workers, "depth written outside the occluder");
+            }
+
+            for (const BoxCase& box : OCCLUDED_CASES) {
+                if (culler.isVisible(box.boundsMin, box.boundsMax, IDENTITY) != box.visible) {
+                    return fail(kernels.name, workers, std::string("box ") + box.name + " should be " +
+                        (box.visible ? "visible" : "culled"));
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main() {
+    bool passed = true;
+    for (const Nashi::OcclusionKernels& kernels : Nashi::supportedOcclusionKernels()) {
+        for (uint32_t workers : { 0u, 3u }) {
+            if (check(kernels, workers)) {
+                std::cout << kernels.name << ", " << workers << " workers: ok" << std::endl;
+            }
+            else {
+                passed = false;
+            }
+        }
+    }
+    return passed ? 0 : 1;
+}
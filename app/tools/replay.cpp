@@ -0,0 +1,298 @@
+// Plays a frame capture back as fast as the backend allows, so two builds
+// can be timed against the same workload.
+//
+//   nashi_replay <capture> [--mode=full|cpu|gpu] [--loops=N] [--headless]
+//
+//   full  Per frame: apply the capture's buffer writes, encode its streams
+//         into the frame arena, submit them and draw. The frame as captured.
+//   cpu   The same without submit and draw(), which times the application
+//         side of a frame on its own.
+//   gpu   Buffers, writes and streams are set up once before the first
+//         frame; frames only submit the encoded streams and draw, which
+//         leaves the GPU as the bottleneck.
+//
+// Every loop plays all captured frames; full and cpu create and destroy the
+// capture's buffers again each loop. Frame pacing takes the usual
+// --present=/--frames=/--fps= arguments but defaults to immediate presents.
+// --headless renders without a window and needs the software backend.
+#ifdef NASHI_USE_VULKAN
+#   include <renderer_vk.hpp>
+#elif NASHI_USE_OPENGL
+#   include <renderer_gl.hpp>
+#elif NASHI_USE_DIRECT3D12
+#   include <renderer_d3d12.hpp>
+#elif NASHI_USE_SOFTWARE
+#   include <renderer_sw.hpp>
+#endif
+
+#include <frame_capture.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class ReplayMode {
+    Full,
+    Cpu,
+    Gpu,
+};
+
+struct ReplayOptions {
+    ReplayMode mode = ReplayMode::Full;
+    uint32_t loops = 1;
+    Nashi::FramePacingPolicy pacing;
+    // Set when there is a window whose events need pumping.
+    bool pumpEvents = false;
+};
+
+static const char* replayModeName(ReplayMode mode) {
+    switch (mode) {
+    case ReplayMode::Full: return "full";
+    case ReplayMode::Cpu: return "cpu";
+    case ReplayMode::Gpu: return "gpu";
+    }
+    return "unknown";
+}
+
+// The replay's resources, and whether a broken stream was reported yet.
+struct ReplayState : Nashi::CaptureReplayState {
+    bool reportedBadStream = false;
+};
+
+static Nashi::CommandStream encodeStream(const Nashi::CaptureRecord& submit, ReplayState& state, Nashi::LinearArena& arena) {
+    Nashi::CommandEncoder encoder(arena);
+    if (!Nashi::encodeCapturedStream(submit, state.handles, encoder) && !state.reportedBadStream) {
+        std::cerr << "a captured stream did not replay completely" << std::endl;
+        state.reportedBadStream = true;
+    }
+    return encoder.finish();
+}
+
+template<typename Renderer>
+static void destroyBuffers(Renderer& renderer, ReplayState& state) {
+    for (const auto& [captured, buffer] : state.handles.buffers) {
+        renderer.destroyBuffer(buffer);
+    }
+    state.handles.buffers.clear();
+    state.bufferSizes.clear();
+}
+
+template<typename Renderer>
+static int replay(Renderer& renderer, const Nashi::FrameCaptureReader& capture, const ReplayOptions& options) {
+    renderer.setFramePacing(options.pacing);
+    renderer.init();
+
+    ReplayState state;
+    // cpu mode has no draw() to cycle the frame arenas, so it encodes here.
+    Nashi::LinearArena cpuArena(Nashi::FRAME_ARENA_SIZE);
+    // gpu mode encodes every stream once, into an arena sized for all of them.
+    std::vector<std::vector<Nashi::CommandStream>> gpuStreams;
+    std::unique_ptr<Nashi::LinearArena> gpuArena;
+    if (options.mode == ReplayMode::Gpu) {
+        size_t streamBytes = 0;
+        for (const Nashi::CaptureRecord& record : capture.records()) {
+            if (record.type == Nashi::CaptureRecordType::Submit) {
+                streamBytes += record.size + 2 * Nashi::COMMAND_BLOCK_SIZE;
+            }
+            // Destroys wait until the end, the streams may still use the buffers.
+            else if (record.type != Nashi::CaptureRecordType::DestroyBuffer) {
+                Nashi::applyCaptureResourceRecord(renderer, record, state);
+            }
+        }
+        gpuArena = std::make_unique<Nashi::LinearArena>(std::max<size_t>(streamBytes, 1));
+        gpuStreams.resize(capture.frameCount());
+        for (uint32_t frame = 0; frame < capture.frameCount(); frame++) {
+            for (const Nashi::CaptureRecord& record : capture.frame(frame)) {
+                if (record.type == Nashi::CaptureRecordType::Submit) {
+                    gpuStreams[frame].push_back(encodeStream(record, state, *gpuArena));
+                }
+            }
+        }
+    }
+
+    uint64_t frames = 0;
+    uint64_t totalNs = 0;
+    uint64_t worstNs = 0;
+    for (uint32_t loop = 0; loop < options.loops; loop++) {
+        for (uint32_t frame = 0; frame < capture.frameCount(); frame++) {
+            if (options.pumpEvents) {
+                SDL_PumpEvents();
+            }
+
+            const uint64_t startNs = SDL_GetTicksNS();
+            if (options.mode == ReplayMode::Gpu) {
+                for (const Nashi::CommandStream& stream : gpuStreams[frame]) {
+                    renderer.submit(stream);
+                }
+                renderer.draw();
+            }
+            else {
+                for (const Nashi::CaptureRecord& record : capture.frame(frame)) {
+                    if (record.type == Nashi::CaptureRecordType::Submit) {
+                        if (options.mode == ReplayMode::Full) {
+                            renderer.submit(encodeStream(record, state, renderer.frameArena()));
+                        }
+                        else {
+                            encodeStream(record, state, cpuArena);
+                        }
+                    }
+                    else if (record.type == Nashi::CaptureRecordType::EndFrame) {
+                        if (options.mode == ReplayMode::Full) {
+                            renderer.draw();
+                        }
+                        else {
+                            cpuArena.reset();
+                        }
+                    }
+                    else {
+                        // As in the application, writes land before draw()
+                        // waits for the frame slot. The captured offsets keep
+                        // AppScene's spare slice, so that is safe here too.
+                        Nashi::applyCaptureResourceRecord(renderer, record, state);
+                    }
+                }
+            }
+            const uint64_t frameNs = SDL_GetTicksNS() - startNs;
+
+            frames++;
+            totalNs += frameNs;
+            worstNs = std::max(worstNs, frameNs);
+        }
+        if (options.mode != ReplayMode::Gpu) {
+            destroyBuffers(renderer, state);
+        }
+    }
+    destroyBuffers(renderer, state);
+
+    std::cout << replayModeName(options.mode) << ": " << frames << " frames, "
+        << totalNs / 1e6 / std::max<uint64_t>(frames, 1) << " ms per frame, worst " << worstNs / 1e6 << " ms" << std::endl;
+#if defined(NASHI_USE_VULKAN) || defined(NASHI_USE_OPENGL)
+    if (options.mode != ReplayMode::Cpu) {
+        std::cout << Nashi::formatRenderStats(renderer.renderStats().average()) << std::endl;
+    }
+#endif
+
+    renderer.cleanup();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: nashi_replay <capture> [--mode=full|cpu|gpu] [--loops=N] [--headless]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ReplayOptions options;
+    options.pacing = Nashi::parseFramePacingArgs(argc, argv);
+    bool presentModeSet = false;
+    bool headless = false;
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--mode=full") {
+            options.mode = ReplayMode::Full;
+        }
+        else if (arg == "--mode=cpu") {
+            options.mode = ReplayMode::Cpu;
+        }
+        else if (arg == "--mode=gpu") {
+            options.mode = ReplayMode::Gpu;
+        }
+        else if (arg.starts_with("--mode=")) {
+            std::cerr << "unknown replay mode: " << arg.substr(std::string_view("--mode=").size()) << std::endl;
+            return EXIT_FAILURE;
+        }
+        else if (arg.starts_with("--loops=")) {
+            options.loops = static_cast<uint32_t>(std::max(std::atoi(argv[i] + arg.find('=') + 1), 1));
+        }
+        else if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg.starts_with("--present=")) {
+            presentModeSet = true;
+        }
+    }
+    if (!presentModeSet) {
+        options.pacing.presentMode = Nashi::PresentMode::Immediate;
+    }
+
+    Nashi::FrameCaptureReader capture;
+    std::string error;
+    if (!capture.open(argv[1], error)) {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    if (headless) {
+#ifdef NASHI_USE_SOFTWARE
+        Nashi::SoftwareRenderer renderer(nullptr, event);
+        return replay(renderer, capture, options);
+#else
+        std::cerr << "--headless needs the software backend" << std::endl;
+        return EXIT_FAILURE;
+#endif
+    }
+
+#ifdef NASHI_USE_OPENGL
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+#endif
+
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        std::cerr << "SDL_Init failed: " << SDL_GetError() << std::endl;
+        return EXIT_FAILURE;
+    }
+    SDL_Window* window = SDL_CreateWindow(SDL_WINDOW_NAME, 1280, 720,
+#ifdef NASHI_USE_VULKAN
+        SDL_WINDOW_VULKAN
+#elif NASHI_USE_OPENGL
+        SDL_WINDOW_OPENGL
+#else
+        0
+#endif
+    );
+    if (!window) {
+        std::cerr << "SDL_CreateWindow failed: " << SDL_GetError() << std::endl;
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    options.pumpEvents = true;
+
+    int result = EXIT_FAILURE;
+#ifdef NASHI_USE_VULKAN
+    Uint32 instanceExtensionCount = 0;
+    const char* const* instanceExtensions = SDL_Vulkan_GetInstanceExtensions(&instanceExtensionCount);
+    if (instanceExtensions) {
+        std::vector<const char*> extensions(instanceExtensions, instanceExtensions + instanceExtensionCount);
+        extensions.insert(extensions.begin(), VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+        Nashi::VulkanRenderer renderer(extensions.data(), static_cast<int>(extensions.size()), window, event);
+        result = replay(renderer, capture, options);
+    }
+    else {
+        std::cerr << "SDL_Vulkan_GetInstanceExtensions failed: " << SDL_GetError() << std::endl;
+    }
+#elif NASHI_USE_OPENGL
+    Nashi::OpenGLRenderer renderer(window, event);
+    result = replay(renderer, capture, options);
+#elif NASHI_USE_DIRECT3D12
+    HWND hwnd = (HWND)SDL_GetPointerProperty(SDL_GetWindowProperties(window), SDL_PROP_WINDOW_WIN32_HWND_POINTER, NULL);
+    Nashi::Direct3D12Renderer renderer(window, event, hwnd);
+    result = replay(renderer, capture, options);
+#elif NASHI_USE_SOFTWARE
+    Nashi::SoftwareRenderer renderer(window, event);
+    result = replay(renderer, capture, options);
+#endif
+
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return result;
+}
@@ -0,0 +1,126 @@
+// Packs compiled shader stages into a single indexed library (shaders.nsl).
+//
+//   nashi_shaderpack <output> [--reflect=<spv>]... <artifact>...
+//
+// Every artifact is stored under its file name, e.g. "basic.vert.spv". Every
+// --reflect module is reflected into a "<stage>.refl" entry instead, e.g.
+// "basic.vert.refl", and is not stored itself.
+#include <shader_library.hpp>
+
+#include "spirv_reflect.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct PackedShader {
+    std::string name;
+    uint64_t hash;
+    std::vector<char> data;
+};
+
+static bool readArtifact(const std::filesystem::path& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: nashi_shaderpack <output> [--reflect=<spv>]... <artifact>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<PackedShader> shaders;
+    for (int i = 2; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        const bool reflect = arg.starts_with("--reflect=");
+        std::filesystem::path path = reflect ? arg.substr(std::string_view("--reflect=").size()) : arg;
+
+        PackedShader shader;
+        shader.name = path.filename().string();
+        if (!readArtifact(path, shader.data)) {
+            std::cerr << "failed to read shader artifact: " << path.string() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (reflect) {
+            Nashi::ShaderReflection reflection;
+            std::string error;
+            if (!reflectSpirv(shader.data, reflection, error)) {
+                std::cerr << "failed to reflect " << path.string() << ": " << error << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            std::vector<uint8_t> sidecar = reflection.serialize();
+            shader.name = path.stem().string() + ".refl";
+            shader.data.assign(sidecar.begin(), sidecar.end());
+        }
+
+        shader.hash = Nashi::hashShaderName(shader.name);
+        shaders.push_back(std::move(shader));
+    }
+
+    std::sort(shaders.begin(), shaders.end(),
+        [](const PackedShader& a, const PackedShader& b) { return a.hash < b.hash; });
+
+    for (size_t i = 1; i < shaders.size(); ++i) {
+        if (shaders[i].hash == shaders[i - 1].hash) {
+            std::cerr << "shader name hash collision: " << shaders[i - 1].name
+                << " / " << shaders[i].name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    Nashi::ShaderLibraryHeader header{};
+    header.magic = Nashi::SHADER_LIBRARY_MAGIC;
+    header.version = Nashi::SHADER_LIBRARY_VERSION;
+    header.entryCount = static_cast<uint32_t>(shaders.size());
+
+    std::vector<Nashi::ShaderLibraryEntry> entries(shaders.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(Nashi::ShaderLibraryEntry);
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        offset = alignUp(offset, Nashi::SHADER_LIBRARY_ALIGNMENT);
+        entries[i].hash = shaders[i].hash;
+        entries[i].offset = offset;
+        entries[i].size = shaders[i].data.size();
+        offset += shaders[i].data.size();
+    }
+
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "failed to open output: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+        static_cast<std::streamsize>(entries.size() * sizeof(Nashi::ShaderLibraryEntry)));
+
+    uint64_t written = sizeof(header) + entries.size() * sizeof(Nashi::ShaderLibraryEntry);
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        static const char padding[Nashi::SHADER_LIBRARY_ALIGNMENT] = {};
+        out.write(padding, static_cast<std::streamsize>(entries[i].offset - written));
+        out.write(shaders[i].data.data(), static_cast<std::streamsize>(shaders[i].data.size()));
+        written = entries[i].offset + entries[i].size;
+    }
+
+    if (!out) {
+        std::cerr << "failed to write shader library: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+#include "spirv_reflect.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+    enum Op : uint32_t {
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpDecorateString = 5632,
+    };
+
+    enum Decoration : uint32_t {
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationBuiltIn = 11,
+        DecorationNonWritable = 24,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+        DecorationHlslSemantic = 5635,
+    };
+
+    enum StorageClass : uint32_t {
+        StorageClassUniformConstant = 0,
+        StorageClassInput = 1,
+        StorageClassUniform = 2,
+        StorageClassPushConstant = 9,
+        StorageClassStorageBuffer = 12,
+    };
+
+    enum ExecutionModel : uint32_t {
+        ExecutionModelVertex = 0,
+        ExecutionModelFragment = 4,
+        ExecutionModelGLCompute = 5,
+    };
+
+    struct Type {
+        uint32_t op = 0;
+        std::vector<uint32_t> operands;
+    };
+
+    struct Decorations {
+        bool block = false;
+        bool bufferBlock = false;
+        bool builtIn = false;
+        bool nonWritable = false;
+        uint32_t nonWritableMembers = 0;
+        uint32_t arrayStride = 0;
+        int64_t location = -1;
+        int64_t binding = -1;
+        int64_t set = -1;
+        std::string semantic;
+        std::vector<uint32_t> memberOffsets;
+    };
+
+    struct Variable {
+        uint32_t id;
+        uint32_t pointerType;
+        uint32_t storageClass;
+    };
+
+    struct Module {
+        uint32_t stage = 0;
+        std::unordered_map<uint32_t, Type> types;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, Decorations> decorations;
+        std::vector<Variable> variables;
+
+        const Type* type(uint32_t id) const {
+            auto it = types.find(id);
+            return it != types.end() ? &it->second : nullptr;
+        }
+
+        const Decorations& decoration(uint32_t id) const {
+            static const Decorations none;
+            auto it = decorations.find(id);
+            return it != decorations.end() ? it->second : none;
+        }
+
+        uint32_t sizeOf(uint32_t id) const {
+            const Type* t = type(id);
+            if (!t) {
+                return 0;
+            }
+
+            switch (t->op) {
+            case OpTypeInt:
+            case OpTypeFloat:
+                return t->operands[0] / 8;
+            case OpTypeVector:
+                return t->operands[1] * sizeOf(t->operands[0]);
+            case OpTypeMatrix:
+                // Columns follow std140/std430 rules: each one occupies a full vec4 slot.
+                return t->operands[1] * std::max(sizeOf(t->operands[0]), 16u);
+            case OpTypeArray: {
+                auto length = constants.find(t->operands[1]);
+                uint32_t count = length != constants.end() ? length->second : 1;
+                uint32_t stride = decoration(id).arrayStride;
+                return count * (stride ? stride : sizeOf(t->operands[0]));
+            }
+            case OpTypeStruct: {
+                const auto& offsets = decoration(id).memberOffsets;
+                uint32_t size = 0;
+                for (size_t i = 0; i < t->operands.size(); ++i) {
+                    uint32_t offset = i < offsets.size() ? offsets[i] : size;
+                    size = std::max(size, offset + sizeOf(t->operands[i]));
+                }
+                return size;
+            }
+            default:
+                return 0;
+            }
+        }
+    };
+
+    std::string readString(const uint32_t* words, size_t count) {
+        const char* chars = reinterpret_cast<const char*>(words);
+        return std::string(chars, strnlen(chars, count * sizeof(uint32_t)));
+    }
+
+    Nashi::ReflectedFormat vertexFormat(const Module& module, uint32_t typeId) {
+        const Type* t = module.type(typeId);
+        if (!t) {
+            return Nashi::ReflectedFormat::Unknown;
+        }
+
+        uint32_t components = 1;
+        if (t->op == OpTypeVector) {
+            components = t->operands[1];
+            t = module.type(t->operands[0]);
+        }
+        if (!t || components < 1 || components > 4 || t->operands[0] != 32) {
+            return Nashi::ReflectedFormat::Unknown;
+        }
+
+        uint32_t base;
+        if (t->op == OpTypeFloat) {
+            base = static_cast<uint32_t>(Nashi::ReflectedFormat::Float1);
+        }
+        else if (t->op == OpTypeInt && t->operands[1] != 0) {
+            base = static_cast<uint32_t>(Nashi::ReflectedFormat::Int1);
+        }
+        else if (t->op == OpTypeInt) {
+            base = static_cast<uint32_t>(Nashi::ReflectedFormat::UInt1);
+        }
+        else {
+            return Nashi::ReflectedFormat::Unknown;
+        }
+        return static_cast<Nashi::ReflectedFormat>(base + components - 1);
+    }
+}
+
+bool reflectSpirv(const std::vector<char>& code, Nashi::ShaderReflection& reflection, std::string& error) {
+    if (code.size() < 5 * sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0) {
+        error = "not a SPIR-V module";
+        return false;
+    }
+
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    memcpy(words.data(), code.data(), code.size());
+    if (words[0] != SPIRV_MAGIC) {
+        error = "bad SPIR-V magic";
+        return false;
+    }
+
+    Module module;
+    for (size_t pos = 5; pos < words.size(); ) {
+        uint32_t wordCount = words[pos] >> 16;
+        uint32_t opcode = words[pos] & 0xffff;
+        if (wordCount == 0 || pos + wordCount > words.size()) {
+            error = "truncated SPIR-V instruction";
+            return false;
+        }
+        const uint32_t* ops = &words[pos + 1];
+        const uint32_t opCount = wordCount - 1;
+
+        switch (opcode) {
+        case OpEntryPoint:
+            if (ops[0] == ExecutionModelVertex) module.stage = Nashi::SHADER_STAGE_VERTEX;
+            else if (ops[0] == ExecutionModelFragment) module.stage = Nashi::SHADER_STAGE_FRAGMENT;
+            else if (ops[0] == ExecutionModelGLCompute) module.stage = Nashi::SHADER_STAGE_COMPUTE;
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+            module.types[ops[0]] = { opcode, std::vector<uint32_t>(ops + 1, ops + opCount) };
+            break;
+        case OpConstant:
+            module.constants[ops[1]] = ops[2];
+            break;
+        case OpVariable:
+            module.variables.push_back({ ops[1], ops[0], ops[2] });
+            break;
+        case OpDecorate: {
+            Decorations& d = module.decorations[ops[0]];
+            switch (ops[1]) {
+            case DecorationBlock: d.block = true; break;
+            case DecorationBufferBlock: d.bufferBlock = true; break;
+            case DecorationBuiltIn: d.builtIn = true; break;
+            case DecorationNonWritable: d.nonWritable = true; break;
+            case DecorationArrayStride: d.arrayStride = ops[2]; break;
+            case DecorationLocation: d.location = ops[2]; break;
+            case DecorationBinding: d.binding = ops[2]; break;
+            case DecorationDescriptorSet: d.set = ops[2]; break;
+            }
+            break;
+        }
+        case OpMemberDecorate:
+            if (ops[2] == DecorationNonWritable) {
+                module.decorations[ops[0]].nonWritableMembers++;
+            }
+            else if (ops[2] == DecorationOffset) {
+                auto& offsets = module.decorations[ops[0]].memberOffsets;
+                if (offsets.size() <= ops[1]) {
+                    offsets.resize(ops[1] + 1, 0);
+                }
+                offsets[ops[1]] = ops[3];
+            }
+            break;
+        case OpDecorateString:
+            if (ops[1] == DecorationHlslSemantic) {
+                module.decorations[ops[0]].semantic = readString(ops + 2, opCount - 2);
+            }
+            break;
+        }
+
+        pos += wordCount;
+    }
+
+    reflection = {};
+    reflection.stageMask = module.stage;
+
+    for (const Variable& variable : module.variables) {
+        const Type* pointer = module.type(variable.pointerType);
+        if (!pointer || pointer->op != OpTypePointer) {
+            continue;
+        }
+        uint32_t pointee = pointer->operands[1];
+        const Decorations& decoration = module.decoration(variable.id);
+
+        if (variable.storageClass == StorageClassInput) {
+            if (module.stage != Nashi::SHADER_STAGE_VERTEX || decoration.builtIn || decoration.location < 0) {
+                continue;
+            }
+            Nashi::ReflectedVertexInput input{};
+            input.location = static_cast<uint32_t>(decoration.location);
+            input.format = vertexFormat(module, pointee);
+            strncpy(input.semantic, decoration.semantic.c_str(), sizeof(input.semantic) - 1);
+            reflection.vertexInputs.push_back(input);
+            continue;
+        }
+
+        if (variable.storageClass == StorageClassPushConstant) {
+            const auto& offsets = module.decoration(pointee).memberOffsets;
+            uint32_t offset = offsets.empty() ? 0 : *std::min_element(offsets.begin(), offsets.end());
+            reflection.pushConstants.push_back({ offset, module.sizeOf(pointee) - offset, module.stage });
+            continue;
+        }
+
+        if (decoration.binding < 0) {
+            continue;
+        }
+
+        Nashi::ReflectedBinding binding{};
+        binding.set = decoration.set < 0 ? 0 : static_cast<uint32_t>(decoration.set);
+        binding.binding = static_cast<uint32_t>(decoration.binding);
+        binding.count = 1;
+        binding.stageMask = module.stage;
+
+        const Type* t = module.type(pointee);
+        if (t && (t->op == OpTypeArray || t->op == OpTypeRuntimeArray)) {
+            if (t->op == OpTypeArray) {
+                auto length = module.constants.find(t->operands[1]);
+                binding.count = length != module.constants.end() ? length->second : 1;
+            }
+            else {
+                binding.count = 0;
+            }
+            pointee = t->operands[0];
+            t = module.type(pointee);
+        }
+        if (!t) {
+            continue;
+        }
+
+        const Decorations& typeDecoration = module.decoration(pointee);
+        if (variable.storageClass == StorageClassUniform && typeDecoration.block) {
+            binding.type = Nashi::ReflectedDescriptorType::UniformBuffer;
+            binding.size = module.sizeOf(pointee);
+        }
+        else if (variable.storageClass == StorageClassStorageBuffer ||
+            (variable.storageClass == StorageClassUniform && typeDecoration.bufferBlock)) {
+            // DXC marks every member of a StructuredBuffer's block NonWritable.
+            const bool readOnly = decoration.nonWritable ||
+                (t->op == OpTypeStruct && !t->operands.empty() && typeDecoration.nonWritableMembers >= t->operands.size());
+            binding.type = readOnly ? Nashi::ReflectedDescriptorType::ReadOnlyStorageBuffer
+                : Nashi::ReflectedDescriptorType::StorageBuffer;
+            binding.size = module.sizeOf(pointee);
+        }
+        else if (t->op == OpTypeImage) {
+            // Operand 6 of OpTypeImage is "Sampled": 2 means read/write storage image.
+            binding.type = t->operands[5] == 2 ? Nashi::ReflectedDescriptorType::StorageImage
+                : Nashi::ReflectedDescriptorType::SampledImage;
+        }
+        else if (t->op == OpTypeSampler) {
+            binding.type = Nashi::ReflectedDescriptorType::Sampler;
+        }
+        else if (t->op == OpTypeSampledImage) {
+            binding.type = Nashi::ReflectedDescriptorType::CombinedImageSampler;
+        }
+        else {
+            continue;
+        }
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+        [](const Nashi::ReflectedBinding& a, const Nashi::ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+    std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+        [](const Nashi::ReflectedVertexInput& a, const Nashi::ReflectedVertexInput& b) {
+            return a.location < b.location;
+        });
+
+    return true;
+}
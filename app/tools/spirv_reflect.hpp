@@ -0,0 +1,11 @@
+#pragma once
+
+#include <shader_reflection.hpp>
+
+#include <string>
+#include <vector>
+
+// Minimal SPIR-V walker that extracts what the backends need to build layouts:
+// descriptor bindings, push-constant ranges and vertex inputs. HLSL semantics
+// are only present when the module was compiled with dxc -fspv-reflect.
+bool reflectSpirv(const std::vector<char>& code, Nashi::ShaderReflection& reflection, std::string& error);